@@ -131,6 +131,22 @@ plutil -lint -s "$PLIST"
 
 cp -r "Resources/" "$DIR_RESOURCES"
 
+# Bake the resources into an asset pack, which the game maps at startup
+PACKER="$DIR_BUILD/FangPack"
+
+cc \
+    $COMPILE_FLAGS \
+    -o "$PACKER" \
+    "Source/Tools/FangPack.c"
+
+"./$PACKER" "Resources" "$DIR_RESOURCES/Fang.pack"
+
+# The renderer benchmark is built alongside, run it with the resource directory
+cc \
+    $COMPILE_FLAGS \
+    -o "$DIR_BUILD/FangBench" \
+    "Source/Tools/FangBench.c"
+
 cc \
     $COMPILE_FLAGS \
     $(sdl2-config --cflags --libs) \
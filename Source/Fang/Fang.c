@@ -17,15 +17,33 @@
 #include <float.h>
 #include <math.h>
 #include <signal.h>
+#include <stdatomic.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "Fang_Defines.c"
+
+#if defined(FANG_SIMD_SSE2)
+  #include <emmintrin.h>
+#endif
+
+#if defined(FANG_SIMD_SSSE3)
+  #include <tmmintrin.h>
+#endif
+
+#if defined(FANG_SIMD_NEON)
+  #include <arm_neon.h>
+#endif
+
 #include "Fang_Constants.c"
 #include "Fang_Macros.c"
+#include "Fang_Hash.c"
 #include "Fang_File.c"
+#include "Fang_Thread.c"
 #include "Fang_Color.c"
 #include "Fang_Rect.c"
 #include "Fang_Vector.c"
@@ -34,7 +52,9 @@
 #include "Fang_Input.c"
 #include "Fang_Image.c"
 #include "Fang_TGA.c"
+#include "Fang_Pack.c"
 #include "Fang_Framebuffer.c"
+#include "Fang_Font.c"
 #include "Fang_Texture.c"
 #include "Fang_Tile.c"
 #include "Fang_Chunk.c"
@@ -47,6 +67,8 @@
 #include "Fang_Entity.c"
 #include "Fang_Render.c"
 #include "Fang_Interface.c"
+#include "Fang_Hud.c"
+#include "Fang_Minimap.c"
 #include "Fang_State.c"
 #include "Fang_Pickups.c"
 #include "Fang_Projectiles.c"
@@ -54,31 +76,114 @@
 
 Fang_State gamestate;
 
+/**
+ * Raises the loading priority of every texture the current view references,
+ * so that textures still loading in the background arrive in the order they
+ * are needed.
+**/
 static inline void
-Fang_Init(void)
+Fang_RequestViewTextures(
+          Fang_Textures * const textures,
+    const Fang_Camera   * const camera,
+    const Fang_Map      * const map,
+          Fang_Entities * const entities,
+    const Fang_Ray      * const rays,
+    const size_t                count,
+    const uint32_t              priority)
 {
-    Fang_AllocImage(
-        &gamestate.framebuffer.color,
-        FANG_WINDOW_SIZE,
-        FANG_WINDOW_SIZE,
-        32
-    );
+    assert(textures);
+    assert(camera);
+    assert(map);
+    assert(entities);
+    assert(rays);
+
+    if (Fang_TexturesLoaded(textures))
+        return;
+
+    Fang_RequestTexture(textures, FANG_TEXTURE_FORMULA, priority);
+    Fang_RequestTexture(textures, map->skybox, priority);
+
+    {
+        const Fang_Chunk * const chunk = Fang_GetChunk(
+            &map->chunks, &camera->pos
+        );
+
+        if (chunk)
+            Fang_RequestTexture(textures, chunk->floor, priority);
+    }
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        for (size_t j = 0; j < rays[i].hit_count; ++j)
+        {
+            const Fang_RayHit * const hit = &rays[i].hits[j];
+
+            if (hit->tile)
+                Fang_RequestTexture(textures, hit->tile->texture, priority);
+
+            const Fang_Chunk * const chunk = Fang_GetChunk(
+                &map->chunks, &hit->front_hit
+            );
+
+            if (chunk)
+                Fang_RequestTexture(textures, chunk->floor, priority);
+        }
+    }
+
+    for (Fang_EntityId i = 0; i < FANG_MAX_ENTITIES; ++i)
+    {
+        const Fang_Entity * const entity = Fang_GetEntity(entities, i);
 
-    Fang_AllocImage(
-        &gamestate.framebuffer.depth,
+        if (entity)
+        {
+            Fang_RequestTexture(
+                textures, Fang_GetEntityTexture(entity), priority
+            );
+        }
+    }
+}
+
+static inline void
+Fang_Init(void)
+{
+    Fang_AllocFramebuffer(
+        &gamestate.framebuffer,
         FANG_WINDOW_SIZE,
         FANG_WINDOW_SIZE,
-        32
+        FANG_FRAMEBUFFER_DEPTH,
+        FANG_FRAMEBUFFER_LAYOUT
     );
 
     assert(Fang_ImageValid(&gamestate.framebuffer.color));
     assert(Fang_ImageValid(&gamestate.framebuffer.depth));
 
-    gamestate.framebuffer.state.current_depth = 0.0f;
-    gamestate.framebuffer.state.enable_depth  = true;
-    gamestate.framebuffer.state.transform     = Fang_IdentityMatrix();
+    if (gamestate.framebuffer.color.layout == FANG_IMAGELAYOUT_COLUMNS
+    ||  gamestate.framebuffer.color.stride != 4)
+    {
+        Fang_AllocPaddedImage(
+            &gamestate.frame,
+            FANG_WINDOW_SIZE,
+            FANG_WINDOW_SIZE,
+            32,
+            FANG_IMAGELAYOUT_ROWS
+        );
 
-    Fang_LoadTextures(&gamestate.textures);
+        assert(Fang_ImageValid(&gamestate.frame));
+    }
+
+    gamestate.settings = (Fang_RenderSettings){
+        .perspective = FANG_PERSPECTIVE_HIGH,
+        .strip_width = FANG_STRIP_WIDTH,
+        .ray_step    = FANG_RAY_STEP,
+        .interlaced  = false,
+        .deferred    = false,
+    };
+
+    /* Textures are taken from the asset pack when it's available */
+    if (!Fang_OpenPack("Fang.pack", &gamestate.pack))
+        gamestate.textures.pack = &gamestate.pack;
+
+    Fang_LoadTexturesAsync(&gamestate.textures);
 
     {
         Fang_Chunk * const chunk = (Fang_Chunk*)Fang_GetIndexedChunk(
@@ -116,6 +221,8 @@ Fang_Init(void)
         tile->texture = FANG_TEXTURE_TILE;
     }
 
+    gamestate.map.version++;
+
     gamestate.interface = (Fang_Interface){
         .textures = &gamestate.textures,
         .theme = (Fang_InterfaceTheme){
@@ -175,8 +282,145 @@ Fang_Init(void)
     gamestate.map.floor        = FANG_TEXTURE_FLOOR;
     gamestate.map.fog          = FANG_BLACK;
     gamestate.map.fog_distance = FANG_CHUNK_SIZE * 2.0f;
+
+    Fang_UpdateEntityLocations(&gamestate.entities, &gamestate.map.chunks);
 }
 
+/**
+ * Returns a hash of everything the rendered frame depends on: the camera, the
+ * render settings, the map, the appearance of each entity, the HUD's values,
+ * the interface's commands and which textures have loaded.
+ *
+ * Matching versions are drawn exactly the same, so a frame whose version
+ * matches the last rendered frame doesn't need to be rendered again.
+**/
+static inline uint64_t
+Fang_GetSceneVersion(
+    const Fang_Camera         * const camera,
+    const Fang_RenderSettings * const settings,
+    const Fang_Map            * const map,
+          Fang_Entities       * const entities,
+    const Fang_Textures       * const textures,
+    const Fang_Interface      * const interface,
+    const Fang_Entity         * const player,
+    const Fang_Point          * const weapon_offset)
+{
+    assert(camera);
+    assert(settings);
+    assert(map);
+    assert(entities);
+    assert(textures);
+    assert(interface);
+    assert(weapon_offset);
+
+    uint64_t hash = Fang_HashInterface(interface);
+
+    hash = Fang_HashData(hash, camera, sizeof(Fang_Camera));
+
+    /* The settings are hashed field by field, as their padding is undefined */
+    const int settings_fields[] = {
+        (int)settings->perspective,
+        settings->strip_width,
+        settings->ray_step,
+        settings->interlaced,
+        settings->deferred,
+    };
+
+    hash = Fang_HashData(hash, settings_fields, sizeof(settings_fields));
+
+    /* The map's tiles are covered by its version */
+    hash = Fang_HashData(hash, &map->version, sizeof(map->version));
+    hash = Fang_HashData(hash, &map->skybox, sizeof(map->skybox));
+    hash = Fang_HashData(hash, &map->floor, sizeof(map->floor));
+    hash = Fang_HashData(hash, &map->fog, sizeof(map->fog));
+    hash = Fang_HashData(hash, &map->fog_distance, sizeof(map->fog_distance));
+
+    for (Fang_EntityId i = 0; i < FANG_MAX_ENTITIES; ++i)
+    {
+        const Fang_Entity * const entity = Fang_GetEntity(entities, i);
+
+        if (!entity)
+            continue;
+
+        hash = Fang_HashData(hash, &entity->id, sizeof(entity->id));
+        hash = Fang_HashData(hash, &entity->type, sizeof(entity->type));
+        hash = Fang_HashData(hash, &entity->state, sizeof(entity->state));
+        hash = Fang_HashData(hash, &entity->body.pos, sizeof(Fang_Vec3));
+        hash = Fang_HashData(hash, &entity->body.width, sizeof(float));
+        hash = Fang_HashData(hash, &entity->body.height, sizeof(float));
+    }
+
+    if (player)
+    {
+        const Fang_PlayerProps * const props = &player->props.player;
+
+        hash = Fang_HashData(hash, &props->weapon, sizeof(props->weapon));
+        hash = Fang_HashData(hash, props->ammo, sizeof(props->ammo));
+        hash = Fang_HashData(hash, &props->health, sizeof(props->health));
+        hash = Fang_HashData(hash, weapon_offset, sizeof(Fang_Point));
+    }
+
+    /* Textures still loading are drawn with their fallbacks */
+    for (int i = 0; i < FANG_NUM_TEXTURES; ++i)
+    {
+        const int status = atomic_load_explicit(
+            &textures->status[i], memory_order_acquire
+        );
+
+        hash = Fang_HashData(hash, &status, sizeof(status));
+    }
+
+    return hash;
+}
+
+/**
+ * Returns the image showing the last rendered frame, which is the framebuffer's
+ * color image unless it is column-major or has its depth interleaved (see
+ * Fang_State).
+**/
+static inline const Fang_Image *
+Fang_GetFrame(void)
+{
+    if (Fang_ImageValid(&gamestate.frame))
+        return &gamestate.frame;
+
+    return &gamestate.framebuffer.color;
+}
+
+/**
+ * Returns the settings used to render the world.
+**/
+static inline const Fang_RenderSettings *
+Fang_GetRenderSettings(void)
+{
+    return &gamestate.settings;
+}
+
+/**
+ * Replaces the settings used to render the world, from the next frame on.
+ *
+ * The settings are part of the scene's version (see Fang_GetSceneVersion()),
+ * so changing them always draws a new frame. Buffers which only some settings
+ * need are allocated or freed by Fang_Update().
+**/
+static inline void
+Fang_SetRenderSettings(
+    const Fang_RenderSettings * const settings)
+{
+    assert(settings);
+    assert(settings->strip_width >= 0);
+    assert(settings->ray_step >= 0);
+
+    gamestate.settings = *settings;
+}
+
+/**
+ * Advances the game to the given time (in milliseconds) and draws the frame.
+ *
+ * Returns the new frame, or NULL if nothing on screen has changed since the
+ * last one, in which case the last frame (see Fang_GetFrame()) is still
+ * current and doesn't need to be presented again.
+**/
 static inline const Fang_Image *
 Fang_Update(
     const Fang_Input * const input,
@@ -329,27 +573,9 @@ Fang_Update(
                 );
             }
 
-            // Soft-reset location tables
-            for (size_t i = 0; i < FANG_CHUNK_COUNT; ++i)
-                gamestate.map.chunks.chunks[i].entities.count = 0;
-
-            // Update location table entries
-            for (Fang_EntityId i = 0; i < FANG_MAX_ENTITIES; ++i)
-            {
-                Fang_Entity * const entity = Fang_GetEntity(
-                    &gamestate.entities, i
-                );
-
-                if (!entity)
-                    continue;
-
-                Fang_Chunk * const chunk = (Fang_Chunk*)Fang_GetChunk(
-                    &gamestate.map.chunks, &entity->body.pos
-                );
-
-                assert(chunk->entities.count <= FANG_CHUNK_ENTITY_CAPACITY - 1);
-                chunk->entities.entities[chunk->entities.count++] = entity->id;
-            }
+            Fang_UpdateEntityLocations(
+                &gamestate.entities, &gamestate.map.chunks
+            );
 
             // Check entity-tile collisions
             for (Fang_EntityId i = 0; i < FANG_MAX_ENTITIES; ++i)
@@ -573,6 +799,11 @@ Fang_Update(
 
             gamestate.clock.accumulator -= FANG_DELTA_TIME_MS;
         }
+
+        /* Entities may have been added or removed by their updates, the
+           renderer gathers visible entities from the location tables
+        */
+        Fang_UpdateEntityLocations(&gamestate.entities, &gamestate.map.chunks);
     }
 
     {
@@ -580,201 +811,250 @@ Fang_Update(
         Fang_UpdateInterface(&gamestate.interface);
     }
 
-    Fang_ClearImage(&gamestate.framebuffer.color);
+    const Fang_Point weapon_offset = {
+        .x = (int)roundf(clamp(gamestate.sway.value.x, -1.0f, 1.0f) * 20),
+        .y = (int)roundf(clamp(gamestate.sway.value.y, -1.0f, 1.0f) * 20) + 20,
+    };
 
-    for (int x = 0; x < viewport.w; ++x)
     {
-        for (int y = 0; y < viewport.h; ++y)
-        {
-            float * const depth = (float*)(
-                gamestate.framebuffer.depth.pixels
-              + (x * gamestate.framebuffer.depth.stride)
-              + (y * gamestate.framebuffer.depth.pitch)
-            );
+        const uint64_t version = Fang_GetSceneVersion(
+            &gamestate.camera,
+            &gamestate.settings,
+            &gamestate.map,
+            &gamestate.entities,
+            &gamestate.textures,
+            &gamestate.interface,
+            player,
+            &weapon_offset
+        );
 
-            *depth = FLT_MAX;
+        /* Nothing on screen has changed, so the last frame is shown again */
+        if (gamestate.scene_valid && gamestate.scene_version == version)
+            return NULL;
+
+        /* The history is allocated the first time it's needed, interlacing is
+           turned off if it can't be rather than retrying every frame
+        */
+        if (!gamestate.settings.interlaced)
+        {
+            Fang_FreeFramebuffer(&gamestate.history);
+            gamestate.history_valid = false;
         }
+        else if (!Fang_ImageValid(&gamestate.history.color))
+        {
+            gamestate.history_valid = false;
+
+            if (Fang_AllocFramebuffer(
+                    &gamestate.history,
+                    FANG_WINDOW_SIZE,
+                    FANG_WINDOW_SIZE,
+                    FANG_FRAMEBUFFER_DEPTH,
+                    FANG_FRAMEBUFFER_LAYOUT))
+            {
+                gamestate.settings.interlaced = false;
+            }
+        }
+
+        Fang_FrameState * const state = &gamestate.framebuffer.state;
+
+        state->enable_interlace = gamestate.history_valid;
+        state->field            = (state->enable_interlace) ? !state->field : 0;
+
+        /* An interlaced frame is only whole once both of its fields have been
+           drawn, so the scene is drawn again even if it doesn't change
+        */
+        gamestate.scene_valid = (
+            !state->enable_interlace || gamestate.scene_version == version
+        );
+
+        gamestate.scene_version = version;
     }
 
     Fang_CastRays(
         &gamestate.camera,
         &gamestate.map.chunks,
         gamestate.raycast,
-        (size_t)FANG_WINDOW_SIZE
-    );
-
-    gamestate.framebuffer.state.current_depth = FLT_MAX;
-    gamestate.framebuffer.state.enable_depth  = true;
-
-    Fang_DrawMapSkybox(
-        &gamestate.framebuffer,
-        &gamestate.camera,
-        &gamestate.map,
-        Fang_GetTexture(&gamestate.textures, gamestate.map.skybox)
-    );
-
-    Fang_DrawMapFloor(
-        &gamestate.framebuffer,
-        &gamestate.camera,
-        &gamestate.map,
-        &gamestate.textures
+        (size_t)FANG_WINDOW_SIZE,
+        (size_t)max(gamestate.settings.ray_step, 1)
     );
 
-    Fang_DrawMapTiles(
-        &gamestate.framebuffer,
-        &gamestate.camera,
+    Fang_RequestViewTextures(
         &gamestate.textures,
+        &gamestate.camera,
         &gamestate.map,
+        &gamestate.entities,
         gamestate.raycast,
-        (size_t)FANG_WINDOW_SIZE
+        (size_t)FANG_WINDOW_SIZE,
+        gamestate.clock.time
     );
 
-    Fang_DrawEntities(
+    const size_t sprite_count = Fang_GatherSprites(
         &gamestate.framebuffer,
         &gamestate.camera,
         &gamestate.textures,
         &gamestate.map,
-        &gamestate.entities
+        &gamestate.entities,
+        gamestate.sprites
     );
 
-    Fang_ShadeFramebuffer(
-        &gamestate.framebuffer,
-        &gamestate.map.fog,
-        gamestate.map.fog_distance
+    Fang_GetFloorRows(
+        &gamestate.framebuffer, &gamestate.camera, gamestate.floor_rows
     );
 
-    gamestate.framebuffer.state.enable_depth = false;
+    const Fang_Image * const skybox = Fang_GetTexture(
+        &gamestate.textures, gamestate.map.skybox
+    );
 
-    if (player)
+    /* The visibility buffer is allocated the first time it's needed, deferred
+       frames are turned off if it can't be rather than retrying every frame
+    */
+    if (!gamestate.settings.deferred)
     {
-        const Fang_Weapon * const weapon = Fang_GetWeapon(
-            player->props.player.weapon
-        );
-
-        if (weapon)
+        Fang_FreeVisibilityBuffer(&gamestate.visibility);
+    }
+    else if (!gamestate.visibility.texels)
+    {
+        if (Fang_AllocVisibilityBuffer(
+                &gamestate.visibility, &gamestate.framebuffer))
         {
-            const Fang_Image * const weapon_texture = Fang_GetTexture(
-                &gamestate.textures, weapon->texture
-            );
+            gamestate.settings.deferred = false;
+        }
+    }
 
-            if (weapon_texture)
-            {
-                const Fang_Point offset = {
-                    .x = (int)roundf(
-                        clamp(gamestate.sway.value.x, -1.0f, 1.0f) * 20
-                    ),
-                    .y = (int)roundf(
-                        clamp(gamestate.sway.value.y, -1.0f, 1.0f) * 20
-                    ) + 20,
-                };
+    Fang_VisibilityBuffer * const visibility = (gamestate.visibility.texels)
+        ? &gamestate.visibility
+        : NULL;
 
-                Fang_DrawImage(
-                    &gamestate.framebuffer,
-                    weapon_texture,
-                    NULL,
-                    &(Fang_Rect){
-                        .x = offset.x,
-                        .y = offset.y,
-                        .w = viewport.w,
-                        .h = viewport.h
-                    }
-                );
-            }
+    const int strip_width = (gamestate.settings.strip_width > 0)
+        ? gamestate.settings.strip_width
+        : viewport.w;
 
-            Fang_DrawText(
-                &gamestate.framebuffer,
-                weapon->name,
-                Fang_GetTexture(&gamestate.textures, FANG_TEXTURE_FORMULA),
-                FANG_FONT_HEIGHT,
-                &(Fang_Point){.x = 5, .y = 3}
-            );
+    /* Every pass is drawn over one strip of columns before moving on to the
+       next, the floor rows require the strips to be drawn from left to right
+    */
+    for (int start_x = 0; start_x < viewport.w; start_x += strip_width)
+    {
+        const int end_x = min(start_x + strip_width, viewport.w);
 
-            char ammo_count[4];
-            snprintf(
-                ammo_count,
-                sizeof(ammo_count),
-                "%03d",
-                player->props.player.ammo[player->props.player.weapon]
-            );
+        Fang_ClearFramebufferColumns(&gamestate.framebuffer, start_x, end_x);
 
-            Fang_DrawText(
-                &gamestate.framebuffer,
-                ammo_count,
-                Fang_GetTexture(&gamestate.textures, FANG_TEXTURE_FORMULA),
-                FANG_FONT_HEIGHT,
-                &(Fang_Point){.x = 5, .y = 3 + FANG_FONT_HEIGHT}
-            );
-        }
+        gamestate.framebuffer.state.current_depth = FLT_MAX;
+        gamestate.framebuffer.state.enable_depth  = true;
 
-        {
-            char health[4] = "000";
-            snprintf(
-                health,
-                sizeof(health),
-                "%3d",
-                player->props.player.health
-            );
+        Fang_DrawMapSkybox(
+            &gamestate.framebuffer,
+            &gamestate.camera,
+            &gamestate.map,
+            skybox,
+            start_x,
+            end_x
+        );
 
-            const int text_offset = 3 - (int)strlen(health);
+        Fang_DrawMapFloor(
+            &gamestate.framebuffer,
+            &gamestate.map,
+            &gamestate.textures,
+            gamestate.floor_rows,
+            visibility,
+            start_x,
+            end_x
+        );
 
-            Fang_DrawText(
-                &gamestate.framebuffer,
-                health,
-                Fang_GetTexture(&gamestate.textures, FANG_TEXTURE_FORMULA),
-                FANG_FONT_HEIGHT,
-                &(Fang_Point){
-                    .x = viewport.w - 5 - (FANG_FONT_WIDTH * (3 - text_offset)),
-                    .y = 3
-                }
-            );
-        }
+        Fang_DrawMapTiles(
+            &gamestate.framebuffer,
+            &gamestate.settings,
+            &gamestate.camera,
+            &gamestate.textures,
+            &gamestate.map,
+            gamestate.raycast,
+            gamestate.occluders,
+            visibility,
+            (visibility) ? FANG_TILEPASS_OPAQUE : FANG_TILEPASS_ALL,
+            (size_t)FANG_WINDOW_SIZE,
+            start_x,
+            end_x
+        );
 
+        /* Translucent tiles are blended over the resolved opaque surfaces */
+        if (visibility)
         {
-            char position[15];
-
-            snprintf(
-                position,
-                sizeof(position),
-                "%3.2f, %3.2f",
-                fmodf(player->body.pos.x, FANG_CHUNK_SIZE),
-                fmodf(player->body.pos.y, FANG_CHUNK_SIZE)
+            Fang_ResolveVisibility(
+                &gamestate.framebuffer, visibility, start_x, end_x
             );
 
-            Fang_DrawText(
+            Fang_DrawMapTiles(
                 &gamestate.framebuffer,
-                position,
-                Fang_GetTexture(&gamestate.textures, FANG_TEXTURE_FORMULA),
-                FANG_FONT_HEIGHT,
-                &(Fang_Point){
-                    .x = 3,
-                    .y = viewport.h - FANG_FONT_HEIGHT - 3
-                }
+                &gamestate.settings,
+                &gamestate.camera,
+                &gamestate.textures,
+                &gamestate.map,
+                gamestate.raycast,
+                gamestate.occluders,
+                visibility,
+                FANG_TILEPASS_TRANSLUCENT,
+                (size_t)FANG_WINDOW_SIZE,
+                start_x,
+                end_x
             );
         }
-    }
 
-    {
-        const Fang_FrameState state = Fang_SetViewport(
+        Fang_DrawSprites(
             &gamestate.framebuffer,
-            &(Fang_Rect){
-                .x = FANG_WINDOW_SIZE - 32,
-                .y = FANG_WINDOW_SIZE - 32,
-                .w = 32,
-                .h = 32,
-            }
+            gamestate.sprites,
+            sprite_count,
+            gamestate.occluders,
+            (size_t)FANG_WINDOW_SIZE,
+            start_x,
+            end_x
         );
 
-        Fang_DrawMinimap(
+        Fang_ShadeFramebuffer(
             &gamestate.framebuffer,
-            &gamestate.camera,
-            &gamestate.map,
-            gamestate.raycast,
-            (size_t)FANG_WINDOW_SIZE
+            &gamestate.map.fog,
+            gamestate.map.fog_distance,
+            start_x,
+            end_x
         );
+    }
 
-        gamestate.framebuffer.state = state;
+    Fang_ReconstructFramebuffer(
+        &gamestate.framebuffer,
+        &gamestate.history,
+        &gamestate.camera,
+        &gamestate.history_camera
+    );
+
+    if (Fang_ImageValid(&gamestate.history.color))
+    {
+        Fang_CopyFramebuffer(&gamestate.history, &gamestate.framebuffer);
+        gamestate.history_camera = gamestate.camera;
+        gamestate.history_valid  = true;
     }
 
+    gamestate.framebuffer.state.enable_depth     = false;
+    gamestate.framebuffer.state.enable_interlace = false;
+
+    if (player)
+    {
+        Fang_UpdateHud(&gamestate.hud, &gamestate.textures, player, &viewport);
+        Fang_DrawHud(&gamestate.framebuffer, &gamestate.hud, &weapon_offset);
+    }
+
+    Fang_DrawMinimap(
+        &gamestate.framebuffer,
+        &gamestate.minimap,
+        &gamestate.camera,
+        &gamestate.map,
+        gamestate.raycast,
+        (size_t)FANG_WINDOW_SIZE,
+        &(Fang_Point){
+            .x = viewport.w - FANG_MINIMAP_SIZE,
+            .y = viewport.h - FANG_MINIMAP_SIZE,
+        }
+    );
+
+    Fang_DrawInterface(&gamestate.framebuffer, &gamestate.interface);
+
     gamestate.framebuffer.state.current_depth = 0.0f;
 
     Fang_SetFragment(
@@ -791,13 +1071,24 @@ Fang_Update(
         }
     );
 
-    return &gamestate.framebuffer.color;
+    if (gamestate.framebuffer.color.layout == FANG_IMAGELAYOUT_COLUMNS)
+        Fang_TransposeImage(&gamestate.frame, &gamestate.framebuffer.color);
+    else if (Fang_ImageValid(&gamestate.frame))
+        Fang_DeinterleaveImage(&gamestate.frame, &gamestate.framebuffer.color);
+
+    return Fang_GetFrame();
 }
 
 static inline void
 Fang_Quit(void)
 {
+    Fang_FreeInterface(&gamestate.interface);
+    Fang_FreeMinimap(&gamestate.minimap);
+    Fang_FreeHud(&gamestate.hud);
     Fang_FreeTextures(&gamestate.textures);
-    Fang_FreeImage(&gamestate.framebuffer.color);
-    Fang_FreeImage(&gamestate.framebuffer.depth);
+    Fang_ClosePack(&gamestate.pack);
+    Fang_FreeFramebuffer(&gamestate.framebuffer);
+    Fang_FreeFramebuffer(&gamestate.history);
+    Fang_FreeVisibilityBuffer(&gamestate.visibility);
+    Fang_FreeImage(&gamestate.frame);
 }
@@ -42,6 +42,29 @@ Fang_RotateCamera(
     camera->dir.z = clamp(camera->dir.z + pitch, -1.0f, 1.0f);
 }
 
+/**
+ * Returns the direction of the ray cast through the given column, out of the
+ * given number of columns spread across the camera plane.
+**/
+static inline Fang_Vec2
+Fang_GetCameraRayDir(
+    const Fang_Camera * const camera,
+    const size_t              column,
+    const size_t              count)
+{
+    assert(camera);
+    assert(column < count);
+
+    /* X coordinate in camera space, normalized -1.0f..1.0f */
+    const float plane_x = 2.0f * (1.0f - (float)column / (float)count) - 1.0f;
+
+    /* Map ray start position onto camera plane */
+    return (Fang_Vec2){
+        .x = camera->dir.x + camera->cam.x * plane_x,
+        .y = camera->dir.y + camera->cam.y * plane_x,
+    };
+}
+
 static inline Fang_Rect
 Fang_ProjectTile(
     const Fang_Camera   * const camera,
@@ -117,3 +140,159 @@ Fang_ProjectBody(
         .h = (int)height,
     };
 }
+
+/**
+ * Returns the lowest value of a linear function of positions within a box,
+ * which is found at one of the box's corners.
+**/
+static inline float
+Fang_GetBoxMinimum(
+    const Fang_Vec2 coeff,
+    const Fang_Vec2 box_min,
+    const Fang_Vec2 box_max)
+{
+    return coeff.x * ((coeff.x > 0.0f) ? box_min.x : box_max.x)
+         + coeff.y * ((coeff.y > 0.0f) ? box_min.y : box_max.y);
+}
+
+/**
+ * Returns whether a body positioned anywhere within a box on the map, and no
+ * wider than the given width, could be projected into the viewport no deeper
+ * than the given depth.
+ *
+ * This is a 2D test against the edges of the view frustum on the map, which
+ * only rejects bodies that Fang_ProjectBody() would place behind the camera,
+ * beyond the depth, or entirely to either side of the viewport. A single body
+ * is tested by using its position as both corners of the box.
+**/
+static inline bool
+Fang_BoxInView(
+    const Fang_Camera * const camera,
+    const Fang_Rect   * const viewport,
+    const Fang_Vec2           box_min,
+    const Fang_Vec2           box_max,
+    const float               width,
+    const float               max_depth)
+{
+    assert(camera);
+    assert(viewport);
+
+    /* Positions are taken relative to the camera, where the projected
+       horizontal position and depth (see Fang_ProjectBody()) are linear
+    */
+    const Fang_Vec2 diff_min = {
+        .x = box_min.x - camera->pos.x,
+        .y = box_min.y - camera->pos.y,
+    };
+
+    const Fang_Vec2 diff_max = {
+        .x = box_max.x - camera->pos.x,
+        .y = box_max.y - camera->pos.y,
+    };
+
+    const Fang_Vec2 plane_x = {.x =  camera->dir.y, .y = -camera->dir.x};
+    const Fang_Vec2 plane_y = {.x = -camera->cam.y, .y =  camera->cam.x};
+
+    /* Behind the camera */
+    const Fang_Vec2 behind = {.x = -plane_y.x, .y = -plane_y.y};
+
+    if (Fang_GetBoxMinimum(behind, diff_min, diff_max) >= 0.0f)
+        return false;
+
+    /* Beyond the given depth */
+    if (Fang_GetBoxMinimum(plane_y, diff_min, diff_max) * FANG_PROJECTION_RATIO
+      > max_depth)
+        return false;
+
+    /* Projected rects are truncated to whole pixels, so the edges are widened
+       by a couple of pixels to never reject a body which would be drawn
+    */
+    const float slack  = 1.0f + 4.0f / (float)viewport->w;
+    const float margin = width * (float)viewport->h / (float)viewport->w;
+
+    const Fang_Vec2 left = {
+        .x = plane_x.x - plane_y.x * slack,
+        .y = plane_x.y - plane_y.y * slack,
+    };
+
+    const Fang_Vec2 right = {
+        .x = -plane_x.x - plane_y.x * slack,
+        .y = -plane_x.y - plane_y.y * slack,
+    };
+
+    if (Fang_GetBoxMinimum(left, diff_min, diff_max) >= margin)
+        return false;
+
+    if (Fang_GetBoxMinimum(right, diff_min, diff_max) >= margin)
+        return false;
+
+    return true;
+}
+
+/**
+ * Finds the bounds of the area on the map in which bodies no wider than the
+ * given width could be seen by the camera, no deeper than the given depth.
+ *
+ * These are the bounds of the region accepted by Fang_BoxInView(). If the
+ * camera is degenerate, the bounds are infinite.
+**/
+static inline void
+Fang_GetViewBounds(
+    const Fang_Camera * const camera,
+    const Fang_Rect   * const viewport,
+    const float               width,
+    const float               max_depth,
+          Fang_Vec2   * const result_min,
+          Fang_Vec2   * const result_max)
+{
+    assert(camera);
+    assert(viewport);
+    assert(result_min);
+    assert(result_max);
+
+    const float det = camera->dir.y * camera->cam.x
+                    - camera->dir.x * camera->cam.y;
+
+    if (fabsf(det) <= FLT_EPSILON)
+    {
+        *result_min = (Fang_Vec2){.x = -FLT_MAX, .y = -FLT_MAX};
+        *result_max = (Fang_Vec2){.x =  FLT_MAX, .y =  FLT_MAX};
+        return;
+    }
+
+    const float slack  = 1.0f + 4.0f / (float)viewport->w;
+    const float margin = width * (float)viewport->h / (float)viewport->w;
+    const float depth  = max_depth / FANG_PROJECTION_RATIO;
+
+    /* The corners of the region, as projected horizontal positions and
+       depths, which are transformed back onto the map
+    */
+    const Fang_Vec2 corners[4] = {
+        {.x = -margin,                  .y = 0.0f},
+        {.x =  margin,                  .y = 0.0f},
+        {.x = -margin - depth * slack,  .y = depth},
+        {.x =  margin + depth * slack,  .y = depth},
+    };
+
+    *result_min = (Fang_Vec2){.x =  FLT_MAX, .y =  FLT_MAX};
+    *result_max = (Fang_Vec2){.x = -FLT_MAX, .y = -FLT_MAX};
+
+    for (size_t i = 0; i < 4; ++i)
+    {
+        const Fang_Vec2 corner = corners[i];
+
+        const Fang_Vec2 pos = {
+            .x = camera->pos.x + (
+                corner.x * camera->cam.x + camera->dir.x * corner.y
+            ) / det,
+            .y = camera->pos.y + (
+                camera->dir.y * corner.y + camera->cam.y * corner.x
+            ) / det,
+        };
+
+        result_min->x = min(result_min->x, pos.x);
+        result_min->y = min(result_min->y, pos.y);
+        result_max->x = max(result_max->x, pos.x);
+        result_max->y = max(result_max->y, pos.y);
+    }
+}
@@ -98,3 +98,131 @@ Fang_BlendColor(
         .a = (uint8_t)(dest_a * 255.0f),
     };
 }
+
+/**
+ * Multiplies the color channels of a packed pixel by its alpha channel.
+**/
+static inline uint32_t
+Fang_PremultiplyPixel(
+    const uint32_t pixel)
+{
+    const uint32_t alpha = pixel & 0xFF;
+
+    if (alpha == 0xFF)
+        return pixel;
+
+    /* Red/blue and green/alpha are multiplied in pairs, dividing by 255 with
+       rounding. Alpha is restored afterwards.
+    */
+    uint32_t rb = ((pixel >> 8) & 0x00FF00FF) * alpha + 0x00800080;
+    uint32_t ga = ((pixel >> 0) & 0x00FF0000) * alpha + 0x00800000;
+
+    rb = ((rb + ((rb >> 8) & 0x00FF00FF)) >> 8) & 0x00FF00FF;
+    ga = ((ga + ((ga >> 8) & 0x00FF0000)) >> 8) & 0x00FF0000;
+
+    return (rb << 8) | ga | alpha;
+}
+
+/**
+ * Blends a premultiplied, packed pixel over another packed pixel.
+ *
+ * This is the integer equivalent of Fang_BlendColor() for colors that have
+ * already been multiplied by their alpha.
+**/
+static inline uint32_t
+Fang_BlendPixel(
+    const uint32_t source,
+    const uint32_t dest)
+{
+    const uint32_t inverse = 0xFF - (source & 0xFF);
+
+    uint32_t rb = ((dest >> 8) & 0x00FF00FF) * inverse + 0x00800080;
+    uint32_t ga = ((dest >> 0) & 0x00FF00FF) * inverse + 0x00800080;
+
+    rb = ((rb + ((rb >> 8) & 0x00FF00FF)) >> 8) & 0x00FF00FF;
+    ga = ((ga + ((ga >> 8) & 0x00FF00FF)) >> 8) & 0x00FF00FF;
+
+    return source + ((rb << 8) | ga);
+}
+
+/**
+ * Returns the average of two packed pixels, rounded down.
+**/
+static inline uint32_t
+Fang_AveragePixels(
+    const uint32_t a,
+    const uint32_t b)
+{
+    /* Halving the differing bits never carries between channels */
+    return (a & b) + (((a ^ b) >> 1) & 0x7F7F7F7F);
+}
+
+/**
+ * Clamps each channel of a packed pixel between the same channels of two other
+ * pixels, which may be given in either order.
+**/
+static inline uint32_t
+Fang_ClampPixel(
+    const uint32_t pixel,
+    const uint32_t a,
+    const uint32_t b)
+{
+#if defined(FANG_SIMD_NEON)
+    const uint8x8_t pixel_vec = vreinterpret_u8_u32(vdup_n_u32(pixel));
+    const uint8x8_t a_vec     = vreinterpret_u8_u32(vdup_n_u32(a));
+    const uint8x8_t b_vec     = vreinterpret_u8_u32(vdup_n_u32(b));
+
+    const uint8x8_t result = vmax_u8(
+        vmin_u8(pixel_vec, vmax_u8(a_vec, b_vec)), vmin_u8(a_vec, b_vec)
+    );
+
+    return vget_lane_u32(vreinterpret_u32_u8(result), 0);
+#elif defined(FANG_SIMD_SSE2)
+    const __m128i pixel_vec = _mm_cvtsi32_si128((int)pixel);
+    const __m128i a_vec     = _mm_cvtsi32_si128((int)a);
+    const __m128i b_vec     = _mm_cvtsi32_si128((int)b);
+
+    const __m128i result = _mm_max_epu8(
+        _mm_min_epu8(pixel_vec, _mm_max_epu8(a_vec, b_vec)),
+        _mm_min_epu8(a_vec, b_vec)
+    );
+
+    return (uint32_t)_mm_cvtsi128_si32(result);
+#else
+    uint32_t result = 0;
+
+    for (uint32_t shift = 0; shift < 32; shift += 8)
+    {
+        const uint32_t channel   = (pixel >> shift) & 0xFF;
+        const uint32_t channel_a = (a     >> shift) & 0xFF;
+        const uint32_t channel_b = (b     >> shift) & 0xFF;
+
+        const uint32_t low  = min(channel_a, channel_b);
+        const uint32_t high = max(channel_a, channel_b);
+
+        const uint32_t clamped = clamp(channel, low, high);
+
+        result |= clamped << shift;
+    }
+
+    return result;
+#endif
+}
+
+/**
+ * Scales a premultiplied, packed pixel by an opacity, where 255 leaves the
+ * pixel unchanged and 0 makes it fully transparent.
+**/
+static inline uint32_t
+Fang_FadePixel(
+    const uint32_t pixel,
+    const uint8_t  opacity)
+{
+    uint32_t rb = ((pixel >> 8) & 0x00FF00FF) * opacity + 0x00800080;
+    uint32_t ga = ((pixel >> 0) & 0x00FF00FF) * opacity + 0x00800080;
+
+    rb = ((rb + ((rb >> 8) & 0x00FF00FF)) >> 8) & 0x00FF00FF;
+    ga = ((ga + ((ga >> 8) & 0x00FF00FF)) >> 8) & 0x00FF00FF;
+
+    return (rb << 8) | ga;
+}
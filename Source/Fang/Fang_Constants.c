@@ -36,6 +36,13 @@ static const float FANG_PICKUP_WIDTH   = FANG_PLAYER_WIDTH  / 2.0f;
 static const float FANG_PICKUP_HEIGHT  = FANG_PLAYER_HEIGHT / 2.0f;
 static const float FANG_JUMP_TOLERANCE = FANG_GRAVITY / 6.0f;
 
+/**
+ * The widest any entity's body may be. The view is widened by this much when
+ * finding the chunks to draw entities from, so that a body whose position lies
+ * just outside of the view is still drawn if it overlaps it.
+**/
+static const float FANG_MAX_BODY_WIDTH = 1.0f;
+
 static const uint32_t FANG_DELTA_TIME_MS = 10;
 static const float    FANG_DELTA_TIME_S = (float)FANG_DELTA_TIME_MS / 1000.0f;
 
@@ -46,6 +53,21 @@ enum {
     FANG_TEXTURE_SIZE = 128,
 };
 
+/**
+ * The maximum number of mipmap levels kept for a texture, including the
+ * full-size image. This is enough to reduce a tile texture down to 1x1 faces.
+**/
+enum {
+    FANG_TEXTURE_LEVELS = 8,
+};
+
+/**
+ * The number of worker threads used for loading textures in the background.
+**/
+enum {
+    FANG_TEXTURE_WORKERS = 2,
+};
+
 /**
  * All fonts should be 8x9 in size, with a 1px barrier in between each
  * character.
@@ -59,6 +81,35 @@ enum {
     FANG_RAY_MAX_STEPS = 64,
 };
 
+/**
+ * The default number of columns the world is drawn in at a time (see
+ * Fang_RenderSettings). Narrower strips keep less of the framebuffer in the
+ * cache, but pay more for going over the sprites and floor rows once per strip.
+**/
+enum {
+    FANG_STRIP_WIDTH = 64,
+};
+
+/**
+ * The default spacing of the columns whose rays are cast (see
+ * Fang_RenderSettings). At this spacing, neighbouring cast rays stay less than
+ * a tile apart within FANG_RAY_MAX_STEPS tiles of the camera, so no tile can
+ * fall between them.
+**/
+enum {
+    FANG_RAY_STEP = 4,
+};
+
+/**
+ * The minimap shows the tiles within FANG_MINIMAP_RANGE of the camera, with
+ * each tile being FANG_MINIMAP_TILE pixels wide.
+**/
+enum {
+    FANG_MINIMAP_TILE  = 4,
+    FANG_MINIMAP_RANGE = 8,
+    FANG_MINIMAP_SIZE  = FANG_MINIMAP_TILE * FANG_MINIMAP_RANGE * 2,
+};
+
 enum {
     FANG_MAX_ENTITIES   = 256,
     FANG_MAX_COLLISIONS = FANG_MAX_ENTITIES * 64,
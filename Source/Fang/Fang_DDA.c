@@ -22,6 +22,29 @@ typedef enum Fang_Face {
     FANG_FACE_BOTTOM = 5,
 } Fang_Face;
 
+/**
+ * Returns the face on the opposite side of a tile.
+ *
+ * The face a DDA leaves a tile through is given as the face of the next tile,
+ * so this gives the face of the tile being left.
+**/
+static inline Fang_Face
+Fang_GetOppositeFace(
+    const Fang_Face face)
+{
+    switch (face)
+    {
+        case FANG_FACE_NORTH:  return FANG_FACE_SOUTH;
+        case FANG_FACE_SOUTH:  return FANG_FACE_NORTH;
+        case FANG_FACE_EAST:   return FANG_FACE_WEST;
+        case FANG_FACE_WEST:   return FANG_FACE_EAST;
+        case FANG_FACE_TOP:    return FANG_FACE_BOTTOM;
+        case FANG_FACE_BOTTOM: return FANG_FACE_TOP;
+    }
+
+    return face;
+}
+
 /**
  * A structure containing the necessary data for the Digital Differential
  * Analyzer.
@@ -18,3 +18,50 @@
  * be prepended with this definition (no-op) for clarity.
 **/
 #define FANG_PLATFORM_CALL
+
+/**
+ * Vector instruction sets available to the core, detected from the compiler's
+ * target. Code using these should always provide a scalar fallback.
+ *
+ * The packed pixel format relies on the host's byte order, so the vector paths
+ * are only enabled on little-endian targets.
+**/
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  #if defined(__SSE2__)
+    #define FANG_SIMD_SSE2
+  #endif
+
+  #if defined(__SSSE3__)
+    #define FANG_SIMD_SSSE3
+  #endif
+
+  #if defined(__ARM_NEON)
+    #define FANG_SIMD_NEON
+  #endif
+#endif
+
+/**
+ * The layout of the framebuffer the game is drawn into. Building with
+ * FANG_COLUMN_MAJOR defined stores it column by column, which is then
+ * transposed into a row-major image before being shown.
+**/
+#if defined(FANG_COLUMN_MAJOR)
+  #define FANG_FRAMEBUFFER_LAYOUT FANG_IMAGELAYOUT_COLUMNS
+#else
+  #define FANG_FRAMEBUFFER_LAYOUT FANG_IMAGELAYOUT_ROWS
+#endif
+
+/**
+ * How the depth of the framebuffer the game is drawn into is stored. Building
+ * with FANG_INTERLEAVED_DEPTH defined keeps each pixel's depth next to its
+ * color, which is then copied out into an image of its own before being shown.
+**/
+#if defined(FANG_INTERLEAVED_DEPTH)
+  #if defined(FANG_COLUMN_MAJOR)
+    #error "FANG_INTERLEAVED_DEPTH requires a row-major framebuffer"
+  #endif
+
+  #define FANG_FRAMEBUFFER_DEPTH FANG_DEPTHLAYOUT_INTERLEAVED
+#else
+  #define FANG_FRAMEBUFFER_DEPTH FANG_DEPTHLAYOUT_SEPARATE
+#endif
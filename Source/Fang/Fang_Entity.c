@@ -287,3 +287,35 @@ Fang_AddEntityCollision(
     collisions->collisions[collisions->count++] = pair;
 }
 
+/**
+ * Rebuilds the location tables of the map's chunks, so that each chunk lists
+ * the entities currently positioned within it.
+**/
+static inline void
+Fang_UpdateEntityLocations(
+          Fang_Entities * const entities,
+          Fang_Chunks   * const chunks)
+{
+    assert(entities);
+    assert(chunks);
+
+    // Soft-reset location tables
+    for (size_t i = 0; i < FANG_CHUNK_COUNT; ++i)
+        chunks->chunks[i].entities.count = 0;
+
+    // Update location table entries
+    for (Fang_EntityId i = 0; i < FANG_MAX_ENTITIES; ++i)
+    {
+        const Fang_Entity * const entity = Fang_GetEntity(entities, i);
+
+        if (!entity)
+            continue;
+
+        Fang_Chunk * const chunk = (Fang_Chunk*)Fang_GetChunk(
+            chunks, &entity->body.pos
+        );
+
+        assert(chunk->entities.count <= FANG_CHUNK_ENTITY_CAPACITY - 1);
+        chunk->entities.entities[chunk->entities.count++] = entity->id;
+    }
+}
@@ -49,3 +49,60 @@ Fang_FileError Fang_LoadFile(const char * /* filename */, Fang_File *);
 **/
 FANG_PLATFORM_CALL
 void Fang_FreeFile(Fang_File *);
+
+/**
+ * Maps a game file into memory as read-only data.
+ *
+ * This resolves the file name the same way as Fang_LoadFile(), but the file's
+ * contents are paged in by the operating system as they are accessed instead
+ * of being read up front. The data must not be written to.
+**/
+FANG_PLATFORM_CALL
+Fang_FileError Fang_MapFile(const char * /* filename */, Fang_File *);
+
+/**
+ * Unmaps a game file that was mapped via Fang_MapFile().
+**/
+FANG_PLATFORM_CALL
+void Fang_UnmapFile(Fang_File *);
+
+/**
+ * An opaque handle to a file being read in the background.
+**/
+typedef struct Fang_FileRequest Fang_FileRequest;
+
+/**
+ * Starts reading a game file in the background.
+ *
+ * The file name is resolved the same way as Fang_LoadFile(). Returns NULL if
+ * the read could not be started. Platforms without asynchronous reads may read
+ * the file before returning, in which case the first poll completes the
+ * request.
+**/
+FANG_PLATFORM_CALL
+Fang_FileRequest * Fang_RequestFile(const char * /* filename */);
+
+/**
+ * Checks whether a background read has finished.
+ *
+ * Returns false while the read is still in progress. Once it has finished, the
+ * request is released and true is returned, with the error (if any) written
+ * out. On success the file holds the data, which should be freed with
+ * Fang_FreeFile().
+**/
+FANG_PLATFORM_CALL
+bool Fang_PollFile(Fang_FileRequest *, Fang_File *, Fang_FileError *);
+
+/**
+ * Blocks until a background read has finished, without releasing the request.
+ *
+ * The request should then be polled with Fang_PollFile() to retrieve the file.
+**/
+FANG_PLATFORM_CALL
+void Fang_WaitFile(Fang_FileRequest *);
+
+/**
+ * Cancels a background read that has not finished and releases the request.
+**/
+FANG_PLATFORM_CALL
+void Fang_CancelFile(Fang_FileRequest *);
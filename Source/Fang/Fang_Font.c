@@ -0,0 +1,325 @@
+// Copyright (C) 2021  Antonio Lassandro
+
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+
+// You should have received a copy of the GNU General Public License along
+// with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+/**
+ * Fonts are images holding a strip of glyphs for the printable characters from
+ * '!' to '~', each FANG_FONT_WIDTH by FANG_FONT_HEIGHT pixels and separated by
+ * one pixel barriers.
+ *
+ * Text is drawn from glyphs which have already been scaled to the height of the
+ * text, held in a small cache shared by all fonts. Each set of glyphs in the
+ * cache belongs to a font and height, and holds the premultiplied texels of
+ * every glyph (stored by column) along with the runs of visible texels in each
+ * of their columns. Sets are replaced in least-recently-used order.
+**/
+enum {
+    FANG_GLYPH_FIRST = '!',
+    FANG_GLYPH_LAST  = '~',
+    FANG_GLYPH_COUNT = FANG_GLYPH_LAST - FANG_GLYPH_FIRST + 1,
+
+    FANG_GLYPHCACHE_SETS = 8,
+};
+
+/**
+ * A run of visible texels in a column of a glyph.
+ *
+ * Opaque runs can be written without any blending.
+**/
+typedef struct Fang_GlyphRun {
+    uint16_t x;
+    uint16_t y;
+    uint16_t length;
+    bool     opaque;
+} Fang_GlyphRun;
+
+typedef struct Fang_GlyphSet {
+    const uint8_t       * pixels;
+          int             height;
+          int             glyph_width;
+          int             glyph_height;
+          int             advance;
+          uint32_t        last_use;
+          uint32_t      * texels;
+          Fang_GlyphRun * runs;
+          uint32_t        glyphs[FANG_GLYPH_COUNT + 1];
+} Fang_GlyphSet;
+
+typedef struct Fang_GlyphCache {
+    Fang_GlyphSet sets[FANG_GLYPHCACHE_SETS];
+    uint32_t      clock;
+} Fang_GlyphCache;
+
+/**
+ * Returns the cache shared by all fonts.
+**/
+static inline Fang_GlyphCache *
+Fang_GetGlyphCache(void)
+{
+    static Fang_GlyphCache cache = {.clock = 0};
+    return &cache;
+}
+
+/**
+ * Removes all of the cached glyphs belonging to the given font pixel data.
+ *
+ * This must be called before the font is freed, otherwise a new font allocated
+ * at the same address could be served stale glyphs.
+**/
+static inline void
+Fang_EvictGlyphs(
+    const uint8_t * const pixels)
+{
+    Fang_GlyphCache * const cache = Fang_GetGlyphCache();
+
+    for (int i = 0; i < FANG_GLYPHCACHE_SETS; ++i)
+    {
+        Fang_GlyphSet * const set = &cache->sets[i];
+
+        if (set->pixels != pixels)
+            continue;
+
+        free(set->texels);
+        memset(set, 0, sizeof(Fang_GlyphSet));
+    }
+}
+
+/**
+ * Returns the index of a character's glyph, characters without a glyph are
+ * given the glyph for '?'.
+**/
+static inline int
+Fang_GetGlyphIndex(
+    const char character)
+{
+    if (character < FANG_GLYPH_FIRST || character > FANG_GLYPH_LAST)
+        return '?' - FANG_GLYPH_FIRST;
+
+    return character - FANG_GLYPH_FIRST;
+}
+
+/**
+ * Returns the area of a font image holding a character's glyph.
+**/
+static inline Fang_Rect
+Fang_GetGlyphArea(
+    const char character)
+{
+    const float pos = (float)Fang_GetGlyphIndex(character)
+                    / (127.0f - (float)FANG_GLYPH_FIRST);
+
+    const int total_width = (127 - FANG_GLYPH_FIRST) * (FANG_FONT_WIDTH + 1);
+
+    return (Fang_Rect){
+        .x = (int)((float)total_width * pos) + 1,
+        .y = 0,
+        .w = FANG_FONT_WIDTH,
+        .h = FANG_FONT_HEIGHT,
+    };
+}
+
+/**
+ * Returns the distance between characters for text of the given height.
+**/
+static inline int
+Fang_GetFontAdvance(
+    const int height)
+{
+    const float ratio = (float)height / (float)FANG_FONT_HEIGHT;
+
+    return (int)((FANG_FONT_WIDTH + 1) * ratio);
+}
+
+/**
+ * Returns the texel of a font read by a texel of a scaled glyph, matching the
+ * scaling performed by Fang_DrawImageEx().
+**/
+static inline uint32_t
+Fang_SampleGlyph(
+    const Fang_Image * const font,
+    const Fang_Rect  * const source,
+    const Fang_Rect  * const dest,
+    const int                x,
+    const int                y)
+{
+    assert(font);
+    assert(source);
+    assert(dest);
+
+    float r_x = (float)x / (float)dest->w;
+    float r_y = (float)y / (float)dest->h;
+
+    r_x = max(min(r_x, 1.0f), 0.0f);
+    r_y = max(min(r_y, 1.0f), 0.0f);
+
+    const int tex_x = (int)(r_x * (float)source->w) + source->x;
+    const int tex_y = (int)(r_y * (float)source->h) + source->y;
+
+    const uint32_t pixel = Fang_SamplePixel(font, tex_x, tex_y);
+
+    return (font->flags & FANG_IMAGEFLAG_PREMULTIPLIED)
+        ? pixel
+        : Fang_PremultiplyPixel(pixel);
+}
+
+/**
+ * Scales every glyph of a font to the given height, filling in a set of the
+ * glyph cache.
+ *
+ * Returns non-zero if the glyphs could not be allocated.
+**/
+static inline int
+Fang_BuildGlyphSet(
+    const Fang_Image    * const font,
+    const int                   height,
+          Fang_GlyphSet * const set)
+{
+    assert(Fang_ImageValid(font));
+    assert(set);
+
+    const float ratio = (float)height / (float)FANG_FONT_HEIGHT;
+
+    const int glyph_width  = (int)(FANG_FONT_WIDTH  * ratio);
+    const int glyph_height = (int)(FANG_FONT_HEIGHT * ratio);
+
+    const size_t glyph_size = (size_t)glyph_width * (size_t)glyph_height;
+
+    /* Every texel could start a run in the worst case */
+    uint32_t * const texels = malloc(
+        FANG_GLYPH_COUNT * glyph_size * (sizeof(uint32_t) + sizeof(Fang_GlyphRun))
+    );
+
+    if (!texels)
+        return 1;
+
+    Fang_GlyphRun * const runs = (Fang_GlyphRun*)(
+        texels + FANG_GLYPH_COUNT * glyph_size
+    );
+
+    const Fang_Rect font_area = {.w = font->width, .h = font->height};
+    const Fang_Rect dest      = {.w = glyph_width, .h = glyph_height};
+
+    uint32_t count = 0;
+
+    for (int i = 0; i < FANG_GLYPH_COUNT; ++i)
+    {
+        const Fang_Rect glyph_area = Fang_GetGlyphArea(
+            (char)(FANG_GLYPH_FIRST + i)
+        );
+
+        const Fang_Rect source = Fang_ClipRect(&glyph_area, &font_area);
+
+        uint32_t * const glyph = texels + (size_t)i * glyph_size;
+
+        set->glyphs[i] = count;
+
+        for (int x = 0; x < glyph_width; ++x)
+        {
+            Fang_GlyphRun * run = NULL;
+
+            for (int y = 0; y < glyph_height; ++y)
+            {
+                const uint32_t pixel = Fang_SampleGlyph(
+                    font, &source, &dest, x, y
+                );
+
+                glyph[x * glyph_height + y] = pixel;
+
+                if (!(pixel & 0xFF))
+                {
+                    run = NULL;
+                    continue;
+                }
+
+                const bool opaque = (pixel & 0xFF) == UINT8_MAX;
+
+                if (!run || run->opaque != opaque)
+                {
+                    run = &runs[count++];
+
+                    *run = (Fang_GlyphRun){
+                        .x      = (uint16_t)x,
+                        .y      = (uint16_t)y,
+                        .opaque = opaque,
+                    };
+                }
+
+                run->length++;
+            }
+        }
+    }
+
+    set->glyphs[FANG_GLYPH_COUNT] = count;
+
+    set->pixels       = font->pixels;
+    set->height       = height;
+    set->glyph_width  = glyph_width;
+    set->glyph_height = glyph_height;
+    set->advance      = Fang_GetFontAdvance(height);
+    set->texels       = texels;
+    set->runs         = runs;
+    return 0;
+}
+
+/**
+ * Returns the glyphs of a font scaled to the given height, scaling them into
+ * the glyph cache if they are not already held.
+ *
+ * The returned set is only valid until the next call to this function. Returns
+ * NULL if the glyphs could not be allocated, or if they would be larger than
+ * the window, in which case the caller should draw from the font directly.
+**/
+static inline const Fang_GlyphSet *
+Fang_GetGlyphs(
+    const Fang_Image * const font,
+    const int                height)
+{
+    assert(Fang_ImageValid(font));
+    assert(font->width  == (FANG_FONT_WIDTH + 1) * (127 - FANG_GLYPH_FIRST));
+    assert(font->height == FANG_FONT_HEIGHT);
+
+    if (height <= 0 || height > FANG_WINDOW_SIZE)
+        return NULL;
+
+    Fang_GlyphCache * const cache = Fang_GetGlyphCache();
+
+    cache->clock++;
+
+    Fang_GlyphSet * oldest = &cache->sets[0];
+
+    for (int i = 0; i < FANG_GLYPHCACHE_SETS; ++i)
+    {
+        Fang_GlyphSet * const set = &cache->sets[i];
+
+        if (set->pixels == font->pixels && set->height == height)
+        {
+            set->last_use = cache->clock;
+            return set;
+        }
+
+        if (!set->pixels)
+            oldest = set;
+        else if (oldest->pixels && set->last_use < oldest->last_use)
+            oldest = set;
+    }
+
+    free(oldest->texels);
+    memset(oldest, 0, sizeof(Fang_GlyphSet));
+
+    if (Fang_BuildGlyphSet(font, height, oldest))
+        return NULL;
+
+    oldest->last_use = cache->clock;
+    return oldest;
+}
@@ -15,16 +15,45 @@
 
 typedef struct Fang_FrameState {
     bool        enable_depth;
+    bool        enable_interlace;
+    int         field;
     float       current_depth;
     Fang_Matrix transform;
 } Fang_FrameState;
 
+/**
+ * How the depth of a framebuffer's pixels is stored.
+ *
+ * Separate depth is kept in an image of its own. Interleaved depth is kept
+ * next to the color of each pixel in a single buffer, with the color and depth
+ * images both having a stride of 8 bytes, so that a depth-tested fragment only
+ * touches one cache line.
+**/
+typedef enum Fang_DepthLayout {
+    FANG_DEPTHLAYOUT_NONE,
+    FANG_DEPTHLAYOUT_SEPARATE,
+    FANG_DEPTHLAYOUT_INTERLEAVED,
+} Fang_DepthLayout;
+
 /**
  * A structure used for rendering to the screen.
  *
  * Framebuffers consist of two images:
  * - An RGBA color image whose result is drawn to the screen
  * - A depth buffer used internally to discard fragments
+ *
+ * Besides the framebuffer drawn to the screen, framebuffers can be allocated
+ * as offscreen render targets (see Fang_AllocFramebuffer()). Anything drawn
+ * into them is kept until they are cleared, and they can be composited into
+ * other framebuffers with Fang_CompositeFramebuffer(). Render targets which are
+ * only drawn to with depth testing disabled don't need a depth image.
+ *
+ * Both images share the same layout and pitch, so a fragment is found at the
+ * same offset in each (see Fang_GetFragmentOffset()). Column-major framebuffers
+ * keep the pixels of each column together, which suits the columns drawn for
+ * walls and sprites, and are transposed with Fang_TransposeImage() before
+ * being shown. Framebuffers with interleaved depth (see Fang_DepthLayout) are
+ * likewise copied with Fang_DeinterleaveImage() before being shown.
 **/
 typedef struct Fang_Framebuffer
 {
@@ -34,7 +63,68 @@ typedef struct Fang_Framebuffer
 } Fang_Framebuffer;
 
 /**
- * Writes a fragment of a given color to the framebuffer.
+ * Returns whether the framebuffer's depth is interleaved with its color (see
+ * Fang_DepthLayout).
+**/
+static inline bool
+Fang_DepthInterleaved(
+    const Fang_Framebuffer * const framebuf)
+{
+    assert(framebuf);
+
+    return (
+        framebuf->depth.pixels
+     && framebuf->depth.pixels == framebuf->color.pixels + 4
+    );
+}
+
+/**
+ * Returns the offset (in bytes) of the fragment at the given point within the
+ * framebuffer's color and depth images. The point must be within the images.
+**/
+static inline int
+Fang_GetFragmentOffset(
+    const Fang_Framebuffer * const framebuf,
+    const Fang_Point       * const point)
+{
+    assert(framebuf);
+    assert(point);
+    assert(point->x >= 0 && point->x < framebuf->color.width);
+    assert(point->y >= 0 && point->y < framebuf->color.height);
+    assert(
+        !Fang_ImageValid(&framebuf->depth)
+     || (framebuf->depth.layout == framebuf->color.layout
+     &&  framebuf->depth.pitch  == framebuf->color.pitch
+     &&  framebuf->depth.stride == framebuf->color.stride)
+    );
+
+    return point->x * Fang_GetPixelStepX(&framebuf->color)
+         + point->y * Fang_GetPixelStepY(&framebuf->color);
+}
+
+/**
+ * Returns whether the given column is drawn to this frame.
+ *
+ * With interlacing enabled, only the columns of the current field (those whose
+ * parity matches it) are drawn, and the passes which draw the world skip the
+ * others. Those are then filled in with Fang_ReconstructFramebuffer().
+**/
+static inline bool
+Fang_ColumnDrawn(
+    const Fang_Framebuffer * const framebuf,
+    const int                      x)
+{
+    assert(framebuf);
+
+    return !framebuf->state.enable_interlace
+        || (x & 1) == framebuf->state.field;
+}
+
+/**
+ * Writes a fragment of a given packed pixel to the framebuffer.
+ *
+ * The pixel must be packed in the same format as Fang_MapColor() and have its
+ * color channels premultiplied by its alpha.
  *
  * This routine utilizes the framebuffer's depth when placing fragments. If the
  * depth buffer is enabled, its buffer is checked to see if a value has already
@@ -45,17 +135,20 @@ typedef struct Fang_Framebuffer
  * then the depth is written to and the color is written into the color image.
  * If the point lies outside the framebuffer bounds this function does nothing.
  *
+ * Opaque pixels are copied directly into the color image, while translucent
+ * ones are blended with Fang_BlendPixel().
+ *
  * The framebuffer must have a color image.
 **/
 static inline bool
-Fang_SetFragment(
+Fang_SetPackedFragment(
     const Fang_Framebuffer * const framebuf,
     const Fang_Point       * const point,
-    const Fang_Color       * const color)
+    const uint32_t                 pixel)
 {
     assert(framebuf);
     assert(Fang_ImageValid(&framebuf->color));
-    assert(framebuf->color.stride == 4);
+    assert(framebuf->color.stride == 4 || Fang_DepthInterleaved(framebuf));
 
     const Fang_Point trans_point = Fang_MultMatrix(
         framebuf->state.transform, *point
@@ -67,9 +160,13 @@ Fang_SetFragment(
     if (trans_point.y < 0 || trans_point.y >= framebuf->color.height)
         return false;
 
-    if (!color->a)
+    const uint32_t alpha = pixel & 0xFF;
+
+    if (!alpha)
         return false;
 
+    const int offset = Fang_GetFragmentOffset(framebuf, &trans_point);
+
     bool write = true;
 
     if (framebuf->state.enable_depth)
@@ -78,39 +175,185 @@ Fang_SetFragment(
 
         assert(framebuf->depth.width  == framebuf->color.width);
         assert(framebuf->depth.height == framebuf->color.height);
-        assert(framebuf->depth.stride == 4);
+        assert(framebuf->depth.stride == framebuf->color.stride);
 
-        float * const dest = (float*)(
-            framebuf->depth.pixels
-          + trans_point.y * framebuf->depth.pitch
-          + trans_point.x * framebuf->depth.stride
-        );
+        float * const dest = (float*)(framebuf->depth.pixels + offset);
 
         if (*dest < framebuf->state.current_depth)
             write = false;
-        else if (*dest == FLT_MAX || color->a == UINT8_MAX)
+        else if (*dest == FLT_MAX || alpha == UINT8_MAX)
             *dest = framebuf->state.current_depth;
     }
 
     if (write)
     {
-        uint32_t * const dest = (uint32_t*)(
-            framebuf->color.pixels
-          + trans_point.y * framebuf->color.pitch
-          + trans_point.x * framebuf->color.stride
-        );
-
-        Fang_Color dest_color    = Fang_GetColor(*dest);
-        Fang_Color blended_color = Fang_BlendColor(color, &dest_color);
-        *dest = Fang_MapColor(&blended_color);
+        uint32_t * const dest = (uint32_t*)(framebuf->color.pixels + offset);
+
+        *dest = (alpha == UINT8_MAX) ? pixel : Fang_BlendPixel(pixel, *dest);
     }
 
     return write;
 }
 
+/**
+ * Writes a fragment of an opaque packed pixel to the framebuffer.
+ *
+ * This is the same as Fang_SetPackedFragment(), but the pixel's alpha must be
+ * fully opaque, so it is never blended. Drawing routines which already know
+ * their pixels are opaque (such as from an image's spans) can skip the checks.
+**/
+static inline bool
+Fang_SetOpaqueFragment(
+    const Fang_Framebuffer * const framebuf,
+    const Fang_Point       * const point,
+    const uint32_t                 pixel)
+{
+    assert(framebuf);
+    assert(Fang_ImageValid(&framebuf->color));
+    assert(framebuf->color.stride == 4 || Fang_DepthInterleaved(framebuf));
+    assert((pixel & 0xFF) == UINT8_MAX);
+
+    const Fang_Point trans_point = Fang_MultMatrix(
+        framebuf->state.transform, *point
+    );
+
+    if (trans_point.x < 0 || trans_point.x >= framebuf->color.width)
+        return false;
+
+    if (trans_point.y < 0 || trans_point.y >= framebuf->color.height)
+        return false;
+
+    const int offset = Fang_GetFragmentOffset(framebuf, &trans_point);
+
+    if (framebuf->state.enable_depth)
+    {
+        assert(Fang_ImageValid(&framebuf->depth));
+
+        assert(framebuf->depth.width  == framebuf->color.width);
+        assert(framebuf->depth.height == framebuf->color.height);
+        assert(framebuf->depth.stride == framebuf->color.stride);
+
+        float * const dest = (float*)(framebuf->depth.pixels + offset);
+
+        if (*dest < framebuf->state.current_depth)
+            return false;
+
+        *dest = framebuf->state.current_depth;
+    }
+
+    *(uint32_t*)(framebuf->color.pixels + offset) = pixel;
+
+    return true;
+}
+
+/**
+ * Returns whether the framebuffer's transform only moves fragments by a whole
+ * number of pixels, in which case the offset is stored in the result.
+ *
+ * Drawing routines can then address the color image directly, rather than
+ * transforming each fragment.
+**/
+static inline bool
+Fang_GetFrameOffset(
+    const Fang_Framebuffer * const framebuf,
+          Fang_Point       * const result)
+{
+    assert(framebuf);
+    assert(result);
+
+    const Fang_Matrix transform = framebuf->state.transform;
+
+    if (transform.m00 != 1.0f || transform.m01 != 0.0f
+    ||  transform.m10 != 0.0f || transform.m11 != 1.0f
+    ||  transform.m20 != 0.0f || transform.m21 != 0.0f
+    ||  transform.m22 != 1.0f)
+        return false;
+
+    if (transform.m02 != floorf(transform.m02)
+    ||  transform.m12 != floorf(transform.m12))
+        return false;
+
+    *result = (Fang_Point){
+        .x = (int)transform.m02,
+        .y = (int)transform.m12,
+    };
+
+    return true;
+}
+
+/**
+ * Writes a vertical run of packed pixels straight into the color image, without
+ * transforming or depth testing them. The point is where the first pixel is
+ * placed in the color image, with each following pixel being read a given
+ * number of pixels further into the source.
+ *
+ * Opaque runs are copied, otherwise each pixel is blended with
+ * Fang_BlendPixel(). Pixels outside the color image are discarded.
+**/
+static inline void
+Fang_SetFragmentRun(
+    const Fang_Framebuffer * const framebuf,
+    const Fang_Point       * const point,
+    const uint32_t         *       pixels,
+    const int                      step,
+    const int                      length,
+    const bool                     opaque)
+{
+    assert(framebuf);
+    assert(Fang_ImageValid(&framebuf->color));
+    assert(framebuf->color.stride == 4 || Fang_DepthInterleaved(framebuf));
+    assert(point);
+    assert(pixels);
+
+    if (point->x < 0 || point->x >= framebuf->color.width)
+        return;
+
+    const int start_y = max(point->y, 0);
+    const int end_y   = min(point->y + length, framebuf->color.height);
+
+    if (start_y >= end_y)
+        return;
+
+    pixels += (start_y - point->y) * step;
+
+    const int dest_step = Fang_GetPixelStepY(&framebuf->color);
+
+    uint8_t * dest = framebuf->color.pixels + Fang_GetFragmentOffset(
+        framebuf, &(Fang_Point){point->x, start_y}
+    );
+
+    for (int y = start_y; y < end_y; ++y, pixels += step)
+    {
+        *(uint32_t*)dest = (opaque)
+            ? *pixels
+            : Fang_BlendPixel(*pixels, *(uint32_t*)dest);
+
+        dest += dest_step;
+    }
+}
+
+/**
+ * Writes a fragment of a given color to the framebuffer.
+ *
+ * The color uses straight (non-premultiplied) alpha. See
+ * Fang_SetPackedFragment() for details on how the fragment is placed.
+**/
+static inline bool
+Fang_SetFragment(
+    const Fang_Framebuffer * const framebuf,
+    const Fang_Point       * const point,
+    const Fang_Color       * const color)
+{
+    assert(color);
+
+    return Fang_SetPackedFragment(
+        framebuf, point, Fang_PremultiplyPixel(Fang_MapColor(color))
+    );
+}
+
 /**
  * Calculates a shade using the current depth buffer and blends the result into
- * the framebuffer's color image.
+ * the columns between start_x and end_x of the framebuffer's color image.
  *
  * This is utilized for drawing fog at the end of the frame.
 **/
@@ -118,7 +361,9 @@ static inline void
 Fang_ShadeFramebuffer(
           Fang_Framebuffer * const framebuf,
     const Fang_Color       * const color,
-    const float                    dist)
+    const float                    dist,
+    const int                      start_x,
+    const int                      end_x)
 {
     assert(framebuf);
     assert(Fang_ImageValid(&framebuf->color));
@@ -126,21 +371,38 @@ Fang_ShadeFramebuffer(
     assert(framebuf->color.width  == framebuf->depth.width);
     assert(framebuf->color.height == framebuf->depth.height);
     assert(framebuf->color.stride == framebuf->depth.stride);
-    assert(framebuf->color.stride == 4);
+    assert(framebuf->color.stride == 4 || Fang_DepthInterleaved(framebuf));
     assert(color);
+    assert(start_x >= 0);
+    assert(end_x <= framebuf->color.width);
 
-    if (dist == 0.0f)
+    if (dist == 0.0f || start_x >= end_x)
         return;
 
-    for (int x = 0; x < framebuf->color.width; ++x)
+    /* Pixels are visited in memory order, along each row (or column) */
+    const bool columns = framebuf->color.layout == FANG_IMAGELAYOUT_COLUMNS;
+
+    const int step_x = Fang_GetPixelStepX(&framebuf->color);
+    const int step_y = Fang_GetPixelStepY(&framebuf->color);
+
+    const int lines  = (columns) ? end_x - start_x : framebuf->color.height;
+    const int length = (columns) ? framebuf->color.height : end_x - start_x;
+
+    const int line_step  = (columns) ? step_x : step_y;
+    const int pixel_step = (columns) ? step_y : step_x;
+
+    for (int i = 0; i < lines; ++i)
     {
-        for (int y = 0; y < framebuf->color.height; ++y)
+        for (int j = 0; j < length; ++j)
         {
-            float depth = *(float*)(
-                framebuf->depth.pixels
-              + y * framebuf->depth.pitch
-              + x * framebuf->depth.stride
-            );
+            if (!Fang_ColumnDrawn(framebuf, start_x + ((columns) ? i : j)))
+                continue;
+
+            const int offset = start_x * step_x
+                             + i * line_step
+                             + j * pixel_step;
+
+            float depth = *(float*)(framebuf->depth.pixels + offset);
 
             if (depth == FLT_MAX)
                 continue;
@@ -148,23 +410,21 @@ Fang_ShadeFramebuffer(
             depth = clamp(depth / dist, 0.0f, 1.0f);
 
             uint32_t * const dest = (uint32_t*)(
-                framebuf->color.pixels
-              + y * framebuf->color.pitch
-              + x * framebuf->color.stride
+                framebuf->color.pixels + offset
             );
 
-            Fang_Color dest_color    = Fang_GetColor(*dest);
-            Fang_Color blended_color = Fang_BlendColor(
-                &(Fang_Color){
-                    .r = color->r,
-                    .g = color->g,
-                    .b = color->b,
-                    .a = (uint8_t)(depth * 255.0f),
-                },
-                &dest_color
+            const uint32_t shade = Fang_PremultiplyPixel(
+                Fang_MapColor(
+                    &(Fang_Color){
+                        .r = color->r,
+                        .g = color->g,
+                        .b = color->b,
+                        .a = (uint8_t)(depth * 255.0f),
+                    }
+                )
             );
 
-            *dest = Fang_MapColor(&blended_color);
+            *dest = Fang_BlendPixel(shade, *dest);
         }
     }
 }
@@ -231,3 +491,251 @@ Fang_SetViewport(
 
     return state;
 }
+
+/**
+ * Allocates the images of a framebuffer of the given size and layout (see
+ * Fang_AllocPaddedImage()), with its depth stored in the given way (if at all).
+ * The framebuffer must not already hold any images.
+ *
+ * The framebuffer's state is reset, with no transform and depth testing enabled
+ * if it has a depth image. Colors are premultiplied by their alpha, so the
+ * color image is flagged as such and can be drawn like any other premultiplied
+ * image.
+ *
+ * Returns non-zero if the images could not be allocated, in which case the
+ * framebuffer is left empty.
+**/
+static inline int
+Fang_AllocFramebuffer(
+          Fang_Framebuffer * const framebuf,
+    const int                      width,
+    const int                      height,
+    const Fang_DepthLayout         depth,
+    const Fang_ImageLayout         layout)
+{
+    assert(framebuf);
+    assert(!framebuf->color.pixels);
+    assert(!framebuf->depth.pixels);
+    assert(width  > 0);
+    assert(height > 0);
+
+    memset(framebuf, 0, sizeof(Fang_Framebuffer));
+
+    const bool interleaved = depth == FANG_DEPTHLAYOUT_INTERLEAVED;
+
+    if (Fang_AllocPaddedImage(
+            &framebuf->color, width, height, (interleaved) ? 64 : 32, layout))
+        goto Error_Color;
+
+    if (depth == FANG_DEPTHLAYOUT_SEPARATE
+    &&  Fang_AllocPaddedImage(&framebuf->depth, width, height, 32, layout))
+        goto Error_Depth;
+
+    /* The depth image addresses the second half of each pixel */
+    if (interleaved)
+    {
+        framebuf->depth         = framebuf->color;
+        framebuf->depth.pixels += 4;
+        framebuf->depth.flags   = FANG_IMAGEFLAG_BORROWED;
+    }
+
+    framebuf->color.flags = FANG_IMAGEFLAG_PREMULTIPLIED;
+
+    framebuf->state = (Fang_FrameState){
+        .enable_depth  = depth != FANG_DEPTHLAYOUT_NONE,
+        .current_depth = 0.0f,
+        .transform     = Fang_IdentityMatrix(),
+    };
+
+    return 0;
+
+Error_Depth:
+    Fang_FreeImage(&framebuf->color);
+
+Error_Color:
+    memset(framebuf, 0, sizeof(Fang_Framebuffer));
+    return 1;
+}
+
+/**
+ * Clears the columns between start_x and end_x of the framebuffer's color image
+ * to transparent black, and those of its depth image (if any) so that every
+ * fragment passes the depth test.
+**/
+static inline void
+Fang_ClearFramebufferColumns(
+          Fang_Framebuffer * const framebuf,
+    const int                      start_x,
+    const int                      end_x)
+{
+    assert(framebuf);
+    assert(Fang_ImageValid(&framebuf->color));
+    assert(framebuf->color.stride == 4 || Fang_DepthInterleaved(framebuf));
+    assert(start_x >= 0);
+    assert(start_x <= end_x);
+    assert(end_x <= framebuf->color.width);
+
+    const bool depth       = Fang_ImageValid(&framebuf->depth);
+    const bool interleaved = Fang_DepthInterleaved(framebuf);
+
+    assert(!depth || framebuf->depth.stride == framebuf->color.stride);
+    assert(!depth || framebuf->depth.width == framebuf->color.width);
+    assert(!depth || framebuf->depth.pitch == framebuf->color.pitch);
+
+    const int stride = framebuf->color.stride;
+
+    /* The columns are either a run of each row, or a run of whole columns */
+    const bool columns = framebuf->color.layout == FANG_IMAGELAYOUT_COLUMNS;
+
+    const int lines  = (columns) ? 1 : framebuf->color.height;
+    const int length = (columns)
+        ? (end_x - start_x) * framebuf->color.pitch / stride
+        : end_x - start_x;
+
+    const int start = start_x * Fang_GetPixelStepX(&framebuf->color);
+
+    /* Interleaved pixels are cleared whole, with their depth after the color */
+    uint64_t cleared = 0;
+
+    if (interleaved)
+    {
+        const float far_depth = FLT_MAX;
+        memcpy((uint8_t*)&cleared + 4, &far_depth, sizeof(far_depth));
+    }
+
+    for (int i = 0; i < lines; ++i)
+    {
+        const int offset = start + i * framebuf->color.pitch;
+
+        if (interleaved)
+        {
+            uint64_t * const line = (uint64_t*)(void*)(
+                framebuf->color.pixels + offset
+            );
+
+            for (int j = 0; j < length; ++j)
+                line[j] = cleared;
+
+            continue;
+        }
+
+        memset(framebuf->color.pixels + offset, 0, (size_t)length * 4);
+
+        if (!depth)
+            continue;
+
+        float * const line = (float*)(framebuf->depth.pixels + offset);
+
+        for (int j = 0; j < length; ++j)
+            line[j] = FLT_MAX;
+    }
+}
+
+/**
+ * Clears the whole framebuffer in the same way as
+ * Fang_ClearFramebufferColumns().
+**/
+static inline void
+Fang_ClearFramebuffer(
+    Fang_Framebuffer * const framebuf)
+{
+    assert(framebuf);
+    assert(Fang_ImageValid(&framebuf->color));
+
+    if (!Fang_ImageValid(&framebuf->depth))
+    {
+        Fang_ClearImage(&framebuf->color);
+        return;
+    }
+
+    Fang_ClearFramebufferColumns(framebuf, 0, framebuf->color.width);
+}
+
+/**
+ * Copies the color and depth of one framebuffer into another of the same size,
+ * layout and depth layout.
+**/
+static inline void
+Fang_CopyFramebuffer(
+          Fang_Framebuffer * const dest,
+    const Fang_Framebuffer * const source)
+{
+    assert(dest);
+    assert(source);
+    assert(Fang_ImageValid(&dest->color));
+    assert(Fang_ImageValid(&source->color));
+    assert(dest->color.width  == source->color.width);
+    assert(dest->color.height == source->color.height);
+    assert(dest->color.layout == source->color.layout);
+    assert(dest->color.pitch  == source->color.pitch);
+    assert(Fang_DepthInterleaved(dest) == Fang_DepthInterleaved(source));
+
+    const Fang_Image * const color = &source->color;
+
+    const int lines = (color->layout == FANG_IMAGELAYOUT_COLUMNS)
+        ? color->width
+        : color->height;
+
+    memcpy(dest->color.pixels, color->pixels, (size_t)(color->pitch * lines));
+
+    /* Interleaved depth has been copied along with the color */
+    if (Fang_DepthInterleaved(source)
+    || !Fang_ImageValid(&source->depth)
+    || !Fang_ImageValid(&dest->depth))
+        return;
+
+    assert(dest->depth.pitch == source->depth.pitch);
+
+    memcpy(
+        dest->depth.pixels,
+        source->depth.pixels,
+        (size_t)(source->depth.pitch * lines)
+    );
+}
+
+/**
+ * Frees the framebuffer's images.
+**/
+static inline void
+Fang_FreeFramebuffer(
+    Fang_Framebuffer * const framebuf)
+{
+    assert(framebuf);
+
+    Fang_FreeImage(&framebuf->color);
+    Fang_FreeImage(&framebuf->depth);
+
+    memset(framebuf, 0, sizeof(Fang_Framebuffer));
+}
+
+/**
+ * Allocates a cleared render target of the given size for a cached layer (such
+ * as those of the HUD and minimap), freeing the one it held before. Layers are
+ * drawn without depth testing, so they have no depth image.
+ *
+ * Returns non-zero if the layer could not be allocated.
+**/
+static inline int
+Fang_AllocLayer(
+          Fang_Framebuffer * const layer,
+    const int                      width,
+    const int                      height)
+{
+    assert(layer);
+
+    Fang_FreeFramebuffer(layer);
+
+    if (width <= 0 || height <= 0)
+        return 1;
+
+    if (Fang_AllocFramebuffer(
+            layer,
+            width,
+            height,
+            FANG_DEPTHLAYOUT_NONE,
+            FANG_IMAGELAYOUT_ROWS))
+        return 1;
+
+    Fang_ClearFramebuffer(layer);
+    return 0;
+}
@@ -0,0 +1,44 @@
+// Copyright (C) 2021  Antonio Lassandro
+
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+
+// You should have received a copy of the GNU General Public License along
+// with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+/**
+ * The value that hashes built with Fang_HashData() start from.
+**/
+static const uint64_t FANG_HASH_INITIAL = UINT64_C(0xCBF29CE484222325);
+
+/**
+ * Adds data to a running FNV-1a hash.
+ *
+ * Hashes are used to tell whether something drawn earlier can be reused, so
+ * everything the drawing depends on should be added to its hash.
+**/
+static inline uint64_t
+Fang_HashData(
+          uint64_t         hash,
+    const void     * const data,
+    const size_t           size)
+{
+    assert(data);
+
+    const uint8_t * const bytes = (const uint8_t*)data;
+
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= UINT64_C(0x100000001B3);
+    }
+
+    return hash;
+}
@@ -0,0 +1,313 @@
+// Copyright (C) 2021  Antonio Lassandro
+
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+
+// You should have received a copy of the GNU General Public License along
+// with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+/**
+ * The pieces of text shown on the heads-up display.
+**/
+typedef enum Fang_HudTextId {
+    FANG_HUDTEXT_WEAPON,
+    FANG_HUDTEXT_AMMO,
+    FANG_HUDTEXT_HEALTH,
+    FANG_HUDTEXT_POSITION,
+
+    FANG_NUM_HUDTEXT,
+} Fang_HudTextId;
+
+/**
+ * A piece of HUD text along with the layer it has been drawn into.
+**/
+typedef struct Fang_HudText {
+    char             text[32];
+    Fang_Framebuffer layer;
+    Fang_Point       position;
+} Fang_HudText;
+
+/**
+ * The heads-up display, which is drawn from cached layers.
+ *
+ * The weapon is scaled to the size of the viewport once and kept in its own
+ * layer, so that it can be moved by the player's sway each frame. Each piece of
+ * text is kept in a layer of its own as well, and is only redrawn when the
+ * value it shows changes. Every layer is a render target whose color image has
+ * its spans measured, so compositing the HUD only touches its visible runs,
+ * copying the opaque ones and blending the rest.
+ *
+ * The values last shown are kept so that changes can be found without
+ * formatting any text.
+**/
+typedef struct Fang_Hud {
+          Fang_Framebuffer  weapon_layer;
+    const uint8_t         * weapon_pixels;
+    const uint8_t         * font_pixels;
+          Fang_HudText      texts[FANG_NUM_HUDTEXT];
+          Fang_WeaponType   weapon;
+          int               ammo;
+          int               health;
+          Fang_Vec2         position;
+          bool              valid;
+} Fang_Hud;
+
+/**
+ * Draws a piece of text into its layer, which is placed at the given position
+ * on the HUD.
+ *
+ * If the text could not be drawn, its layer is left empty and the text is not
+ * shown.
+**/
+static inline void
+Fang_SetHudText(
+          Fang_HudText * const hud_text,
+    const char         * const text,
+    const Fang_Image   * const font,
+    const Fang_Point   * const position)
+{
+    assert(hud_text);
+    assert(text);
+    assert(position);
+
+    snprintf(hud_text->text, sizeof(hud_text->text), "%s", text);
+    hud_text->position = *position;
+
+    const Fang_Rect area = Fang_MeasureText(hud_text->text, FANG_FONT_HEIGHT);
+
+    if (!Fang_ImageValid(font)
+    ||  Fang_AllocLayer(&hud_text->layer, area.w, area.h))
+    {
+        Fang_FreeFramebuffer(&hud_text->layer);
+        return;
+    }
+
+    Fang_DrawText(
+        &hud_text->layer, hud_text->text, font, FANG_FONT_HEIGHT, NULL
+    );
+    Fang_BuildImageSpans(&hud_text->layer.color);
+}
+
+/**
+ * Scales the weapon into its layer, covering the given viewport.
+**/
+static inline void
+Fang_SetHudWeapon(
+          Fang_Hud   * const hud,
+    const Fang_Image * const texture,
+    const Fang_Rect  * const viewport)
+{
+    assert(hud);
+    assert(viewport);
+
+    hud->weapon_pixels = (texture) ? texture->pixels : NULL;
+
+    if (!texture
+    ||  Fang_AllocLayer(&hud->weapon_layer, viewport->w, viewport->h))
+    {
+        Fang_FreeFramebuffer(&hud->weapon_layer);
+        return;
+    }
+
+    Fang_DrawImage(&hud->weapon_layer, texture, NULL, &(Fang_Rect){
+        .w = viewport->w,
+        .h = viewport->h,
+    });
+
+    Fang_BuildImageSpans(&hud->weapon_layer.color);
+}
+
+/**
+ * Brings the HUD's layers up to date with the given player, redrawing only the
+ * layers whose values have changed since they were last drawn.
+**/
+static inline void
+Fang_UpdateHud(
+          Fang_Hud      * const hud,
+    const Fang_Textures * const textures,
+    const Fang_Entity   * const player,
+    const Fang_Rect     * const viewport)
+{
+    assert(hud);
+    assert(textures);
+    assert(player);
+    assert(player->type == FANG_ENTITYTYPE_PLAYER);
+    assert(viewport);
+
+    const Fang_PlayerProps * const props = &player->props.player;
+
+    const Fang_Image * const font = Fang_GetTexture(
+        textures, FANG_TEXTURE_FORMULA
+    );
+
+    /* Everything is redrawn once the font has loaded (or changed) */
+    const uint8_t * const font_pixels = (font) ? font->pixels : NULL;
+
+    const bool refresh = !hud->valid || hud->font_pixels != font_pixels;
+
+    const Fang_Weapon * const weapon = Fang_GetWeapon(props->weapon);
+
+    const Fang_Image * const weapon_texture = (weapon)
+        ? Fang_GetTexture(textures, weapon->texture)
+        : NULL;
+
+    const uint8_t * const weapon_pixels = (weapon_texture)
+        ? weapon_texture->pixels
+        : NULL;
+
+    const int ammo = (weapon) ? props->ammo[props->weapon] : 0;
+
+    const Fang_Vec2 position = {
+        .x = fmodf(player->body.pos.x, FANG_CHUNK_SIZE),
+        .y = fmodf(player->body.pos.y, FANG_CHUNK_SIZE),
+    };
+
+    if (!hud->valid || hud->weapon_pixels != weapon_pixels)
+        Fang_SetHudWeapon(hud, weapon_texture, viewport);
+
+    if (refresh || hud->weapon != props->weapon)
+    {
+        Fang_SetHudText(
+            &hud->texts[FANG_HUDTEXT_WEAPON],
+            (weapon) ? weapon->name : "",
+            font,
+            &(Fang_Point){.x = 5, .y = 3}
+        );
+    }
+
+    if (refresh || hud->weapon != props->weapon || hud->ammo != ammo)
+    {
+        char ammo_count[4] = "";
+
+        if (weapon)
+            snprintf(ammo_count, sizeof(ammo_count), "%03d", ammo);
+
+        Fang_SetHudText(
+            &hud->texts[FANG_HUDTEXT_AMMO],
+            ammo_count,
+            font,
+            &(Fang_Point){.x = 5, .y = 3 + FANG_FONT_HEIGHT}
+        );
+    }
+
+    if (refresh || hud->health != props->health)
+    {
+        char health[4] = "000";
+        snprintf(health, sizeof(health), "%3d", props->health);
+
+        Fang_SetHudText(
+            &hud->texts[FANG_HUDTEXT_HEALTH],
+            health,
+            font,
+            &(Fang_Point){
+                .x = viewport->w - 5 - (FANG_FONT_WIDTH * (int)strlen(health)),
+                .y = 3,
+            }
+        );
+    }
+
+    if (refresh
+    ||  hud->position.x != position.x
+    ||  hud->position.y != position.y)
+    {
+        char text[15];
+        snprintf(text, sizeof(text), "%3.2f, %3.2f", position.x, position.y);
+
+        /* Most movements don't change the displayed position */
+        if (refresh || strcmp(text, hud->texts[FANG_HUDTEXT_POSITION].text))
+        {
+            Fang_SetHudText(
+                &hud->texts[FANG_HUDTEXT_POSITION],
+                text,
+                font,
+                &(Fang_Point){
+                    .x = 3,
+                    .y = viewport->h - FANG_FONT_HEIGHT - 3,
+                }
+            );
+        }
+    }
+
+    hud->font_pixels = font_pixels;
+    hud->weapon      = props->weapon;
+    hud->ammo        = ammo;
+    hud->health      = props->health;
+    hud->position    = position;
+    hud->valid       = true;
+}
+
+/**
+ * Composites the HUD's layers into the framebuffer, with the weapon moved by
+ * the given offset.
+**/
+static inline void
+Fang_DrawHud(
+          Fang_Framebuffer * const framebuf,
+    const Fang_Hud         * const hud,
+    const Fang_Point       * const weapon_offset)
+{
+    assert(framebuf);
+    assert(hud);
+    assert(weapon_offset);
+
+    const Fang_Framebuffer * const weapon = &hud->weapon_layer;
+
+    if (Fang_ImageValid(&weapon->color))
+    {
+        Fang_CompositeFramebuffer(
+            framebuf,
+            weapon,
+            &(Fang_Rect){
+                .x = weapon_offset->x,
+                .y = weapon_offset->y,
+                .w = weapon->color.width,
+                .h = weapon->color.height,
+            },
+            UINT8_MAX
+        );
+    }
+
+    for (int i = 0; i < FANG_NUM_HUDTEXT; ++i)
+    {
+        const Fang_HudText * const hud_text = &hud->texts[i];
+
+        if (!Fang_ImageValid(&hud_text->layer.color))
+            continue;
+
+        Fang_CompositeFramebuffer(
+            framebuf,
+            &hud_text->layer,
+            &(Fang_Rect){
+                .x = hud_text->position.x,
+                .y = hud_text->position.y,
+                .w = hud_text->layer.color.width,
+                .h = hud_text->layer.color.height,
+            },
+            UINT8_MAX
+        );
+    }
+}
+
+/**
+ * Frees the HUD's layers.
+**/
+static inline void
+Fang_FreeHud(
+    Fang_Hud * const hud)
+{
+    assert(hud);
+
+    Fang_FreeFramebuffer(&hud->weapon_layer);
+
+    for (int i = 0; i < FANG_NUM_HUDTEXT; ++i)
+        Fang_FreeFramebuffer(&hud->texts[i].layer);
+
+    memset(hud, 0, sizeof(Fang_Hud));
+}
@@ -13,17 +13,176 @@
 // You should have received a copy of the GNU General Public License along
 // with this program.  If not, see <http://www.gnu.org/licenses/>.
 
+/**
+ * The order in which an image's pixels are stored.
+ *
+ * Row-major images store each row contiguously, with the pitch being the
+ * distance (in bytes) between the start of each row. Column-major images store
+ * each column contiguously, with the pitch being the distance between the start
+ * of each column instead.
+ *
+ * Swizzled images are strips of square faces (whose size is a power of two)
+ * laid side by side, where each face is stored in Z-order: the bits of a
+ * pixel's X and Y coordinates are interleaved to form its index. Neighbouring
+ * pixels in any direction are then usually close together in memory, which
+ * suits images sampled along arbitrary lines (such as floors). The pitch is
+ * that of a row-major image, but does not address rows.
+**/
+typedef enum Fang_ImageLayout {
+    FANG_IMAGELAYOUT_ROWS,
+    FANG_IMAGELAYOUT_COLUMNS,
+    FANG_IMAGELAYOUT_SWIZZLED,
+} Fang_ImageLayout;
+
+/**
+ * Flags describing how an image's pixels should be interpreted.
+ *
+ * Premultiplied images store their color channels already multiplied by the
+ * alpha channel, which lets them be blended without any divisions.
+ *
+ * Palettized images store a single byte per pixel, which is an index into the
+ * image's palette of packed 32-bit colors.
+ *
+ * Borrowed images point into memory owned by something else (such as a mapped
+ * asset pack), which is read-only and must not be freed with the image.
+**/
+typedef enum Fang_ImageFlags {
+    FANG_IMAGEFLAG_NONE          = 0,
+    FANG_IMAGEFLAG_PREMULTIPLIED = 1 << 0,
+    FANG_IMAGEFLAG_PALETTIZED    = 1 << 1,
+    FANG_IMAGEFLAG_BORROWED      = 1 << 2,
+} Fang_ImageFlags;
+
+/**
+ * A run of texels within a column of an image, none of which are fully
+ * transparent. Opaque runs are made up of only fully opaque texels.
+**/
+typedef struct Fang_ImageSpan {
+    uint16_t start;
+    uint16_t end;
+    bool     opaque;
+} Fang_ImageSpan;
+
+/**
+ * The run-length encoded opacity of each of an image's columns.
+ *
+ * The runs of every column are stored one after another from top to bottom,
+ * with columns[x] being the index of the first run of column x (columns[width]
+ * is the total number of runs). Fully transparent runs are the gaps between
+ * runs, so drawing routines can skip them without reading any texels.
+ *
+ * Opaque images are made up of a single opaque run per column.
+**/
+typedef struct Fang_ImageSpans {
+    uint32_t       * columns;
+    Fang_ImageSpan * spans;
+    bool             opaque;
+} Fang_ImageSpans;
+
 /**
  * A container for image pixel data.
+ *
+ * Images loaded by the game are normalized to 32-bit pixels packed in the same
+ * format as Fang_MapColor(), so they can be copied into the framebuffer as-is.
+ * Palettized images keep their packed colors in the palette instead.
+ *
+ * Images may also carry the spans of their columns, which are owned by the
+ * image even when its pixels are borrowed.
 **/
 typedef struct Fang_Image {
-    uint8_t * pixels;
-    int       width;
-    int       height;
-    int       pitch;
-    int       stride;
+    uint8_t          * pixels;
+    uint32_t         * palette;
+    Fang_ImageSpans  * spans;
+    int                width;
+    int                height;
+    int                pitch;
+    int                stride;
+    Fang_ImageLayout   layout;
+    int                flags;
 } Fang_Image;
 
+/**
+ * The pixels of allocated images start on a cache line of this many bytes.
+**/
+enum {
+    FANG_IMAGE_ALIGNMENT = 64,
+};
+
+/**
+ * The number of pixels on each side of the blocks an image is transposed in
+ * (see Fang_TransposeImage()).
+**/
+enum {
+    FANG_TRANSPOSE_BLOCK = 16,
+};
+
+/**
+ * The number of colors held by the palette of a palettized image.
+**/
+enum {
+    FANG_PALETTE_SIZE = 256,
+};
+
+/**
+ * A small cache of decoded columns from palettized images.
+ *
+ * Drawing routines which read an image column-by-column (such as walls and
+ * sprites) can request a decoded column and read it as a contiguous run of
+ * 32-bit texels. The cache is set-associative, with each set being indexed by
+ * the column number and holding a handful of entries replaced in
+ * least-recently-used order.
+**/
+enum {
+    FANG_COLUMNCACHE_SETS = 16,
+    FANG_COLUMNCACHE_WAYS = 4,
+};
+
+typedef struct Fang_ColumnCacheEntry {
+    const uint8_t * pixels;
+    int             column;
+    uint32_t        last_use;
+    uint32_t        texels[FANG_TEXTURE_SIZE];
+} Fang_ColumnCacheEntry;
+
+typedef struct Fang_ColumnCache {
+    Fang_ColumnCacheEntry entries[FANG_COLUMNCACHE_SETS][FANG_COLUMNCACHE_WAYS];
+    uint32_t              clock;
+} Fang_ColumnCache;
+
+/**
+ * Returns the cache shared by all palettized images.
+**/
+static inline Fang_ColumnCache *
+Fang_GetColumnCache(void)
+{
+    static Fang_ColumnCache cache = {.clock = 0};
+    return &cache;
+}
+
+/**
+ * Removes all of the cached columns belonging to the given pixel data.
+ *
+ * This must be called before the pixel data is freed, otherwise a new image
+ * allocated at the same address could be served stale columns.
+**/
+static inline void
+Fang_EvictColumns(
+    const uint8_t * const pixels)
+{
+    Fang_ColumnCache * const cache = Fang_GetColumnCache();
+
+    for (int set = 0; set < FANG_COLUMNCACHE_SETS; ++set)
+    {
+        for (int way = 0; way < FANG_COLUMNCACHE_WAYS; ++way)
+        {
+            Fang_ColumnCacheEntry * const entry = &cache->entries[set][way];
+
+            if (entry->pixels == pixels)
+                entry->pixels = NULL;
+        }
+    }
+}
+
 static inline bool
 Fang_ImageValid(
     const Fang_Image * const image)
@@ -38,6 +197,41 @@ Fang_ImageValid(
     );
 }
 
+/**
+ * Allocates a pixel buffer of the given size, starting on a cache line (see
+ * FANG_IMAGE_ALIGNMENT).
+ *
+ * The distance from the start of the allocation is kept in the byte before the
+ * pixels, so that the buffer can be released with Fang_FreePixels().
+**/
+static inline uint8_t *
+Fang_AllocPixels(
+    const size_t size)
+{
+    uint8_t * const memory = malloc(size + FANG_IMAGE_ALIGNMENT);
+
+    if (!memory)
+        return NULL;
+
+    const size_t offset = FANG_IMAGE_ALIGNMENT - (
+        (uintptr_t)memory % FANG_IMAGE_ALIGNMENT
+    );
+
+    memory[offset - 1] = (uint8_t)offset;
+    return memory + offset;
+}
+
+/**
+ * Releases a pixel buffer allocated with Fang_AllocPixels().
+**/
+static inline void
+Fang_FreePixels(
+    uint8_t * const pixels)
+{
+    if (pixels)
+        free(pixels - pixels[-1]);
+}
+
 /**
  * Sets the image attributes and allocates a pixel buffer for the image.
  *
@@ -58,7 +252,54 @@ Fang_AllocImage(
     image->height = height;
     image->stride = (depth + 7) >> 3;
     image->pitch  = image->stride * width;
-    image->pixels = malloc((size_t)(image->pitch * height));
+    image->pixels = Fang_AllocPixels((size_t)(image->pitch * height));
+
+    if (!image->pixels)
+    {
+        memset(image, 0, sizeof(Fang_Image));
+        return 1;
+    }
+
+    return 0;
+}
+
+/**
+ * Allocates an image in the given row-major or column-major layout, where each
+ * row (or column) starts on a cache line.
+ *
+ * The pitch is padded to an odd number of cache lines, so that the pixels of
+ * neighbouring rows (or columns) fall into different sets of the cache instead
+ * of evicting one another. This suits images which are drawn across their
+ * lines, such as render targets.
+**/
+static inline int
+Fang_AllocPaddedImage(
+          Fang_Image       * const image,
+    const int                      width,
+    const int                      height,
+    const int                      depth,
+    const Fang_ImageLayout         layout)
+{
+    assert(image);
+    assert(!image->pixels);
+    assert(layout != FANG_IMAGELAYOUT_SWIZZLED);
+
+    const int stride = (depth + 7) >> 3;
+    const int lines  = (layout == FANG_IMAGELAYOUT_COLUMNS) ? width : height;
+    const int length = (layout == FANG_IMAGELAYOUT_COLUMNS) ? height : width;
+
+    assert(FANG_IMAGE_ALIGNMENT % stride == 0);
+
+    const int cache_lines = (
+        (stride * length + FANG_IMAGE_ALIGNMENT - 1) / FANG_IMAGE_ALIGNMENT
+    ) | 1;
+
+    image->width  = width;
+    image->height = height;
+    image->stride = stride;
+    image->layout = layout;
+    image->pitch  = cache_lines * FANG_IMAGE_ALIGNMENT;
+    image->pixels = Fang_AllocPixels((size_t)(image->pitch * lines));
 
     if (!image->pixels)
     {
@@ -73,7 +314,7 @@ Fang_AllocImage(
  * Frees an image's pixel data and clears the image's attributes.
  *
  * If the image was previously freed or not allocated, this function does
- * nothing.
+ * nothing. Borrowed images only have their spans freed.
 **/
 static inline void
 Fang_FreeImage(
@@ -81,7 +322,17 @@ Fang_FreeImage(
 {
     if (Fang_ImageValid(image))
     {
-        free(image->pixels);
+        if (image->flags & FANG_IMAGEFLAG_PALETTIZED)
+            Fang_EvictColumns(image->pixels);
+
+        if (!(image->flags & FANG_IMAGEFLAG_BORROWED))
+        {
+            Fang_FreePixels(image->pixels);
+            free(image->palette);
+        }
+
+        free(image->spans);
+
         memset(image, 0, sizeof(Fang_Image));
     }
 }
@@ -100,14 +351,359 @@ Fang_ClearImage(
 {
     assert(Fang_ImageValid(image));
 
-    memset((void*)image->pixels, 0, (size_t)(image->pitch * image->height));
+    const int lines = (image->layout == FANG_IMAGELAYOUT_COLUMNS)
+        ? image->width
+        : image->height;
+
+    memset((void*)image->pixels, 0, (size_t)(image->pitch * lines));
+}
+
+/**
+ * Spreads the lower 16 bits of a value out to the even bits of the result.
+ *
+ * Each byte is spread through a table, which is built by the macros below from
+ * the pairs of bits that make up its index.
+**/
+#define FANG_SPREAD_2(n) (n), (n) + 1, (n) + 4, (n) + 5
+#define FANG_SPREAD_4(n) \
+    FANG_SPREAD_2(n),        FANG_SPREAD_2((n) + 16), \
+    FANG_SPREAD_2((n) + 64), FANG_SPREAD_2((n) + 80)
+#define FANG_SPREAD_6(n) \
+    FANG_SPREAD_4(n),          FANG_SPREAD_4((n) + 256), \
+    FANG_SPREAD_4((n) + 1024), FANG_SPREAD_4((n) + 1280)
+#define FANG_SPREAD_8(n) \
+    FANG_SPREAD_6(n),           FANG_SPREAD_6((n) + 4096), \
+    FANG_SPREAD_6((n) + 16384), FANG_SPREAD_6((n) + 20480)
+
+static inline uint32_t
+Fang_SpreadBits(
+    const uint32_t value)
+{
+    static const uint16_t table[256] = {FANG_SPREAD_8(0)};
+
+    return (uint32_t)table[value & 0xFF]
+         | (uint32_t)table[(value >> 8) & 0xFF] << 16;
+}
+
+#undef FANG_SPREAD_8
+#undef FANG_SPREAD_6
+#undef FANG_SPREAD_4
+#undef FANG_SPREAD_2
+
+/**
+ * Returns the index of a pixel within a swizzled image, where the face size is
+ * the image's height.
+ *
+ * Each face is stored in Z-order, with the bits of the X coordinate (within
+ * the face) interleaved with the bits of the Y coordinate.
+**/
+static inline int
+Fang_GetSwizzledIndex(
+    const int x,
+    const int y,
+    const int face_size)
+{
+    assert(face_size > 0 && !(face_size & (face_size - 1)));
+
+    const int face_x = x & ~(face_size - 1);
+
+    return face_x * face_size + (int)(
+        Fang_SpreadBits((uint32_t)(x & (face_size - 1)))
+      | Fang_SpreadBits((uint32_t)y) << 1
+    );
+}
+
+/**
+ * Returns whether an image's dimensions allow it to be swizzled, that is it is
+ * made up of square faces with a power-of-two size.
+**/
+static inline bool
+Fang_CanSwizzleImage(
+    const Fang_Image * const image)
+{
+    assert(image);
+
+    return (
+        image->height > 0
+     && !(image->height & (image->height - 1))
+     && image->width % image->height == 0
+    );
+}
+
+/**
+ * Returns the offset (in bytes) of a pixel within the image's pixel data,
+ * taking the image's layout into account.
+**/
+static inline int
+Fang_GetPixelOffset(
+    const Fang_Image * const image,
+    const int                x,
+    const int                y)
+{
+    assert(image);
+
+    if (image->layout == FANG_IMAGELAYOUT_COLUMNS)
+        return x * image->pitch + y * image->stride;
+
+    if (image->layout == FANG_IMAGELAYOUT_SWIZZLED)
+        return Fang_GetSwizzledIndex(x, y, image->height) * image->stride;
+
+    return y * image->pitch + x * image->stride;
+}
+
+/**
+ * Returns the distance (in bytes) between horizontally neighbouring pixels of a
+ * row-major or column-major image.
+**/
+static inline int
+Fang_GetPixelStepX(
+    const Fang_Image * const image)
+{
+    assert(image);
+    assert(image->layout != FANG_IMAGELAYOUT_SWIZZLED);
+
+    return (image->layout == FANG_IMAGELAYOUT_COLUMNS)
+        ? image->pitch
+        : image->stride;
+}
+
+/**
+ * Returns the distance (in bytes) between vertically neighbouring pixels of a
+ * row-major or column-major image.
+**/
+static inline int
+Fang_GetPixelStepY(
+    const Fang_Image * const image)
+{
+    assert(image);
+    assert(image->layout != FANG_IMAGELAYOUT_SWIZZLED);
+
+    return (image->layout == FANG_IMAGELAYOUT_COLUMNS)
+        ? image->stride
+        : image->pitch;
+}
+
+/**
+ * Changes the layout of a freshly allocated image, updating its pitch.
+ *
+ * This does not move any pixel data, it only changes how the existing buffer is
+ * addressed.
+**/
+static inline void
+Fang_SetImageLayout(
+          Fang_Image       * const image,
+    const Fang_ImageLayout         layout)
+{
+    assert(Fang_ImageValid(image));
+    assert(layout != FANG_IMAGELAYOUT_SWIZZLED || Fang_CanSwizzleImage(image));
+
+    image->layout = layout;
+    image->pitch  = (layout == FANG_IMAGELAYOUT_COLUMNS)
+        ? image->stride * image->height
+        : image->stride * image->width;
+}
+
+/**
+ * Reads a packed, 32-bit pixel from an image.
+ *
+ * This performs no conversion and does not check the image for validity, so it
+ * is suitable for use in the inner loops of drawing routines. Callers should
+ * substitute Fang_GetFallbackImage() for invalid images beforehand.
+ *
+ * Palettized images are resolved through their palette.
+**/
+static inline uint32_t
+Fang_SamplePixel(
+    const Fang_Image * const image,
+    const int                x,
+    const int                y)
+{
+    assert(image);
+    assert(image->pixels);
+    assert(x >= 0 && x < image->width);
+    assert(y >= 0 && y < image->height);
+
+    if (image->flags & FANG_IMAGEFLAG_PALETTIZED)
+    {
+        assert(image->palette);
+        assert(image->stride == 1);
+        return image->palette[image->pixels[Fang_GetPixelOffset(image, x, y)]];
+    }
+
+    assert(image->stride == 4);
+    return *(const uint32_t*)(image->pixels + Fang_GetPixelOffset(image, x, y));
+}
+
+/**
+ * Reads a packed, 32-bit pixel from a swizzled image.
+ *
+ * This is the same as Fang_SamplePixel(), but skips the check of the image's
+ * layout for drawing routines which have already checked it outside of their
+ * inner loops.
+**/
+static inline uint32_t
+Fang_SampleSwizzledPixel(
+    const Fang_Image * const image,
+    const int                x,
+    const int                y)
+{
+    assert(image);
+    assert(image->pixels);
+    assert(image->layout == FANG_IMAGELAYOUT_SWIZZLED);
+    assert(x >= 0 && x < image->width);
+    assert(y >= 0 && y < image->height);
+
+    const int index = Fang_GetSwizzledIndex(x, y, image->height);
+
+    if (image->flags & FANG_IMAGEFLAG_PALETTIZED)
+    {
+        assert(image->palette);
+        assert(image->stride == 1);
+        return image->palette[image->pixels[index]];
+    }
+
+    assert(image->stride == 4);
+    return ((const uint32_t*)(const void*)image->pixels)[index];
+}
+
+/**
+ * Returns a decoded column of a palettized image as a contiguous run of packed
+ * 32-bit texels, using the shared column cache.
+ *
+ * The returned pointer is only valid until the next call to this function.
+ * Returns NULL if the image is not palettized or is too tall for the cache, in
+ * which case the caller should fall back to Fang_SamplePixel().
+**/
+static inline const uint32_t *
+Fang_GetImageColumn(
+    const Fang_Image * const image,
+    const int                column)
+{
+    assert(image);
+    assert(column >= 0 && column < image->width);
+
+    if (!(image->flags & FANG_IMAGEFLAG_PALETTIZED)
+    ||  image->height > FANG_TEXTURE_SIZE)
+        return NULL;
+
+    Fang_ColumnCache      * const cache = Fang_GetColumnCache();
+    Fang_ColumnCacheEntry * const set   = cache->entries[
+        column & (FANG_COLUMNCACHE_SETS - 1)
+    ];
+
+    cache->clock++;
+
+    Fang_ColumnCacheEntry * oldest = &set[0];
+
+    for (int way = 0; way < FANG_COLUMNCACHE_WAYS; ++way)
+    {
+        Fang_ColumnCacheEntry * const entry = &set[way];
+
+        if (entry->pixels == image->pixels && entry->column == column)
+        {
+            entry->last_use = cache->clock;
+            return entry->texels;
+        }
+
+        if (!entry->pixels)
+            oldest = entry;
+        else if (oldest->pixels && entry->last_use < oldest->last_use)
+            oldest = entry;
+    }
+
+    oldest->pixels   = image->pixels;
+    oldest->column   = column;
+    oldest->last_use = cache->clock;
+
+    for (int y = 0; y < image->height; ++y)
+    {
+        oldest->texels[y] = image->palette[
+            image->pixels[Fang_GetPixelOffset(image, column, y)]
+        ];
+    }
+
+    return oldest->texels;
+}
+
+/**
+ * Returns whether an image is known to be fully opaque from its spans.
+**/
+static inline bool
+Fang_ImageOpaque(
+    const Fang_Image * const image)
+{
+    assert(image);
+
+    return image->spans && image->spans->opaque;
+}
+
+/**
+ * Returns the 'XOR Texture', which serves as the default 'missing' texture.
+ *
+ * The image is generated the first time it is requested. It is opaque, so it
+ * is flagged as premultiplied and given a single opaque span per column.
+**/
+static inline const Fang_Image *
+Fang_GetFallbackImage(void)
+{
+    static uint32_t        pixels[FANG_TEXTURE_SIZE * FANG_TEXTURE_SIZE];
+    static uint32_t        columns[FANG_TEXTURE_SIZE + 1];
+    static Fang_ImageSpan  runs[FANG_TEXTURE_SIZE];
+    static Fang_ImageSpans spans = {.columns = NULL};
+    static Fang_Image      image = {.pixels = NULL};
+
+    if (!image.pixels)
+    {
+        for (int x = 0; x < FANG_TEXTURE_SIZE; ++x)
+        {
+            columns[x] = (uint32_t)x;
+            runs[x]    = (Fang_ImageSpan){
+                .start  = 0,
+                .end    = FANG_TEXTURE_SIZE,
+                .opaque = true,
+            };
+        }
+
+        columns[FANG_TEXTURE_SIZE] = FANG_TEXTURE_SIZE;
+
+        spans = (Fang_ImageSpans){
+            .columns = columns,
+            .spans   = runs,
+            .opaque  = true,
+        };
+
+        for (int y = 0; y < FANG_TEXTURE_SIZE; ++y)
+        {
+            for (int x = 0; x < FANG_TEXTURE_SIZE; ++x)
+            {
+                const uint8_t value = (uint8_t)x ^ (uint8_t)y;
+
+                pixels[y * FANG_TEXTURE_SIZE + x] = Fang_MapColor(
+                    &(Fang_Color){value, value, value, 255}
+                );
+            }
+        }
+
+        image = (Fang_Image){
+            .pixels = (uint8_t*)pixels,
+            .width  = FANG_TEXTURE_SIZE,
+            .height = FANG_TEXTURE_SIZE,
+            .pitch  = FANG_TEXTURE_SIZE * 4,
+            .stride = 4,
+            .spans  = &spans,
+            .layout = FANG_IMAGELAYOUT_ROWS,
+            .flags  = FANG_IMAGEFLAG_PREMULTIPLIED,
+        };
+    }
+
+    return &image;
 }
 
 /**
  * Query an image for a 32-bit color value.
  *
- * If the image depth is less than 32 bits, the missing channels are defaulted
- * to 255.
+ * If the image is invalid, the color is taken from the 'XOR Texture' instead.
+ * Premultiplied pixels are converted back to straight alpha.
 **/
 static inline Fang_Color
 Fang_GetPixel(
@@ -116,35 +712,744 @@ Fang_GetPixel(
 {
     assert(point);
 
-    /* The 'XOR Texture' serves as the default 'missing' texture. */
     if (!Fang_ImageValid(image))
     {
-        const uint8_t value = (uint8_t)point->x ^ (uint8_t)point->y;
-        return (Fang_Color){value, value, value, 255};
+        return Fang_GetColor(
+            Fang_SamplePixel(
+                Fang_GetFallbackImage(),
+                point->x & (FANG_TEXTURE_SIZE - 1),
+                point->y & (FANG_TEXTURE_SIZE - 1)
+            )
+        );
     }
 
-    assert(point->x >= 0 && point->x < image->width);
-    assert(point->y >= 0 && point->y < image->height);
+    Fang_Color result = Fang_GetColor(
+        Fang_SamplePixel(image, point->x, point->y)
+    );
 
-    uint32_t pixel = 0;
+    if ((image->flags & FANG_IMAGEFLAG_PREMULTIPLIED)
+    &&  result.a
+    &&  result.a != UINT8_MAX)
+    {
+        result.r = (uint8_t)min((result.r * 255 + result.a / 2) / result.a, 255);
+        result.g = (uint8_t)min((result.g * 255 + result.a / 2) / result.a, 255);
+        result.b = (uint8_t)min((result.b * 255 + result.a / 2) / result.a, 255);
+    }
 
-    for (int p = 0; p < image->stride; ++p)
+    return result;
+}
+
+/**
+ * Converts an image to the given layout.
+ *
+ * The previous pixel data is freed once the conversion has finished. If the
+ * new pixel data can't be allocated the image is left untouched and non-zero is
+ * returned.
+**/
+static inline int
+Fang_ConvertImage(
+          Fang_Image       * const image,
+    const Fang_ImageLayout         layout)
+{
+    assert(Fang_ImageValid(image));
+    assert(image->stride == 4);
+
+    Fang_Image result = {.pixels = NULL};
+
+    if (Fang_AllocImage(&result, image->width, image->height, 32))
+        return 1;
+
+    Fang_SetImageLayout(&result, layout);
+    result.flags = image->flags;
+
+    for (int x = 0; x < result.width; ++x)
     {
-        pixel |= *(
-            image->pixels + p
-          + (point->x * image->stride)
-          + (point->y * image->pitch)
+        for (int y = 0; y < result.height; ++y)
+        {
+            *(uint32_t*)(result.pixels + Fang_GetPixelOffset(&result, x, y)) = (
+                Fang_SamplePixel(image, x, y)
+            );
+        }
+    }
+
+    Fang_FreeImage(image);
+    *image = result;
+    return 0;
+}
+
+/**
+ * Transposes 4x4 pixels from a column-major source into a row-major dest, as
+ * part of Fang_TransposeImage(). The pitches are given in pixels.
+**/
+static inline void
+Fang_TransposePixels(
+          uint32_t * const dest,
+    const uint32_t * const source,
+    const int              dest_pitch,
+    const int              source_pitch)
+{
+    assert(dest);
+    assert(source);
+
+#if defined(FANG_SIMD_NEON)
+    const uint32x4x2_t low = vtrnq_u32(
+        vld1q_u32(source), vld1q_u32(source + source_pitch)
+    );
+
+    const uint32x4x2_t high = vtrnq_u32(
+        vld1q_u32(source + source_pitch * 2),
+        vld1q_u32(source + source_pitch * 3)
+    );
+
+    vst1q_u32(
+        dest, vcombine_u32(vget_low_u32(low.val[0]), vget_low_u32(high.val[0]))
+    );
+
+    vst1q_u32(
+        dest + dest_pitch,
+        vcombine_u32(vget_low_u32(low.val[1]), vget_low_u32(high.val[1]))
+    );
+
+    vst1q_u32(
+        dest + dest_pitch * 2,
+        vcombine_u32(vget_high_u32(low.val[0]), vget_high_u32(high.val[0]))
+    );
+
+    vst1q_u32(
+        dest + dest_pitch * 3,
+        vcombine_u32(vget_high_u32(low.val[1]), vget_high_u32(high.val[1]))
+    );
+#elif defined(FANG_SIMD_SSE2)
+    const __m128i c0 = _mm_loadu_si128((const __m128i*)source);
+    const __m128i c1 = _mm_loadu_si128((const __m128i*)(source + source_pitch));
+    const __m128i c2 = _mm_loadu_si128(
+        (const __m128i*)(source + source_pitch * 2)
+    );
+    const __m128i c3 = _mm_loadu_si128(
+        (const __m128i*)(source + source_pitch * 3)
+    );
+
+    /* Pairs of columns are interleaved, then pairs of those pairs */
+    const __m128i r01_low  = _mm_unpacklo_epi32(c0, c1);
+    const __m128i r23_low  = _mm_unpacklo_epi32(c2, c3);
+    const __m128i r01_high = _mm_unpackhi_epi32(c0, c1);
+    const __m128i r23_high = _mm_unpackhi_epi32(c2, c3);
+
+    _mm_storeu_si128(
+        (__m128i*)dest, _mm_unpacklo_epi64(r01_low, r23_low)
+    );
+
+    _mm_storeu_si128(
+        (__m128i*)(dest + dest_pitch), _mm_unpackhi_epi64(r01_low, r23_low)
+    );
+
+    _mm_storeu_si128(
+        (__m128i*)(dest + dest_pitch * 2),
+        _mm_unpacklo_epi64(r01_high, r23_high)
+    );
+
+    _mm_storeu_si128(
+        (__m128i*)(dest + dest_pitch * 3),
+        _mm_unpackhi_epi64(r01_high, r23_high)
+    );
+#else
+    for (int y = 0; y < 4; ++y)
+    {
+        for (int x = 0; x < 4; ++x)
+            dest[y * dest_pitch + x] = source[x * source_pitch + y];
+    }
+#endif
+}
+
+/**
+ * Copies a column-major image into a row-major image of the same size.
+ *
+ * The image is copied in blocks of FANG_TRANSPOSE_BLOCK pixels, so that the
+ * rows of the destination and the columns of the source being read and written
+ * stay in the cache. Each block is transposed 4x4 pixels at a time, with the
+ * pixels left over at the right and bottom edges copied one at a time.
+**/
+static inline void
+Fang_TransposeImage(
+          Fang_Image * const dest,
+    const Fang_Image * const source)
+{
+    assert(Fang_ImageValid(dest));
+    assert(Fang_ImageValid(source));
+    assert(dest->width  == source->width);
+    assert(dest->height == source->height);
+    assert(dest->stride   == 4);
+    assert(source->stride == 4);
+    assert(dest->layout   == FANG_IMAGELAYOUT_ROWS);
+    assert(source->layout == FANG_IMAGELAYOUT_COLUMNS);
+    assert(dest->pitch   % 4 == 0);
+    assert(source->pitch % 4 == 0);
+
+    const int dest_pitch   = dest->pitch   / 4;
+    const int source_pitch = source->pitch / 4;
+
+    uint32_t       * const dest_pixels   = (uint32_t*)(void*)dest->pixels;
+    const uint32_t * const source_pixels = (
+        (const uint32_t*)(const void*)source->pixels
+    );
+
+    const int width  = source->width  & ~3;
+    const int height = source->height & ~3;
+
+    for (int block_x = 0; block_x < width; block_x += FANG_TRANSPOSE_BLOCK)
+    {
+        const int end_x = min(block_x + FANG_TRANSPOSE_BLOCK, width);
+
+        for (int block_y = 0; block_y < height; block_y += FANG_TRANSPOSE_BLOCK)
+        {
+            const int end_y = min(block_y + FANG_TRANSPOSE_BLOCK, height);
+
+            for (int x = block_x; x < end_x; x += 4)
+            {
+                for (int y = block_y; y < end_y; y += 4)
+                {
+                    Fang_TransposePixels(
+                        dest_pixels + y * dest_pitch + x,
+                        source_pixels + x * source_pitch + y,
+                        dest_pitch,
+                        source_pitch
+                    );
+                }
+            }
+        }
+    }
+
+    for (int y = 0; y < source->height; ++y)
+    {
+        const int start_x = (y < height) ? width : 0;
+
+        for (int x = start_x; x < source->width; ++x)
+        {
+            dest_pixels[y * dest_pitch + x] = (
+                source_pixels[x * source_pitch + y]
+            );
+        }
+    }
+}
+
+/**
+ * Copies the first half of each pixel of a row-major image with a stride of 8
+ * bytes (such as the color of a framebuffer with interleaved depth, see
+ * Fang_DepthLayout) into a row-major image of the same size.
+ *
+ * Each row is copied 4 pixels at a time, with the pixels left over at the end
+ * of the row copied one at a time.
+**/
+static inline void
+Fang_DeinterleaveImage(
+          Fang_Image * const dest,
+    const Fang_Image * const source)
+{
+    assert(Fang_ImageValid(dest));
+    assert(Fang_ImageValid(source));
+    assert(dest->width  == source->width);
+    assert(dest->height == source->height);
+    assert(dest->stride   == 4);
+    assert(source->stride == 8);
+    assert(dest->layout   == FANG_IMAGELAYOUT_ROWS);
+    assert(source->layout == FANG_IMAGELAYOUT_ROWS);
+
+    for (int y = 0; y < source->height; ++y)
+    {
+        uint32_t * const dest_row = (uint32_t*)(void*)(
+            dest->pixels + y * dest->pitch
         );
 
-        if (p < image->stride - 1)
-            pixel <<= 8;
+        const uint32_t * const source_row = (const uint32_t*)(const void*)(
+            source->pixels + y * source->pitch
+        );
+
+        int x = 0;
+
+#if defined(FANG_SIMD_NEON)
+        for (; x + 4 <= source->width; x += 4)
+            vst1q_u32(dest_row + x, vld2q_u32(source_row + x * 2).val[0]);
+#elif defined(FANG_SIMD_SSE2)
+        for (; x + 4 <= source->width; x += 4)
+        {
+            const __m128i low = _mm_loadu_si128(
+                (const __m128i*)(source_row + x * 2)
+            );
+
+            const __m128i high = _mm_loadu_si128(
+                (const __m128i*)(source_row + x * 2 + 4)
+            );
+
+            /* The even lanes of both halves hold the colors */
+            _mm_storeu_si128(
+                (__m128i*)(dest_row + x),
+                _mm_castps_si128(
+                    _mm_shuffle_ps(
+                        _mm_castsi128_ps(low),
+                        _mm_castsi128_ps(high),
+                        _MM_SHUFFLE(2, 0, 2, 0)
+                    )
+                )
+            );
+        }
+#endif
+
+        for (; x < source->width; ++x)
+            dest_row[x] = source_row[x * 2];
+    }
+}
+
+/**
+ * Multiplies the color channels of every pixel in the image by its alpha.
+ *
+ * Images which are already premultiplied are left unchanged.
+**/
+static inline void
+Fang_PremultiplyImage(
+    Fang_Image * const image)
+{
+    assert(Fang_ImageValid(image));
+    assert(image->stride == 4);
+
+    if (image->flags & FANG_IMAGEFLAG_PREMULTIPLIED)
+        return;
+
+    for (int x = 0; x < image->width; ++x)
+    {
+        for (int y = 0; y < image->height; ++y)
+        {
+            uint32_t * const pixel = (uint32_t*)(
+                image->pixels + Fang_GetPixelOffset(image, x, y)
+            );
+
+            *pixel = Fang_PremultiplyPixel(*pixel);
+        }
     }
 
-    for (int p = image->stride; p < 4; ++p)
+    image->flags |= FANG_IMAGEFLAG_PREMULTIPLIED;
+}
+
+/**
+ * Creates a half-sized copy of an image by averaging each 2x2 block of pixels.
+ *
+ * The image may be a strip of square faces laid side by side (such as a tile
+ * texture), in which case each face is reduced on its own so that no colors
+ * bleed between neighbouring faces. The result keeps the layout and flags of
+ * the source image.
+ *
+ * Returns non-zero if the image is too small to be reduced further or if the
+ * result could not be allocated.
+**/
+static inline int
+Fang_DownsampleImage(
+    const Fang_Image * const image,
+          Fang_Image * const result,
+    const int                faces)
+{
+    assert(Fang_ImageValid(image));
+    assert(image->stride == 4);
+    assert(result);
+    assert(faces > 0);
+    assert(image->width % faces == 0);
+
+    const int face_width = image->width / faces;
+
+    if (face_width < 2 || face_width % 2 || image->height < 2)
+        return 1;
+
+    if (Fang_AllocImage(result, (face_width / 2) * faces, image->height / 2, 32))
+        return 1;
+
+    Fang_SetImageLayout(result, image->layout);
+    result->flags = image->flags;
+
+    for (int x = 0; x < result->width; ++x)
     {
-        pixel <<= 8;
-        pixel |= 0x000000FF;
+        for (int y = 0; y < result->height; ++y)
+        {
+            int sum[4] = {0, 0, 0, 0};
+
+            for (int i = 0; i < 4; ++i)
+            {
+                const Fang_Color color = Fang_GetColor(
+                    Fang_SamplePixel(image, x * 2 + (i & 1), y * 2 + (i >> 1))
+                );
+
+                sum[0] += color.r;
+                sum[1] += color.g;
+                sum[2] += color.b;
+                sum[3] += color.a;
+            }
+
+            *(uint32_t*)(result->pixels + Fang_GetPixelOffset(result, x, y)) = (
+                Fang_MapColor(
+                    &(Fang_Color){
+                        .r = (uint8_t)((sum[0] + 2) / 4),
+                        .g = (uint8_t)((sum[1] + 2) / 4),
+                        .b = (uint8_t)((sum[2] + 2) / 4),
+                        .a = (uint8_t)((sum[3] + 2) / 4),
+                    }
+                )
+            );
+        }
     }
 
-    return Fang_GetColor(pixel);
+    return 0;
+}
+
+/**
+ * Orders packed pixels (or palette keys) for sorting.
+**/
+static int
+Fang_ComparePixels(
+    const void * const a,
+    const void * const b)
+{
+    const uint32_t pixel_a = *(const uint32_t*)a;
+    const uint32_t pixel_b = *(const uint32_t*)b;
+
+    return (pixel_a > pixel_b) - (pixel_a < pixel_b);
+}
+
+static int
+Fang_ComparePaletteKeys(
+    const void * const a,
+    const void * const b)
+{
+    const uint64_t key_a = *(const uint64_t*)a;
+    const uint64_t key_b = *(const uint64_t*)b;
+
+    return (key_a > key_b) - (key_a < key_b);
+}
+
+/**
+ * Rotates a packed pixel left so that the given channel (0 being the topmost
+ * byte) becomes the topmost byte.
+**/
+static inline uint32_t
+Fang_RotatePixel(
+    const uint32_t pixel,
+    const int      channel)
+{
+    const int bits = (channel & 3) * 8;
+
+    return (bits) ? (pixel << bits) | (pixel >> (32 - bits)) : pixel;
+}
+
+/**
+ * A range of colors used during median-cut quantization, along with the
+ * channel that has the widest range of values within the box.
+**/
+typedef struct Fang_ColorBox {
+    int start;
+    int end;
+    int channel;
+    int range;
+} Fang_ColorBox;
+
+static inline void
+Fang_MeasureColorBox(
+          Fang_ColorBox * const box,
+    const uint32_t      * const colors)
+{
+    assert(box);
+    assert(colors);
+
+    uint8_t lo[4] = {255, 255, 255, 255};
+    uint8_t hi[4] = {0, 0, 0, 0};
+
+    for (int i = box->start; i < box->end; ++i)
+    {
+        for (int c = 0; c < 4; ++c)
+        {
+            const uint8_t value = (uint8_t)(colors[i] >> (24 - c * 8));
+
+            lo[c] = min(lo[c], value);
+            hi[c] = max(hi[c], value);
+        }
+    }
+
+    box->channel = 0;
+    box->range   = 0;
+
+    for (int c = 0; c < 4; ++c)
+    {
+        if (hi[c] - lo[c] > box->range)
+        {
+            box->channel = c;
+            box->range   = hi[c] - lo[c];
+        }
+    }
+}
+
+/**
+ * Converts a 32-bit image into a palettized image of 8-bit indices.
+ *
+ * The palette is built using median-cut quantization: the image's colors are
+ * repeatedly split along the channel with the widest range until the palette is
+ * full, and each palette entry is the average of the colors in its box. Images
+ * with fewer unique colors than the palette size are stored losslessly.
+ *
+ * The layout and flags of the image are preserved. If any allocation fails the
+ * image is left untouched and non-zero is returned.
+**/
+static inline int
+Fang_PalettizeImage(
+    Fang_Image * const image)
+{
+    assert(Fang_ImageValid(image));
+    assert(image->stride == 4);
+
+    const int count = image->width * image->height;
+
+    int num_boxes = 1;
+
+    /* The boxes are too large for the stacks of the texture workers */
+    Fang_ColorBox * const boxes = malloc(
+        sizeof(Fang_ColorBox) * FANG_PALETTE_SIZE
+    );
+
+    uint32_t * const colors  = malloc(sizeof(uint32_t) * (size_t)count);
+    uint64_t * const keys    = malloc(sizeof(uint64_t) * (size_t)count);
+    uint32_t * const palette = calloc(FANG_PALETTE_SIZE, sizeof(uint32_t));
+
+    Fang_Image result = {.pixels = NULL};
+
+    if (!boxes || !colors || !keys || !palette)
+        goto Error_Alloc;
+
+    if (Fang_AllocImage(&result, image->width, image->height, 8))
+        goto Error_Alloc;
+
+    Fang_SetImageLayout(&result, image->layout);
+
+    for (int x = 0; x < image->width; ++x)
+    {
+        for (int y = 0; y < image->height; ++y)
+            colors[x * image->height + y] = Fang_SamplePixel(image, x, y);
+    }
+
+    boxes[0] = (Fang_ColorBox){.start = 0, .end = count};
+    Fang_MeasureColorBox(&boxes[0], colors);
+
+    /* Split the box with the widest channel range at its median */
+    while (num_boxes < FANG_PALETTE_SIZE)
+    {
+        Fang_ColorBox * box = &boxes[0];
+
+        for (int i = 1; i < num_boxes; ++i)
+        {
+            if (boxes[i].range > box->range)
+                box = &boxes[i];
+        }
+
+        if (!box->range)
+            break;
+
+        const int channel = box->channel;
+        const int shift   = 24 - channel * 8;
+        const int size    = box->end - box->start;
+
+        for (int i = box->start; i < box->end; ++i)
+            colors[i] = Fang_RotatePixel(colors[i], channel);
+
+        qsort(
+            colors + box->start,
+            (size_t)size,
+            sizeof(uint32_t),
+            Fang_ComparePixels
+        );
+
+        for (int i = box->start; i < box->end; ++i)
+            colors[i] = Fang_RotatePixel(colors[i], 4 - channel);
+
+        /* Colors sharing a value in the split channel stay in the same box, so
+           that identical colors are never spread across palette entries.
+        */
+        int median = box->start + size / 2;
+
+        while (median > box->start
+           &&  (uint8_t)(colors[median - 1] >> shift)
+           ==  (uint8_t)(colors[median]     >> shift))
+            median--;
+
+        if (median == box->start)
+        {
+            while (median < box->end
+               &&  (uint8_t)(colors[median]     >> shift)
+               ==  (uint8_t)(colors[box->start] >> shift))
+                median++;
+        }
+
+        boxes[num_boxes] = (Fang_ColorBox){.start = median, .end = box->end};
+        box->end = median;
+
+        Fang_MeasureColorBox(box, colors);
+        Fang_MeasureColorBox(&boxes[num_boxes], colors);
+        num_boxes++;
+    }
+
+    /* Average each box into a palette entry, keying its colors by the index */
+    for (int i = 0; i < num_boxes; ++i)
+    {
+        const uint32_t size   = (uint32_t)(boxes[i].end - boxes[i].start);
+        uint32_t       sum[4] = {0, 0, 0, 0};
+
+        for (int j = boxes[i].start; j < boxes[i].end; ++j)
+        {
+            for (int c = 0; c < 4; ++c)
+                sum[c] += (colors[j] >> (24 - c * 8)) & 0xFF;
+
+            keys[j] = ((uint64_t)colors[j] << 8) | (uint64_t)i;
+        }
+
+        for (int c = 0; c < 4; ++c)
+            palette[i] |= ((sum[c] + size / 2) / size) << (24 - c * 8);
+    }
+
+    qsort(keys, (size_t)count, sizeof(uint64_t), Fang_ComparePaletteKeys);
+
+    /* Every color belongs to a single box, so a search finds its index */
+    for (int x = 0; x < image->width; ++x)
+    {
+        for (int y = 0; y < image->height; ++y)
+        {
+            const uint32_t pixel = Fang_SamplePixel(image, x, y);
+
+            int lo = 0;
+            int hi = count - 1;
+
+            while (lo < hi)
+            {
+                const int mid = (lo + hi) / 2;
+
+                if ((uint32_t)(keys[mid] >> 8) < pixel)
+                    lo = mid + 1;
+                else
+                    hi = mid;
+            }
+
+            result.pixels[Fang_GetPixelOffset(&result, x, y)] = (
+                (uint8_t)(keys[lo] & 0xFF)
+            );
+        }
+    }
+
+    free(keys);
+    free(colors);
+    free(boxes);
+
+    result.palette = palette;
+    result.flags   = image->flags | FANG_IMAGEFLAG_PALETTIZED;
+
+    Fang_FreeImage(image);
+    *image = result;
+    return 0;
+
+Error_Alloc:
+    Fang_FreeImage(&result);
+    free(palette);
+    free(keys);
+    free(colors);
+    free(boxes);
+    return 1;
+}
+
+/**
+ * Measures the runs of texels in each of an image's columns, replacing any
+ * spans the image already had.
+ *
+ * This should be done once the image's pixels are final, as the spans are not
+ * kept up to date with any changes made to the pixels afterwards. If the spans
+ * could not be allocated the image is left without any and non-zero is
+ * returned.
+**/
+static inline int
+Fang_BuildImageSpans(
+    Fang_Image * const image)
+{
+    assert(Fang_ImageValid(image));
+    assert(image->height <= UINT16_MAX);
+
+    free(image->spans);
+    image->spans = NULL;
+
+    /* Count the runs first, so that everything fits in one allocation */
+    size_t count = 0;
+
+    for (int x = 0; x < image->width; ++x)
+    {
+        int prev_type = 0;
+
+        for (int y = 0; y < image->height; ++y)
+        {
+            const uint32_t alpha = Fang_SamplePixel(image, x, y) & 0xFF;
+            const int      type  = (alpha) ? ((alpha == UINT8_MAX) ? 2 : 1) : 0;
+
+            if (type && type != prev_type)
+                count++;
+
+            prev_type = type;
+        }
+    }
+
+    Fang_ImageSpans * const spans = malloc(
+        sizeof(Fang_ImageSpans)
+      + sizeof(uint32_t)       * (size_t)(image->width + 1)
+      + sizeof(Fang_ImageSpan) * count
+    );
+
+    if (!spans)
+        return 1;
+
+    spans->columns = (uint32_t*)(spans + 1);
+    spans->spans   = (Fang_ImageSpan*)(spans->columns + image->width + 1);
+    spans->opaque  = true;
+
+    uint32_t index = 0;
+
+    for (int x = 0; x < image->width; ++x)
+    {
+        spans->columns[x] = index;
+
+        Fang_ImageSpan * span = NULL;
+
+        for (int y = 0; y < image->height; ++y)
+        {
+            const uint32_t alpha = Fang_SamplePixel(image, x, y) & 0xFF;
+
+            if (!alpha)
+            {
+                span = NULL;
+                continue;
+            }
+
+            const bool opaque = (alpha == UINT8_MAX);
+
+            if (!span || span->opaque != opaque)
+            {
+                span = &spans->spans[index++];
+
+                *span = (Fang_ImageSpan){
+                    .start  = (uint16_t)y,
+                    .opaque = opaque,
+                };
+            }
+
+            span->end = (uint16_t)(y + 1);
+        }
+
+        if (index - spans->columns[x] != 1
+        ||  !spans->spans[spans->columns[x]].opaque
+        ||  spans->spans[spans->columns[x]].start != 0
+        ||  spans->spans[spans->columns[x]].end   != image->height)
+            spans->opaque = false;
+    }
+
+    spans->columns[image->width] = index;
+
+    assert(index == count);
+
+    image->spans = spans;
+    return 0;
 }
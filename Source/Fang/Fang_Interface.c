@@ -31,6 +31,39 @@ typedef struct Fang_InterfaceTheme {
     Fang_TextureId       font;
 } Fang_InterfaceTheme;
 
+/**
+ * The limits of the interface's command buffer for a single frame. Commands
+ * past these limits are not drawn.
+**/
+enum {
+    FANG_INTERFACE_MAX_COMMANDS = 256,
+    FANG_INTERFACE_TEXT_SIZE    = 2048,
+};
+
+typedef enum Fang_InterfaceCommandType {
+    FANG_INTERFACECOMMAND_OUTLINE,
+    FANG_INTERFACECOMMAND_FILL,
+    FANG_INTERFACECOMMAND_TEXT,
+} Fang_InterfaceCommandType;
+
+/**
+ * A drawing command emitted by an interface element.
+ *
+ * Outlines and fills are drawn with Fang_DrawRect() and Fang_FillRect(). Text
+ * is drawn with Fang_DrawText() at the top-left corner of the area, which is
+ * the area covered by the text (see Fang_MeasureText()). The text itself is
+ * kept in the interface's text buffer, starting at the given offset and ending
+ * with a null terminator.
+**/
+typedef struct Fang_InterfaceCommand {
+    Fang_InterfaceCommandType type;
+    Fang_Rect                 area;
+    Fang_Color                color;
+    Fang_TextureId            font;
+    uint16_t                  text_offset;
+    uint16_t                  text_length;
+} Fang_InterfaceCommand;
+
 /**
  * This interface state holds the identifiers used for the immediate-mode,
  * graphical user interface elements.
@@ -55,6 +88,12 @@ typedef struct Fang_InterfaceTheme {
  * button, it would set itself to the 'next' item if the mouse was within its
  * bounds. In the following frame - if no other element tried to claim 'next' -
  * the button would become the 'hot' item.
+ *
+ * Elements don't draw immediately, but emit commands into a buffer which is
+ * drawn at the end of the frame with Fang_DrawInterface(). The commands are
+ * drawn into the interface's own layer, which is kept for as long as the
+ * commands stay the same, so an idle interface is only composited. The layer's
+ * spans are measured, so that compositing it only touches its visible pixels.
 **/
 typedef struct Fang_Interface {
     uint32_t id;
@@ -64,9 +103,16 @@ typedef struct Fang_Interface {
 
     Fang_InterfaceTheme theme;
 
-          Fang_Framebuffer * framebuf;
     const Fang_Textures    * textures;
     const Fang_Input       * input;
+
+    Fang_InterfaceCommand commands[FANG_INTERFACE_MAX_COMMANDS];
+    size_t                num_commands;
+    char                  text[FANG_INTERFACE_TEXT_SIZE];
+    size_t                text_size;
+
+    Fang_Framebuffer layer;
+    uint64_t         layer_hash;
 } Fang_Interface;
 
 /**
@@ -88,6 +134,157 @@ Fang_UpdateInterface(
 
     interface->id   = 0;
     interface->next = 0;
+
+    interface->num_commands = 0;
+    interface->text_size    = 0;
+}
+
+/**
+ * Adds an outline or fill command for the given rectangle to the interface's
+ * command buffer.
+ *
+ * A fill which shares a whole edge with the previous fill of the same color is
+ * merged into it.
+**/
+static inline void
+Fang_PushInterfaceRect(
+          Fang_Interface            * const interface,
+    const Fang_InterfaceCommandType         type,
+    const Fang_Rect                 * const rect,
+    const Fang_Color                * const color)
+{
+    assert(interface);
+    assert(type == FANG_INTERFACECOMMAND_OUTLINE
+        || type == FANG_INTERFACECOMMAND_FILL);
+    assert(rect);
+    assert(color);
+
+    if (rect->w <= 0 || rect->h <= 0)
+        return;
+
+    if (type == FANG_INTERFACECOMMAND_FILL && interface->num_commands)
+    {
+        Fang_InterfaceCommand * const last = (
+            &interface->commands[interface->num_commands - 1]
+        );
+
+        const Fang_Rect * const area = &last->area;
+
+        const bool same_color = last->color.r == color->r
+                             && last->color.g == color->g
+                             && last->color.b == color->b
+                             && last->color.a == color->a;
+
+        const bool same_row = area->y == rect->y && area->h == rect->h
+                           && (area->x + area->w == rect->x
+                           ||  rect->x + rect->w == area->x);
+
+        const bool same_column = area->x == rect->x && area->w == rect->w
+                              && (area->y + area->h == rect->y
+                              ||  rect->y + rect->h == area->y);
+
+        if (last->type == FANG_INTERFACECOMMAND_FILL
+        &&  same_color
+        && (same_row || same_column))
+        {
+            last->area = Fang_UnionRect(area, rect);
+            return;
+        }
+    }
+
+    if (interface->num_commands == FANG_INTERFACE_MAX_COMMANDS)
+        return;
+
+    Fang_InterfaceCommand * const command = (
+        &interface->commands[interface->num_commands++]
+    );
+
+    /* Commands are hashed as raw memory, so their padding must be cleared */
+    memset(command, 0, sizeof(Fang_InterfaceCommand));
+
+    command->type  = type;
+    command->area  = *rect;
+    command->color = *color;
+}
+
+/**
+ * Adds a command drawing a line of text at the given position to the
+ * interface's command buffer.
+ *
+ * Text which continues the previous line of text (in the same font and size)
+ * is merged into it.
+**/
+static inline void
+Fang_PushInterfaceText(
+          Fang_Interface * const interface,
+    const char           * const text,
+    const Fang_TextureId         font,
+    const int                    fontheight,
+    const Fang_Point     * const position)
+{
+    assert(interface);
+    assert(text);
+    assert(position);
+
+    const size_t length = strlen(text);
+
+    if (!length || fontheight <= 0)
+        return;
+
+    if (interface->text_size + length + 1 > FANG_INTERFACE_TEXT_SIZE)
+        return;
+
+    const Fang_Rect size = Fang_MeasureText(text, fontheight);
+
+    if (interface->num_commands)
+    {
+        Fang_InterfaceCommand * const last = (
+            &interface->commands[interface->num_commands - 1]
+        );
+
+        /* Merged text must be at the end of the text buffer, where it can be
+           extended over its null terminator
+        */
+        if (last->type == FANG_INTERFACECOMMAND_TEXT
+        &&  last->font == font
+        &&  last->area.h == size.h
+        &&  last->area.y == position->y
+        &&  last->area.x + last->area.w == position->x
+        &&  last->text_offset + last->text_length + 1u == interface->text_size)
+        {
+            char * const end = interface->text + interface->text_size - 1;
+
+            memcpy(end, text, length + 1);
+
+            interface->text_size += length;
+            last->text_length    += (uint16_t)length;
+            last->area.w         += size.w;
+            return;
+        }
+    }
+
+    if (interface->num_commands == FANG_INTERFACE_MAX_COMMANDS)
+        return;
+
+    Fang_InterfaceCommand * const command = (
+        &interface->commands[interface->num_commands++]
+    );
+
+    memset(command, 0, sizeof(Fang_InterfaceCommand));
+
+    command->type        = FANG_INTERFACECOMMAND_TEXT;
+    command->area        = (Fang_Rect){
+        .x = position->x,
+        .y = position->y,
+        .w = size.w,
+        .h = size.h,
+    };
+    command->font        = font;
+    command->text_offset = (uint16_t)interface->text_size;
+    command->text_length = (uint16_t)length;
+
+    memcpy(interface->text + interface->text_size, text, length + 1);
+    interface->text_size += length + 1;
 }
 
 static inline bool
@@ -135,18 +332,27 @@ Fang_InterfaceButton(
     }
 
     {
-        Fang_Framebuffer * const framebuf = interface->framebuf;
-        assert(framebuf);
-
         const bool hot    = interface->hot    == id;
         const bool active = interface->active == id;
 
         if (active)
-            Fang_FillRect(framebuf, bounds, &theme->colors.highlight);
-        else if (hot)
-            Fang_DrawRect(framebuf, bounds, &theme->colors.foreground);
+        {
+            Fang_PushInterfaceRect(
+                interface,
+                FANG_INTERFACECOMMAND_FILL,
+                bounds,
+                &theme->colors.highlight
+            );
+        }
         else
-            Fang_DrawRect(framebuf, bounds, &theme->colors.disabled);
+        {
+            Fang_PushInterfaceRect(
+                interface,
+                FANG_INTERFACECOMMAND_OUTLINE,
+                bounds,
+                (hot) ? &theme->colors.foreground : &theme->colors.disabled
+            );
+        }
 
         if (text)
         {
@@ -154,10 +360,10 @@ Fang_InterfaceButton(
                 bounds, -4, -bounds->h / 2
             );
 
-            Fang_DrawText(
-                framebuf,
+            Fang_PushInterfaceText(
+                interface,
                 text,
-                Fang_GetTexture(interface->textures, theme->font),
+                theme->font,
                 text_area.h,
                 &(Fang_Point){
                     .x = (
@@ -238,9 +444,6 @@ Fang_InterfaceSlider(
     }
 
     {
-        Fang_Framebuffer * const framebuf = interface->framebuf;
-        assert(framebuf);
-
         const bool active = interface->active == id;
         const bool hot    = interface->hot    == id;
 
@@ -253,12 +456,15 @@ Fang_InterfaceSlider(
         else
             color = theme->colors.disabled;
 
-        Fang_DrawRect(framebuf, bounds, &color);
+        Fang_PushInterfaceRect(
+            interface, FANG_INTERFACECOMMAND_OUTLINE, bounds, &color
+        );
 
         Fang_Rect fill_area = Fang_ResizeRect(bounds, -1, -1);
 
-        Fang_FillRect(
-            framebuf,
+        Fang_PushInterfaceRect(
+            interface,
+            FANG_INTERFACECOMMAND_FILL,
             &(Fang_Rect){
                 .x = fill_area.x,
                 .y = fill_area.y,
@@ -282,10 +488,10 @@ Fang_InterfaceSlider(
                     bounds, -4, -bounds->h / 2
                 );
 
-                Fang_DrawText(
-                    framebuf,
+                Fang_PushInterfaceText(
+                    interface,
                     display_text,
-                    Fang_GetTexture(interface->textures, theme->font),
+                    theme->font,
                     text_area.h,
                     &(Fang_Point){
                         .x = (
@@ -301,3 +507,159 @@ Fang_InterfaceSlider(
 
     return result;
 }
+
+/**
+ * Returns a hash of the commands emitted by the interface's elements this
+ * frame, along with the fonts their text is drawn with.
+**/
+static inline uint64_t
+Fang_HashInterface(
+    const Fang_Interface * const interface)
+{
+    assert(interface);
+    assert(interface->textures);
+
+    uint64_t hash = FANG_HASH_INITIAL;
+
+    hash = Fang_HashData(
+        hash,
+        interface->commands,
+        interface->num_commands * sizeof(Fang_InterfaceCommand)
+    );
+    hash = Fang_HashData(hash, interface->text, interface->text_size);
+
+    /* Text is redrawn once its font has loaded (or changed) */
+    for (size_t i = 0; i < interface->num_commands; ++i)
+    {
+        const Fang_InterfaceCommand * const command = &interface->commands[i];
+
+        if (command->type != FANG_INTERFACECOMMAND_TEXT)
+            continue;
+
+        const Fang_Image * const font = Fang_GetTexture(
+            interface->textures, command->font
+        );
+
+        const uint8_t * const font_pixels = (font) ? font->pixels : NULL;
+
+        hash = Fang_HashData(hash, &font_pixels, sizeof(font_pixels));
+    }
+
+    return hash;
+}
+
+/**
+ * Draws the commands emitted by the interface's elements this frame into the
+ * framebuffer.
+ *
+ * The commands are drawn into the interface's layer, which only covers the area
+ * they draw to, and the layer is then composited into the framebuffer. If the
+ * commands (and the fonts they use) hash the same as those last drawn into the
+ * layer, the layer is composited as it is.
+**/
+static inline void
+Fang_DrawInterface(
+          Fang_Framebuffer * const framebuf,
+          Fang_Interface   * const interface)
+{
+    assert(framebuf);
+    assert(interface);
+    assert(interface->textures);
+
+    if (!interface->num_commands)
+        return;
+
+    Fang_Rect area = interface->commands[0].area;
+
+    for (size_t i = 1; i < interface->num_commands; ++i)
+        area = Fang_UnionRect(&area, &interface->commands[i].area);
+
+    const Fang_Rect viewport = Fang_GetViewport(framebuf);
+
+    area = Fang_ClipRect(&area, &viewport);
+
+    if (area.w <= 0 || area.h <= 0)
+        return;
+
+    const uint64_t hash = Fang_HashData(
+        Fang_HashInterface(interface), &area, sizeof(area)
+    );
+
+    Fang_Framebuffer * const layer = &interface->layer;
+
+    if (!Fang_ImageValid(&layer->color) || interface->layer_hash != hash)
+    {
+        if (layer->color.width != area.w || layer->color.height != area.h)
+        {
+            Fang_FreeFramebuffer(layer);
+
+            if (Fang_AllocFramebuffer(
+                    layer,
+                    area.w,
+                    area.h,
+                    FANG_DEPTHLAYOUT_NONE,
+                    FANG_IMAGELAYOUT_ROWS))
+                return;
+        }
+
+        Fang_ClearFramebuffer(layer);
+
+        for (size_t i = 0; i < interface->num_commands; ++i)
+        {
+            const Fang_InterfaceCommand * const command = (
+                &interface->commands[i]
+            );
+
+            const Fang_Rect rect = {
+                .x = command->area.x - area.x,
+                .y = command->area.y - area.y,
+                .w = command->area.w,
+                .h = command->area.h,
+            };
+
+            switch (command->type)
+            {
+                case FANG_INTERFACECOMMAND_OUTLINE:
+                    Fang_DrawRect(layer, &rect, &command->color);
+                    break;
+
+                case FANG_INTERFACECOMMAND_FILL:
+                    Fang_FillRect(layer, &rect, &command->color);
+                    break;
+
+                case FANG_INTERFACECOMMAND_TEXT:
+                    Fang_DrawText(
+                        layer,
+                        interface->text + command->text_offset,
+                        Fang_GetTexture(interface->textures, command->font),
+                        rect.h,
+                        &(Fang_Point){rect.x, rect.y}
+                    );
+                    break;
+            }
+        }
+
+        if (Fang_BuildImageSpans(&layer->color))
+        {
+            Fang_FreeFramebuffer(layer);
+            return;
+        }
+
+        interface->layer_hash = hash;
+    }
+
+    Fang_CompositeFramebuffer(framebuf, layer, &area, UINT8_MAX);
+}
+
+/**
+ * Frees the interface's layer.
+**/
+static inline void
+Fang_FreeInterface(
+    Fang_Interface * const interface)
+{
+    assert(interface);
+
+    Fang_FreeFramebuffer(&interface->layer);
+    interface->layer_hash = 0;
+}
@@ -15,6 +15,9 @@
 
 /**
  * A structure representing the current world loaded in the game.
+ *
+ * The version must be incremented whenever the map's tiles are changed, so that
+ * anything built from them (such as the minimap) knows to be rebuilt.
 **/
 typedef struct Fang_Map {
     Fang_TextureId skybox;
@@ -22,4 +25,5 @@ typedef struct Fang_Map {
     Fang_Color     fog;
     float          fog_distance;
     Fang_Chunks    chunks;
+    uint32_t       version;
 } Fang_Map;
@@ -0,0 +1,309 @@
+// Copyright (C) 2021  Antonio Lassandro
+
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+
+// You should have received a copy of the GNU General Public License along
+// with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+/**
+ * The minimap covers FANG_MINIMAP_CHUNKS^2 chunks centered on the camera's
+ * chunk, and its view cone is made from FANG_MINIMAP_RAYS of the camera's rays.
+**/
+enum {
+    FANG_MINIMAP_CHUNKS = 3,
+    FANG_MINIMAP_RAYS   = 32,
+};
+
+/**
+ * A top-down view of the map around the camera, drawn from a cached layer.
+ *
+ * The tile layer holds the tiles of the chunks surrounding the camera, so the
+ * area within FANG_MINIMAP_RANGE of the camera can be shown without reading the
+ * map. It is only redrawn when the map's tiles change (see Fang_Map) or when the
+ * camera moves into another chunk.
+ *
+ * Each frame, the visible part of the tile layer is copied into the view, and
+ * the camera's view cone and position are drawn over it.
+**/
+typedef struct Fang_Minimap {
+    Fang_Framebuffer tiles;
+    Fang_Framebuffer view;
+    Fang_Point       chunk;
+    uint32_t         version;
+    bool             valid;
+} Fang_Minimap;
+
+/**
+ * Returns the index of the chunk at the center of the minimap for the given
+ * camera, such that the chunks surrounding it are always valid.
+**/
+static inline Fang_Point
+Fang_GetMinimapChunk(
+    const Fang_Camera * const camera)
+{
+    assert(camera);
+
+    return (Fang_Point){
+        .x = (int)clamp(
+            floorf(camera->pos.x / FANG_CHUNK_SIZE),
+            (float)(FANG_CHUNK_MIN + 1),
+            (float)(FANG_CHUNK_MAX - 2)
+        ),
+        .y = (int)clamp(
+            floorf(camera->pos.y / FANG_CHUNK_SIZE),
+            (float)(FANG_CHUNK_MIN + 1),
+            (float)(FANG_CHUNK_MAX - 2)
+        ),
+    };
+}
+
+/**
+ * Draws the tiles of the chunks surrounding the given chunk into the minimap's
+ * tile layer.
+ *
+ * Returns non-zero if the layer could not be allocated.
+**/
+static inline int
+Fang_BuildMinimapTiles(
+          Fang_Minimap * const minimap,
+    const Fang_Map     * const map,
+    const Fang_Point   * const chunk)
+{
+    assert(minimap);
+    assert(map);
+    assert(chunk);
+
+    const int tiles = FANG_MINIMAP_CHUNKS * FANG_CHUNK_SIZE;
+
+    if (!Fang_ImageValid(&minimap->tiles.color)
+    &&  Fang_AllocLayer(
+            &minimap->tiles,
+            tiles * FANG_MINIMAP_TILE,
+            tiles * FANG_MINIMAP_TILE))
+        return 1;
+
+    Fang_Framebuffer * const target = &minimap->tiles;
+
+    const Fang_Rect bounds = Fang_GetViewport(target);
+
+    Fang_FillRect(target, &bounds, &FANG_BLACK);
+
+    const Fang_Point origin = {
+        .x = (chunk->x - FANG_MINIMAP_CHUNKS / 2) * FANG_CHUNK_SIZE,
+        .y = (chunk->y - FANG_MINIMAP_CHUNKS / 2) * FANG_CHUNK_SIZE,
+    };
+
+    for (int x = 0; x < tiles; ++x)
+    {
+        for (int y = 0; y < tiles; ++y)
+        {
+            const Fang_Point tile_pos = {origin.x + x, origin.y + y};
+
+            if (!Fang_GetChunkTile(&map->chunks, &tile_pos))
+                continue;
+
+            /* Tiles are separated by a 1px gap */
+            Fang_FillRect(
+                target,
+                &(Fang_Rect){
+                    .x = x * FANG_MINIMAP_TILE,
+                    .y = y * FANG_MINIMAP_TILE,
+                    .w = FANG_MINIMAP_TILE - 1,
+                    .h = FANG_MINIMAP_TILE - 1,
+                },
+                &FANG_WHITE
+            );
+        }
+    }
+
+    minimap->chunk   = *chunk;
+    minimap->version = map->version;
+    minimap->valid   = true;
+    return 0;
+}
+
+/**
+ * Returns the point where a column's ray leaves the view cone, which is either
+ * its first tile hit or the furthest corner of the minimap.
+**/
+static inline Fang_Vec2
+Fang_GetMinimapRayEnd(
+    const Fang_Camera * const camera,
+    const Fang_Ray    * const ray,
+    const size_t              column,
+    const size_t              count)
+{
+    assert(camera);
+    assert(ray);
+    assert(column < count);
+
+    const Fang_Vec2 dir = Fang_GetCameraRayDir(camera, column, count);
+
+    float dist = (
+        ((float)FANG_MINIMAP_RANGE * sqrtf(2.0f))
+      / sqrtf(dir.x * dir.x + dir.y * dir.y)
+    );
+
+    /* The tile the camera stands on (if any) has no front face */
+    for (size_t i = 0; i < ray->hit_count; ++i)
+    {
+        if (ray->hits[i].front_dist > 0.0f)
+        {
+            dist = min(dist, ray->hits[i].front_dist);
+            break;
+        }
+    }
+
+    return (Fang_Vec2){
+        .x = camera->pos.x + dir.x * dist,
+        .y = camera->pos.y + dir.y * dist,
+    };
+}
+
+/**
+ * Draws the minimap into the framebuffer with its top-left corner at the given
+ * position, rebuilding its tile layer first if it is out of date.
+ *
+ * The rays are used for the view cone and should be those cast for the current
+ * frame, with one ray per column.
+**/
+static inline void
+Fang_DrawMinimap(
+          Fang_Framebuffer * const framebuf,
+          Fang_Minimap     * const minimap,
+    const Fang_Camera      * const camera,
+    const Fang_Map         * const map,
+    const Fang_Ray         * const rays,
+    const size_t                   count,
+    const Fang_Point       * const position)
+{
+    assert(framebuf);
+    assert(minimap);
+    assert(camera);
+    assert(map);
+    assert(rays);
+    assert(count);
+    assert(position);
+
+    const Fang_Point chunk = Fang_GetMinimapChunk(camera);
+
+    if (!minimap->valid
+    ||  minimap->version != map->version
+    ||  minimap->chunk.x != chunk.x
+    ||  minimap->chunk.y != chunk.y)
+    {
+        if (Fang_BuildMinimapTiles(minimap, map, &chunk))
+            return;
+    }
+
+    if (!Fang_ImageValid(&minimap->view.color)
+    &&  Fang_AllocLayer(
+            &minimap->view, FANG_MINIMAP_SIZE, FANG_MINIMAP_SIZE))
+        return;
+
+    Fang_Framebuffer * const target = &minimap->view;
+
+    /* Converts world positions into positions within the tile layer */
+    const Fang_Vec2 origin = {
+        .x = (float)((chunk.x - FANG_MINIMAP_CHUNKS / 2) * FANG_CHUNK_SIZE),
+        .y = (float)((chunk.y - FANG_MINIMAP_CHUNKS / 2) * FANG_CHUNK_SIZE),
+    };
+
+    const Fang_Vec2 center = {
+        .x = (camera->pos.x - origin.x) * FANG_MINIMAP_TILE,
+        .y = (camera->pos.y - origin.y) * FANG_MINIMAP_TILE,
+    };
+
+    /* The tile layer is scrolled so that the camera is in the middle */
+    const Fang_Point scroll = {
+        .x = (int)floorf(center.x) - FANG_MINIMAP_SIZE / 2,
+        .y = (int)floorf(center.y) - FANG_MINIMAP_SIZE / 2,
+    };
+
+    Fang_ClearFramebuffer(target);
+    Fang_CompositeFramebuffer(
+        target,
+        &minimap->tiles,
+        &(Fang_Rect){
+            .x = -scroll.x,
+            .y = -scroll.y,
+            .w = minimap->tiles.color.width,
+            .h = minimap->tiles.color.height,
+        },
+        UINT8_MAX
+    );
+
+    Fang_Vec2 cone[FANG_MINIMAP_RAYS + 2];
+
+    cone[0] = (Fang_Vec2){
+        .x = center.x - (float)scroll.x,
+        .y = center.y - (float)scroll.y,
+    };
+
+    for (size_t i = 0; i <= FANG_MINIMAP_RAYS; ++i)
+    {
+        const size_t column = min(i * count / FANG_MINIMAP_RAYS, count - 1);
+
+        const Fang_Vec2 ray_end = Fang_GetMinimapRayEnd(
+            camera, &rays[column], column, count
+        );
+
+        cone[i + 1] = (Fang_Vec2){
+            .x = (ray_end.x - origin.x) * FANG_MINIMAP_TILE - (float)scroll.x,
+            .y = (ray_end.y - origin.y) * FANG_MINIMAP_TILE - (float)scroll.y,
+        };
+    }
+
+    Fang_FillPolygon(
+        target,
+        cone,
+        FANG_MINIMAP_RAYS + 2,
+        &(Fang_Color){.b = 255, .a = 96}
+    );
+
+    Fang_FillRect(
+        target,
+        &(Fang_Rect){
+            .x = (int)floorf(cone[0].x) - 1,
+            .y = (int)floorf(cone[0].y) - 1,
+            .w = 3,
+            .h = 3,
+        },
+        &FANG_RED
+    );
+
+    Fang_CompositeFramebuffer(
+        framebuf,
+        &minimap->view,
+        &(Fang_Rect){
+            .x = position->x,
+            .y = position->y,
+            .w = FANG_MINIMAP_SIZE,
+            .h = FANG_MINIMAP_SIZE,
+        },
+        UINT8_MAX
+    );
+}
+
+/**
+ * Frees the minimap's layers.
+**/
+static inline void
+Fang_FreeMinimap(
+    Fang_Minimap * const minimap)
+{
+    assert(minimap);
+
+    Fang_FreeFramebuffer(&minimap->tiles);
+    Fang_FreeFramebuffer(&minimap->view);
+
+    memset(minimap, 0, sizeof(Fang_Minimap));
+}
@@ -0,0 +1,267 @@
+// Copyright (C) 2021  Antonio Lassandro
+
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+
+// You should have received a copy of the GNU General Public License along
+// with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+/**
+ * Asset packs hold the game's images already processed into the form they are
+ * sampled in (packed, premultiplied, laid out, and mipmapped), so that loading
+ * them only requires mapping the pack into memory.
+ *
+ * A pack begins with a header, followed by an index of entries. Each entry
+ * describes a single image (one mipmap level of a resource) and the offset of
+ * its pixel data, which is aligned to FANG_PACK_ALIGNMENT bytes. Values are
+ * stored in the byte order of the machine that built the pack, which is
+ * checked when the pack is opened.
+ *
+ * Packs are built offline by the packer in Source/Tools.
+**/
+enum {
+    FANG_PACK_VERSION   = 1,
+    FANG_PACK_ALIGNMENT = 64,
+    FANG_PACK_PATH_SIZE = 48,
+};
+
+static const char     FANG_PACK_MAGIC[8]   = {'F','A','N','G','P','A','C','K'};
+static const uint32_t FANG_PACK_BYTE_ORDER = 0x01020304;
+
+typedef struct Fang_PackHeader {
+    char     magic[8];
+    uint32_t byte_order;
+    uint32_t version;
+    uint32_t num_entries;
+    uint32_t reserved;
+} Fang_PackHeader;
+
+typedef struct Fang_PackEntry {
+    char     path[FANG_PACK_PATH_SIZE];
+    uint32_t level;
+    uint32_t width;
+    uint32_t height;
+    uint32_t pitch;
+    uint32_t stride;
+    uint32_t layout;
+    uint32_t flags;
+    uint32_t reserved;
+    uint64_t pixels;
+    uint64_t palette;
+} Fang_PackEntry;
+
+/**
+ * An opened asset pack.
+**/
+typedef struct Fang_Pack {
+          Fang_File         file;
+    const Fang_PackHeader * header;
+    const Fang_PackEntry  * entries;
+} Fang_Pack;
+
+/**
+ * Returns the number of bytes used by an entry's pixel data.
+**/
+static inline uint64_t
+Fang_GetPackEntrySize(
+    const Fang_PackEntry * const entry)
+{
+    assert(entry);
+
+    const uint64_t lines = (entry->layout == FANG_IMAGELAYOUT_COLUMNS)
+        ? entry->width
+        : entry->height;
+
+    return (uint64_t)entry->pitch * lines;
+}
+
+/**
+ * Checks that an entry describes a well-formed image whose lines fit within its
+ * pitch and whose pixels lie entirely within the pack, returning non-zero if
+ * they do not.
+**/
+static inline int
+Fang_ValidatePackEntry(
+    const Fang_File      * const file,
+    const Fang_PackEntry * const entry)
+{
+    assert(file);
+    assert(entry);
+
+    if (!entry->width || !entry->height || !entry->pitch)
+        return 1;
+
+    const bool palettized = entry->flags & FANG_IMAGEFLAG_PALETTIZED;
+
+    if (entry->stride != ((palettized) ? 1u : 4u))
+        return 1;
+
+    if (entry->layout > FANG_IMAGELAYOUT_SWIZZLED)
+        return 1;
+
+    const uint64_t line_size = (uint64_t)entry->stride * (
+        (entry->layout == FANG_IMAGELAYOUT_COLUMNS)
+            ? entry->height
+            : entry->width
+    );
+
+    if (entry->pitch < line_size)
+        return 1;
+
+    if (entry->layout == FANG_IMAGELAYOUT_SWIZZLED
+    && (entry->height & (entry->height - 1) || entry->width % entry->height))
+        return 1;
+
+    if (entry->pixels % FANG_PACK_ALIGNMENT)
+        return 1;
+
+    if (entry->pixels > file->size
+    ||  Fang_GetPackEntrySize(entry) > file->size - entry->pixels)
+        return 1;
+
+    if (palettized)
+    {
+        if (entry->palette % FANG_PACK_ALIGNMENT)
+            return 1;
+
+        if (entry->palette > file->size
+        ||  file->size - entry->palette
+          < sizeof(uint32_t) * FANG_PALETTE_SIZE)
+            return 1;
+    }
+
+    return 0;
+}
+
+/**
+ * Opens an asset pack by mapping it into memory.
+ *
+ * The pack's header and every entry in its index are validated, returning
+ * non-zero if the pack could not be mapped, was built for a different version
+ * or byte order, or describes an image that does not fit its own pitch or the
+ * pack itself.
+**/
+static inline int
+Fang_OpenPack(
+    const char      * const filename,
+          Fang_Pack * const pack)
+{
+    assert(filename);
+    assert(pack);
+
+    memset(pack, 0, sizeof(Fang_Pack));
+
+    if (Fang_MapFile(filename, &pack->file) != FANG_FILE_ERROR_NONE)
+        return 1;
+
+    const Fang_PackHeader * const header = pack->file.data;
+
+    if (pack->file.size < sizeof(Fang_PackHeader))
+        goto Error_Invalid;
+
+    if (memcmp(header->magic, FANG_PACK_MAGIC, sizeof(FANG_PACK_MAGIC)))
+        goto Error_Invalid;
+
+    if (header->byte_order != FANG_PACK_BYTE_ORDER)
+        goto Error_Invalid;
+
+    if (header->version != FANG_PACK_VERSION)
+        goto Error_Invalid;
+
+    const size_t index_size = sizeof(Fang_PackEntry) * header->num_entries;
+
+    if (pack->file.size - sizeof(Fang_PackHeader) < index_size)
+        goto Error_Invalid;
+
+    pack->header  = header;
+    pack->entries = (const Fang_PackEntry*)(header + 1);
+
+    for (uint32_t i = 0; i < header->num_entries; ++i)
+    {
+        if (Fang_ValidatePackEntry(&pack->file, &pack->entries[i]))
+            goto Error_Invalid;
+    }
+
+    return 0;
+
+Error_Invalid:
+    Fang_UnmapFile(&pack->file);
+    memset(pack, 0, sizeof(Fang_Pack));
+    return 1;
+}
+
+/**
+ * Closes an asset pack, any images taken from the pack are no longer valid
+ * afterwards.
+**/
+static inline void
+Fang_ClosePack(
+    Fang_Pack * const pack)
+{
+    assert(pack);
+
+    if (pack->file.data)
+        Fang_UnmapFile(&pack->file);
+
+    memset(pack, 0, sizeof(Fang_Pack));
+}
+
+/**
+ * Finds an image in the asset pack by its resource path and mipmap level.
+ *
+ * The resulting image is borrowed, with its pixels pointing directly into the
+ * pack. Returns non-zero if the pack has no such image.
+**/
+static inline int
+Fang_GetPackedImage(
+    const Fang_Pack  * const pack,
+    const char       * const path,
+    const int                level,
+          Fang_Image * const result)
+{
+    assert(pack);
+    assert(path);
+    assert(result);
+
+    if (!pack->header)
+        return 1;
+
+    for (uint32_t i = 0; i < pack->header->num_entries; ++i)
+    {
+        const Fang_PackEntry * const entry = &pack->entries[i];
+
+        if (entry->level != (uint32_t)level)
+            continue;
+
+        if (strncmp(entry->path, path, FANG_PACK_PATH_SIZE))
+            continue;
+
+        const bool palettized = entry->flags & FANG_IMAGEFLAG_PALETTIZED;
+
+        uint8_t * const data = pack->file.data;
+
+        *result = (Fang_Image){
+            .pixels  = data + entry->pixels,
+            .palette = (palettized)
+                ? (uint32_t*)(void*)(data + entry->palette)
+                : NULL,
+            .width   = (int)entry->width,
+            .height  = (int)entry->height,
+            .pitch   = (int)entry->pitch,
+            .stride  = (int)entry->stride,
+            .layout  = (Fang_ImageLayout)entry->layout,
+            .flags   = (int)entry->flags | FANG_IMAGEFLAG_BORROWED,
+        };
+
+        return 0;
+    }
+
+    return 1;
+}
@@ -20,6 +20,7 @@ typedef struct Fang_RayHit {
     Fang_Vec2   back_hit;
     float       back_dist;
     Fang_Face   norm_dir;
+    Fang_Face   back_dir;
 } Fang_RayHit;
 
 typedef struct Fang_Ray {
@@ -27,99 +28,359 @@ typedef struct Fang_Ray {
     size_t      hit_count;
 } Fang_Ray;
 
+/**
+ * The state shared by the rays cast for a camera.
+ *
+ * The initial tile is the tile the camera is standing on top of, if any, which
+ * is given as the first hit of every ray.
+**/
+typedef struct Fang_RayCaster {
+    const Fang_Camera * camera;
+    const Fang_Chunks * chunks;
+    const Fang_Tile   * initial_tile;
+          Fang_Vec2     pos;
+          Fang_Ray    * rays;
+          size_t        ray_count;
+} Fang_RayCaster;
+
+/**
+ * Returns the direction of the ray cast for the given column.
+**/
+static inline Fang_Vec2
+Fang_GetRayDir(
+    const Fang_RayCaster * const caster,
+    const size_t                 column)
+{
+    assert(caster);
+    assert(column < caster->ray_count);
+
+    return Fang_GetCameraRayDir(caster->camera, column, caster->ray_count);
+}
+
+/**
+ * Returns the distance along a ray to the point where it enters a tile through
+ * the given face, where the tile is given by its position along the axis the
+ * face is on.
+ *
+ * This is the same distance Fang_StepDDA() gives when entering the tile, and is
+ * calculated the same way.
+**/
+static inline float
+Fang_GetFaceDistance(
+    const Fang_Vec2 * const start,
+    const Fang_Vec2 * const dir,
+    const Fang_Face         face,
+    const float             tile)
+{
+    assert(start);
+    assert(dir);
+
+    const bool x_face = face == FANG_FACE_EAST || face == FANG_FACE_WEST;
+
+    const float ray_start = (x_face) ? start->x : start->y;
+    const float ray_dir   = (x_face) ? dir->x   : dir->y;
+    const float step      = (ray_dir < 0.0f) ? -1.0f : 1.0f;
+
+    float result = tile - ray_start + (1.0f - step) / 2.0f;
+
+    if (ray_dir != 0.0f)
+        result /= ray_dir;
+
+    return result;
+}
+
+/**
+ * Returns the position (along the axis the given face is on) of the tile a ray
+ * entered through that face at the given point.
+**/
+static inline float
+Fang_GetEnteredTile(
+    const Fang_Vec2 * const point,
+    const Fang_Vec2 * const dir,
+    const Fang_Face         face)
+{
+    assert(point);
+    assert(dir);
+
+    const bool x_face = face == FANG_FACE_EAST || face == FANG_FACE_WEST;
+
+    const float ray_dir = (x_face) ? dir->x : dir->y;
+    const float step    = (ray_dir < 0.0f) ? -1.0f : 1.0f;
+
+    /* The point lies on the grid line at the near side of the tile */
+    return roundf((x_face) ? point->x : point->y) - (1.0f - step) / 2.0f;
+}
+
+/**
+ * Casts the ray of a single column through the map, recording every tile it
+ * hits within FANG_RAY_MAX_STEPS steps.
+**/
 static inline void
-Fang_CastRays(
-    const Fang_Camera * const camera,
-    const Fang_Chunks * const chunks,
-          Fang_Ray    * const rays,
-    const size_t              ray_count)
+Fang_CastRay(
+    const Fang_RayCaster * const caster,
+    const size_t                 column)
 {
-    assert(camera);
-    assert(chunks);
-    assert(rays);
-    assert(ray_count);
+    assert(caster);
+    assert(column < caster->ray_count);
 
-    const Fang_Vec3 * const dir = &camera->dir;
-    const Fang_Vec2 * const cam = &camera->cam;
-    const Fang_Vec2         pos = (Fang_Vec2){
-        .x = camera->pos.x,
-        .y = camera->pos.y
-    };
+    Fang_Ray * const ray = &caster->rays[column];
 
-    memset(rays, 0, sizeof(Fang_Ray) * ray_count);
+    const Fang_Vec2 pos     = caster->pos;
+    const Fang_Vec2 cam_ray = Fang_GetRayDir(caster, column);
 
-    const Fang_Tile * const initial_tile = Fang_GetChunkTile(chunks, &pos);
+    Fang_DDAState dda;
+    Fang_InitDDA(&dda, &pos, &cam_ray);
 
-    const bool standing_on_tile = (initial_tile)
-        ? initial_tile->offset + initial_tile->height <= camera->pos.z
-        : false;
+    size_t hit_count = 0;
 
-    for (size_t i = 0; i < ray_count; ++i)
+    /* Add initial hit if player is on top of a tile */
+    if (caster->initial_tile)
     {
-        /* X coordinate in camera space, normalized -1.0f..1.0f */
-        const float plane_x = (
-            2.0f * (1.0f - (float)i / (float)ray_count) - 1.0f
-        );
+        Fang_RayHit * const hit = &ray->hits[hit_count];
+
+        const Fang_DDAState old_dda = dda;
 
-        /* Map ray start position onto camera plane */
-        const Fang_Vec2 cam_ray = {
-            .x = dir->x + cam->x * plane_x,
-            .y = dir->y + cam->y * plane_x,
+        /* Front-face is not needed for rendering */
+        hit->tile      = (Fang_Tile*)caster->initial_tile;
+        hit->back_dist = Fang_StepDDA(&dda);
+        hit->back_dir  = Fang_GetOppositeFace(dda.face);
+        hit->back_hit  = (Fang_Vec2){
+            .x = dda.pos.x - dda.start.x,
+            .y = dda.pos.y - dda.start.y,
         };
 
-        Fang_DDAState dda;
-        Fang_InitDDA(&dda, &pos, &cam_ray);
+        dda = old_dda;
+        hit_count++;
+    }
 
-        size_t hit_count = 0;
+    for (size_t step = hit_count; step < FANG_RAY_MAX_STEPS; ++step)
+    {
+        Fang_RayHit * const hit = &ray->hits[hit_count];
 
-        /* Add initial hit if player is on top of a tile */
-        if (standing_on_tile)
-        {
-            Fang_RayHit * const hit = &rays[i].hits[hit_count];
+        hit->front_dist = Fang_StepDDA(&dda);
 
+        hit->tile = (Fang_Tile*)Fang_GetChunkTile(caster->chunks, &dda.pos);
+
+        if (hit->tile)
+        {
             const Fang_DDAState old_dda = dda;
 
-            /* Front-face is not needed for rendering */
-            hit->tile      = (Fang_Tile*)initial_tile;
+            hit->norm_dir  = dda.face;
+            hit->front_hit = (Fang_Vec2){
+                .x = pos.x + (hit->front_dist * cam_ray.x),
+                .y = pos.y + (hit->front_dist * cam_ray.y),
+            };
+
             hit->back_dist = Fang_StepDDA(&dda);
+            hit->back_dir  = Fang_GetOppositeFace(dda.face);
             hit->back_hit  = (Fang_Vec2){
-                .x = dda.pos.x - dda.start.x,
-                .y = dda.pos.y - dda.start.y,
+                .x = pos.x + (hit->back_dist * cam_ray.x),
+                .y = pos.y + (hit->back_dist * cam_ray.y),
             };
 
             dda = old_dda;
             hit_count++;
         }
+    }
 
-        for (size_t step = hit_count; step < FANG_RAY_MAX_STEPS; ++step)
-        {
-            Fang_RayHit * const hit = &rays[i].hits[hit_count];
+    ray->hit_count = hit_count;
+}
 
-            hit->front_dist = Fang_StepDDA(&dda);
+/**
+ * Returns whether two rays hit the same faces of the same tiles, in the same
+ * order.
+**/
+static inline bool
+Fang_RaysCoherent(
+    const Fang_Ray * const a,
+    const Fang_Ray * const b)
+{
+    assert(a);
+    assert(b);
 
-            hit->tile = (Fang_Tile*)Fang_GetChunkTile(chunks, &dda.pos);
+    if (a->hit_count != b->hit_count)
+        return false;
 
-            if (hit->tile)
-            {
-                const Fang_DDAState old_dda = dda;
+    for (size_t i = 0; i < a->hit_count; ++i)
+    {
+        if (a->hits[i].tile     != b->hits[i].tile
+        ||  a->hits[i].norm_dir != b->hits[i].norm_dir
+        ||  a->hits[i].back_dir != b->hits[i].back_dir)
+            return false;
+    }
 
-                hit->norm_dir  = dda.face;
-                hit->front_hit = (Fang_Vec2){
-                    .x = pos.x + (hit->front_dist * cam_ray.x),
-                    .y = pos.y + (hit->front_dist * cam_ray.y),
-                };
+    return true;
+}
 
-                hit->back_dist = Fang_StepDDA(&dda);
-                hit->back_hit  = (Fang_Vec2){
-                    .x = pos.x + (hit->back_dist * cam_ray.x),
-                    .y = pos.y + (hit->back_dist * cam_ray.y),
-                };
+/**
+ * Fills in the ray of a column from the ray of a neighbouring column, which
+ * must hit the same faces of the same tiles.
+ *
+ * Each hit enters and leaves the same tiles through the same faces as the
+ * neighbour's hit, so only its distances along the column's ray have to be
+ * found. The results are the same as casting the ray with Fang_CastRay().
+**/
+static inline void
+Fang_InterpolateRay(
+    const Fang_RayCaster * const caster,
+    const size_t                 column,
+    const Fang_Ray       * const source)
+{
+    assert(caster);
+    assert(column < caster->ray_count);
+    assert(source);
 
-                dda = old_dda;
-                hit_count++;
-            }
-        }
+    Fang_Ray * const ray = &caster->rays[column];
+
+    const Fang_Vec2 pos     = caster->pos;
+    const Fang_Vec2 cam_ray = Fang_GetRayDir(caster, column);
+
+    *ray = *source;
+
+    size_t i = 0;
+
+    /* The back of the initial tile leads into the same neighbouring tile */
+    if (caster->initial_tile)
+    {
+        Fang_RayHit * const hit = &ray->hits[i++];
+
+        const Fang_Face face = Fang_GetOppositeFace(hit->back_dir);
+
+        const bool x_face = face == FANG_FACE_EAST || face == FANG_FACE_WEST;
+
+        /* Its back hit is the neighbouring tile's position from the start */
+        hit->back_dist = Fang_GetFaceDistance(
+            &pos,
+            &cam_ray,
+            face,
+            roundf((x_face) ? pos.x + hit->back_hit.x : pos.y + hit->back_hit.y)
+        );
+    }
+
+    for (; i < ray->hit_count; ++i)
+    {
+        Fang_RayHit * const hit = &ray->hits[i];
+
+        hit->front_dist = Fang_GetFaceDistance(
+            &pos,
+            &cam_ray,
+            hit->norm_dir,
+            Fang_GetEnteredTile(&hit->front_hit, &cam_ray, hit->norm_dir)
+        );
+
+        hit->front_hit = (Fang_Vec2){
+            .x = pos.x + (hit->front_dist * cam_ray.x),
+            .y = pos.y + (hit->front_dist * cam_ray.y),
+        };
+
+        const Fang_Face back_face = Fang_GetOppositeFace(hit->back_dir);
+
+        hit->back_dist = Fang_GetFaceDistance(
+            &pos,
+            &cam_ray,
+            back_face,
+            Fang_GetEnteredTile(&hit->back_hit, &cam_ray, back_face)
+        );
+
+        hit->back_hit = (Fang_Vec2){
+            .x = pos.x + (hit->back_dist * cam_ray.x),
+            .y = pos.y + (hit->back_dist * cam_ray.y),
+        };
+    }
+}
+
+/**
+ * Fills in the rays of the columns between two cast rays.
+ *
+ * When both rays hit the same faces of the same tiles, so does every ray
+ * between them, and those are interpolated. Otherwise the ray of the middle
+ * column is cast, and each half is refined in the same way.
+**/
+static inline void
+Fang_RefineRays(
+    const Fang_RayCaster * const caster,
+    const size_t                 start,
+    const size_t                 end)
+{
+    assert(caster);
+    assert(start < end);
+    assert(end < caster->ray_count);
+
+    if (end - start < 2)
+        return;
+
+    const Fang_Ray * const first = &caster->rays[start];
+    const Fang_Ray * const last  = &caster->rays[end];
+
+    if (Fang_RaysCoherent(first, last))
+    {
+        for (size_t i = start + 1; i < end; ++i)
+            Fang_InterpolateRay(caster, i, first);
+
+        return;
+    }
+
+    const size_t middle = start + (end - start) / 2;
+
+    Fang_CastRay(caster, middle);
+    Fang_RefineRays(caster, start, middle);
+    Fang_RefineRays(caster, middle, end);
+}
+
+/**
+ * Casts one ray per column through the map.
+ *
+ * With a ray step above 1, only every ray_step-th ray is cast, and the rays
+ * between are refined with Fang_RefineRays(). Neighbouring rays usually hit the
+ * same faces, so this skips most of the DDA steps, but a tile narrow enough to
+ * fall entirely between two cast rays can be missed.
+**/
+static inline void
+Fang_CastRays(
+    const Fang_Camera * const camera,
+    const Fang_Chunks * const chunks,
+          Fang_Ray    * const rays,
+    const size_t              ray_count,
+    const size_t              ray_step)
+{
+    assert(camera);
+    assert(chunks);
+    assert(rays);
+    assert(ray_count);
+
+    Fang_RayCaster caster = {
+        .camera    = camera,
+        .chunks    = chunks,
+        .pos       = {.x = camera->pos.x, .y = camera->pos.y},
+        .rays      = rays,
+        .ray_count = ray_count,
+    };
+
+    memset(rays, 0, sizeof(Fang_Ray) * ray_count);
+
+    const Fang_Tile * const initial_tile = Fang_GetChunkTile(
+        chunks, &caster.pos
+    );
+
+    if (initial_tile
+    &&  initial_tile->offset + initial_tile->height <= camera->pos.z)
+        caster.initial_tile = initial_tile;
+
+    if (ray_step < 2)
+    {
+        for (size_t i = 0; i < ray_count; ++i)
+            Fang_CastRay(&caster, i);
+
+        return;
+    }
+
+    Fang_CastRay(&caster, 0);
+
+    for (size_t start = 0; start + 1 < ray_count; start += ray_step)
+    {
+        const size_t end = min(start + ray_step, ray_count - 1);
 
-        rays[i].hit_count = hit_count;
+        Fang_CastRay(&caster, end);
+        Fang_RefineRays(&caster, start, end);
     }
 }
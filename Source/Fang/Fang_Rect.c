@@ -47,6 +47,25 @@ Fang_ClipRect(
     return result;
 }
 
+/**
+ * Returns the smallest rectangle which covers both of the given rectangles.
+**/
+static inline Fang_Rect
+Fang_UnionRect(
+    const Fang_Rect * const a,
+    const Fang_Rect * const b)
+{
+    assert(a);
+    assert(b);
+
+    Fang_Rect result;
+    result.x = min(a->x, b->x);
+    result.w = max(a->x + a->w, b->x + b->w) - result.x;
+    result.y = min(a->y, b->y);
+    result.h = max(a->y + a->h, b->y + b->h) - result.y;
+    return result;
+}
+
 /**
  * Returns whether or not a point lies within a given area.
 **/
@@ -14,58 +14,126 @@
 // with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 /**
- * Draws a line in the framebuffer using Bresenham's Algorithm.
+ * The amount of pixels drawn between perspective corrections when texturing
+ * surfaces that recede into the screen (such as the tops of tiles).
  *
- * The target framebuffer must have a valid color image.
+ * Exact quality performs one reciprocal per pixel, while the lower qualities
+ * only correct the texture coordinates at the ends of each run and step them
+ * linearly between. Lower qualities are faster but will cause textures to
+ * 'swim' slightly on surfaces seen at a steep angle.
 **/
-static void
-Fang_DrawLine(
-          Fang_Framebuffer * const framebuf,
-    const Fang_Point       * const start,
-    const Fang_Point       * const end,
-    const Fang_Color       * const color)
-{
-    assert(framebuf);
-    assert(start);
-    assert(end);
-    assert(color);
-
-    const Fang_Point delta = {
-        .x =  abs(end->x - start->x),
-        .y = -abs(end->y - start->y),
-    };
-
-    const Fang_Point step = {
-        .x = (start->x < end->x) ? 1 : (start->x > end->x) ? -1 : 0,
-        .y = (start->y < end->y) ? 1 : (start->y > end->y) ? -1 : 0,
-    };
+typedef enum Fang_PerspectiveQuality {
+    FANG_PERSPECTIVE_EXACT  = 1,
+    FANG_PERSPECTIVE_HIGH   = 4,
+    FANG_PERSPECTIVE_MEDIUM = 8,
+    FANG_PERSPECTIVE_LOW    = 16,
+} Fang_PerspectiveQuality;
 
-    Fang_Point point = *start;
-    int        err   = delta.x + delta.y;
+/**
+ * Options used by the renderer to trade image quality for speed.
+ *
+ * The strip width is the number of columns the world is drawn in at a time,
+ * with every pass being drawn over one strip before moving on to the next so
+ * that the strip's pixels stay in the cache (see Fang_Update()). Strips give
+ * the same image at any width, a width of 0 draws each pass over the whole
+ * framebuffer.
+ *
+ * The ray step is the spacing of the columns whose rays are cast through the
+ * map, with the rays between them interpolated where possible (see
+ * Fang_CastRays()). A step of 1 casts every ray.
+ *
+ * Interlaced frames only draw every other column of the world, alternating
+ * between the even and odd columns each frame, and reconstruct the rest from
+ * the previous frame (see Fang_ReconstructFramebuffer()). This roughly halves
+ * the cost of drawing, but things moving quickly across the screen can leave
+ * streaks behind them.
+ *
+ * Deferred frames only record which texel of which surface is visible in each
+ * pixel while drawing opaque floors and tiles, and texture every pixel once
+ * all of them have been recorded (see Fang_VisibilityBuffer). Surfaces hidden
+ * behind others are then never sampled.
+**/
+typedef struct Fang_RenderSettings {
+    Fang_PerspectiveQuality perspective;
+    int                     strip_width;
+    int                     ray_step;
+    bool                    interlaced;
+    bool                    deferred;
+} Fang_RenderSettings;
 
-    while (true)
-    {
-        Fang_SetFragment(framebuf, &point, color);
+/**
+ * The nearest opaque wall drawn in a single column of the framebuffer.
+ *
+ * Everything further away than the wall is hidden between its top and bottom
+ * rows, so sprites can be clipped against it a column at a time. Columns
+ * without an opaque wall have an infinite depth.
+**/
+typedef struct Fang_ColumnOccluder {
+    float depth;
+    int   top;
+    int   bottom;
+} Fang_ColumnOccluder;
 
-        if ((err * 2) >= delta.y)
-        {
-            if (point.x == end->x)
-                break;
+/**
+ * The floor as seen by a single row of the framebuffer (see
+ * Fang_GetFloorRows()).
+ *
+ * The position is that of the next column to be drawn, and is moved along by
+ * the step after each column, so rows must be drawn from left to right. The
+ * pixel size is the floor distance covered by a pixel, which selects the
+ * mipmap level. Rows which don't show any floor aren't visible.
+**/
+typedef struct Fang_FloorRow {
+    Fang_Vec2 pos;
+    Fang_Vec2 step;
+    float     depth;
+    float     pixel_size;
+    bool      visible;
+} Fang_FloorRow;
 
-            err     += delta.y;
-            point.x += step.x;
-        }
+/**
+ * The texel seen in a pixel of a deferred frame (see Fang_VisibilityBuffer).
+ *
+ * The surface is one more than the index of the image the texel is read from,
+ * so that pixels without a recorded texel have a surface of 0. The position of
+ * the texel already includes the offset of a tile's face.
+**/
+typedef struct Fang_VisibleTexel {
+    uint16_t surface;
+    uint16_t x;
+    uint16_t y;
+} Fang_VisibleTexel;
 
-        if ((err * 2) <= delta.x)
-        {
-            if (point.y == end->y)
-                break;
+/**
+ * Every image which may be recorded as a surface: each level of each texture,
+ * and the 'XOR Texture'.
+**/
+enum {
+    FANG_MAX_SURFACES = FANG_NUM_TEXTURES * FANG_TEXTURE_LEVELS + 1,
+};
 
-            err     += delta.x;
-            point.y += step.y;
-        }
-    }
-}
+/**
+ * The texels recorded for a framebuffer by a deferred frame.
+ *
+ * Opaque surfaces are drawn in two passes. First each fragment is depth tested
+ * as usual, but only its texel is recorded (see Fang_SetVisibleTexel()), which
+ * leaves the texel of the nearest surface in each pixel. Every recorded texel
+ * is then read once and written to the color image, with
+ * Fang_ResolveVisibility().
+ *
+ * Texels are laid out in the same way as the framebuffer's fragments, with the
+ * steps being the distance (in texels) between neighbouring pixels. The
+ * surfaces are the images referenced by the texels, and are only kept until
+ * they are resolved.
+**/
+typedef struct Fang_VisibilityBuffer {
+    Fang_VisibleTexel  * texels;
+    size_t               size;
+    int                  step_x;
+    int                  step_y;
+    const Fang_Image   * surfaces[FANG_MAX_SURFACES];
+    int                  surface_count;
+} Fang_VisibilityBuffer;
 
 /**
  * Draws a vertical line across the framebuffer.
@@ -174,271 +242,1101 @@ Fang_FillRect(
 }
 
 /**
- * Draws an image (or subsection) to the given area in the framebuffer.
- *
- * If the source is NULL, the image size is used with an origin of 0, 0. If the
- * destination is NULL, the framebuffer color image size is used with an origin
- * of 0, 0.
+ * The most points a polygon given to Fang_FillPolygon() may have.
+**/
+enum {
+    FANG_POLYGON_MAX_POINTS = 64,
+};
+
+/**
+ * Fills a polygon in the framebuffer with the given color.
  *
- * If the sizes of the source and destination rectangles do not match, the image
- * will be scaled to fit the destination rectangle. This scaling is linear, no
- * resampling is performed.
+ * Pixels are filled when their centers lie inside the polygon by the even-odd
+ * rule, so the polygon does not need to be convex. Each pixel is written once,
+ * so translucent colors are blended evenly.
  *
- * The source image may be flipped in the X or Y direction when being drawn.
+ * The target framebuffer must have a valid color image.
 **/
 static void
-Fang_DrawImageEx(
+Fang_FillPolygon(
           Fang_Framebuffer * const framebuf,
-    const Fang_Image       * const image,
-    const Fang_Rect        * const source,
-    const Fang_Rect        * const dest,
-    const bool                     flip_x,
-    const bool                     flip_y)
+    const Fang_Vec2        * const points,
+    const size_t                   count,
+    const Fang_Color       * const color)
 {
     assert(framebuf);
-    assert(framebuf->color.stride == 4);
+    assert(points);
+    assert(count <= FANG_POLYGON_MAX_POINTS);
+    assert(color);
 
-    /* If the image is invalid we will supply a default size for
-       Fang_GetPixel() to use in creating the 'XOR Texture'.
-    */
-    const Fang_Rect image_area = (Fang_ImageValid(image))
-        ? (Fang_Rect){.w = image->width, .h = image->height}
-        : (Fang_Rect){.w = FANG_TEXTURE_SIZE, .h = FANG_TEXTURE_SIZE};
+    if (count < 3)
+        return;
 
-    const Fang_Rect source_area = (source)
-        ? Fang_ClipRect(source, &image_area)
-        : image_area;
+    const Fang_Rect viewport = Fang_GetViewport(framebuf);
+    const uint32_t  pixel    = Fang_PremultiplyPixel(Fang_MapColor(color));
 
-    const Fang_Rect framebuf_area = Fang_GetViewport(framebuf);
+    float min_y = points[0].y;
+    float max_y = points[0].y;
 
-    const Fang_Rect dest_area = (dest)
-        ? *dest
-        : framebuf_area;
+    for (size_t i = 1; i < count; ++i)
+    {
+        min_y = min(min_y, points[i].y);
+        max_y = max(max_y, points[i].y);
+    }
 
-    const Fang_Rect clipped_area = Fang_ClipRect(&dest_area, &framebuf_area);
+    const int start_y = max((int)ceilf(min_y - 0.5f), 0);
+    const int end_y   = min((int)ceilf(max_y - 0.5f), viewport.h);
+
+    float crossings[FANG_POLYGON_MAX_POINTS];
 
-    for (int x = clipped_area.x; x < clipped_area.x + clipped_area.w; ++x)
+    for (int y = start_y; y < end_y; ++y)
     {
-        for (int y = clipped_area.y; y < clipped_area.y + clipped_area.h; ++y)
+        const float center = (float)y + 0.5f;
+
+        size_t num_crossings = 0;
+
+        /* Find where each edge crosses the row, keeping them sorted */
+        for (size_t i = 0; i < count; ++i)
         {
-            float r_x = (float)(x - dest_area.x) / (float)dest_area.w;
-            float r_y = (float)(y - dest_area.y) / (float)dest_area.h;
+            const Fang_Vec2 * const a = &points[i];
+            const Fang_Vec2 * const b = &points[(i + 1) % count];
 
-            r_x = max(min(r_x, 1.0f), 0.0f);
-            r_y = max(min(r_y, 1.0f), 0.0f);
+            if ((a->y <= center) == (b->y <= center))
+                continue;
 
-            if (flip_x)
-                r_x = 1.0f - r_x;
+            const float x = a->x
+                          + (center - a->y) * (b->x - a->x) / (b->y - a->y);
 
-            if (flip_y)
-                r_y = 1.0f - r_y;
+            size_t j = num_crossings++;
 
-            const Fang_Point tex_pos = {
-                .x = (flip_x)
-                    ? (int)(r_x * (source_area.w - 1)) + source_area.x
-                    : (int)(r_x * (source_area.w - 0)) + source_area.x,
-                .y = (flip_y)
-                    ? (int)(r_y * (source_area.h - 1)) + source_area.y
-                    : (int)(r_y * (source_area.h - 0)) + source_area.y,
-            };
+            for (; j > 0 && crossings[j - 1] > x; --j)
+                crossings[j] = crossings[j - 1];
 
-            const Fang_Color dest_color = Fang_GetPixel(image, &tex_pos);
+            crossings[j] = x;
+        }
 
-            Fang_SetFragment(
-                framebuf,
-                &(Fang_Point){x, y},
-                &dest_color
+        for (size_t i = 0; i + 1 < num_crossings; i += 2)
+        {
+            const int start_x = max((int)ceilf(crossings[i] - 0.5f), 0);
+            const int end_x   = min(
+                (int)ceilf(crossings[i + 1] - 0.5f), viewport.w
             );
+
+            for (int x = start_x; x < end_x; ++x)
+                Fang_SetPackedFragment(framebuf, &(Fang_Point){x, y}, pixel);
         }
     }
 }
 
 /**
- * Shortcut function for Fang_DrawImageEx() without flipping the source image or
- * providing a shade color.
+ * Returns the row of the source area which is read by a row of the destination
+ * area, as part of Fang_DrawImageEx().
 **/
-static inline void
-Fang_DrawImage(
-          Fang_Framebuffer * const framebuf,
-    const Fang_Image       * const image,
-    const Fang_Rect        * const source,
-    const Fang_Rect        * const dest)
+static inline int
+Fang_GetImageRow(
+    const Fang_Rect * const source,
+    const Fang_Rect * const dest,
+    const bool              flip_y,
+    const int               y)
 {
-    Fang_DrawImageEx(framebuf, image, source, dest, false, false);
+    assert(source);
+    assert(dest);
+
+    float r_y = (float)(y - dest->y) / (float)dest->h;
+
+    r_y = max(min(r_y, 1.0f), 0.0f);
+
+    if (flip_y)
+        r_y = 1.0f - r_y;
+
+    return (flip_y)
+        ? (int)(r_y * (source->h - 1)) + source->y
+        : (int)(r_y * (source->h - 0)) + source->y;
 }
 
 /**
- * Draws a line of text into the framebuffer using the given font type.
+ * Finds the first destination row between start_y and end_y which reads a
+ * source row past the given one, returning end_y if there is none.
+ *
+ * Rows are read in increasing order, or decreasing order if flipped, in which
+ * case the first row reading above the given one is found instead. As the rows
+ * read are ordered, this is a binary search.
 **/
-static void
-Fang_DrawText(
+static inline int
+Fang_FindImageRow(
+    const Fang_Rect * const source,
+    const Fang_Rect * const dest,
+    const bool              flip_y,
+          int               start_y,
+          int               end_y,
+    const int               row)
+{
+    while (start_y < end_y)
+    {
+        const int y = start_y + (end_y - start_y) / 2;
+
+        const int source_y = Fang_GetImageRow(source, dest, flip_y, y);
+
+        if ((flip_y) ? (source_y < row) : (source_y >= row))
+            end_y = y;
+        else
+            start_y = y + 1;
+    }
+
+    return start_y;
+}
+
+/**
+ * Draws the rows between start_y and end_y of a single column of a scaled
+ * image, as part of Fang_DrawImageEx().
+ *
+ * The texture must be valid and the source area must be within its bounds.
+**/
+static inline void
+Fang_DrawScaledColumn(
           Fang_Framebuffer * const framebuf,
-    const char             *       text,
-    const Fang_Image       * const font,
-    const int                      fontheight,
-    const Fang_Point       * const origin)
+    const Fang_Image       * const texture,
+    const Fang_Rect        * const source_area,
+    const Fang_Rect        * const dest_area,
+    const bool                     flip_x,
+    const bool                     flip_y,
+    const int                      x,
+    const int                      start_y,
+    const int                      end_y)
 {
     assert(framebuf);
-    assert(text);
-    assert(font);
+    assert(texture);
+    assert(source_area);
+    assert(dest_area);
 
-    Fang_Point position = (origin) ? *origin : (Fang_Point){0, 0};
+    const bool premultiplied = texture->flags & FANG_IMAGEFLAG_PREMULTIPLIED;
 
-    const float ratio = (float)fontheight / (float)FANG_FONT_HEIGHT;
+    float r_x = (float)(x - dest_area->x) / (float)dest_area->w;
+
+    r_x = max(min(r_x, 1.0f), 0.0f);
+
+    if (flip_x)
+        r_x = 1.0f - r_x;
+
+    const int tex_x = (flip_x)
+        ? (int)(r_x * (source_area->w - 1)) + source_area->x
+        : (int)(r_x * (source_area->w - 0)) + source_area->x;
+
+    /* Palettized images are read a decoded column at a time */
+    const uint32_t * const texels = Fang_GetImageColumn(texture, tex_x);
 
-    while (*text)
+    /* Without spans, the whole column is drawn as a single run */
+    const Fang_ImageSpan whole_column = {
+        .start  = 0,
+        .end    = (uint16_t)texture->height,
+        .opaque = false,
+    };
+
+    const Fang_ImageSpan * runs     = &whole_column;
+    uint32_t               num_runs = 1;
+
+    if (texture->spans)
     {
-        char character = *text;
+        runs     = &texture->spans->spans[texture->spans->columns[tex_x]];
+        num_runs = texture->spans->columns[tex_x + 1]
+                 - texture->spans->columns[tex_x];
+    }
 
-        if (character == ' ')
-        {
-            text++;
-            position.x += (int)((FANG_FONT_WIDTH + 1) * ratio);
-            continue;
-        }
+    for (uint32_t i = 0; i < num_runs; ++i)
+    {
+        const Fang_ImageSpan * const run = &runs[i];
+
+        const int run_start = Fang_FindImageRow(
+            source_area,
+            dest_area,
+            flip_y,
+            start_y,
+            end_y,
+            (flip_y) ? run->end : run->start
+        );
 
-        if (character < '!')
-            character = '?';
+        const int run_end = Fang_FindImageRow(
+            source_area,
+            dest_area,
+            flip_y,
+            run_start,
+            end_y,
+            (flip_y) ? run->start : run->end
+        );
 
-        Fang_Rect target_area = {0, 0, 0, 0};
+        for (int y = run_start; y < run_end; ++y)
         {
-            const float pos = (character - (float)'!') / (127.0f - (float)'!');
-
-            const int total_width = (127 - '!') * (FANG_FONT_WIDTH + 1);
+            const int tex_y = Fang_GetImageRow(
+                source_area, dest_area, flip_y, y
+            );
 
-            target_area = (Fang_Rect){
-                .x = (int)(total_width * pos) + 1,
-                .y = 0,
-                .w = FANG_FONT_WIDTH,
-                .h = FANG_FONT_HEIGHT,
-            };
-        }
+            uint32_t pixel = (texels)
+                ? texels[tex_y]
+                : Fang_SamplePixel(texture, tex_x, tex_y);
 
-        Fang_DrawImage(
-            framebuf,
-            font,
-            &target_area,
-            &(Fang_Rect){
-                .x = position.x,
-                .y = position.y,
-                .w = (int)(target_area.w * ratio),
-                .h = (int)(target_area.h * ratio),
+            if (run->opaque)
+            {
+                Fang_SetOpaqueFragment(framebuf, &(Fang_Point){x, y}, pixel);
+                continue;
             }
-        );
 
-        text++;
-        position.x += (int)((FANG_FONT_WIDTH + 1) * ratio);
+            if (!premultiplied)
+                pixel = Fang_PremultiplyPixel(pixel);
+
+            Fang_SetPackedFragment(framebuf, &(Fang_Point){x, y}, pixel);
+        }
     }
 }
 
 /**
- * Draws the skybox of a given map, translated based on the camera's rotation.
+ * Draws the columns of an image (or subsection) which land between start_x and
+ * end_x of the framebuffer, as part of Fang_DrawImageEx().
+ *
+ * Drawing every column of the destination this way gives the same result as
+ * drawing the image in one go.
 **/
 static void
-Fang_DrawMapSkybox(
+Fang_DrawImageColumns(
           Fang_Framebuffer * const framebuf,
-    const Fang_Camera      * const camera,
-    const Fang_Map         * const map,
-    const Fang_Image       * const texture)
+    const Fang_Image       * const image,
+    const Fang_Rect        * const source,
+    const Fang_Rect        * const dest,
+    const bool                     flip_x,
+    const bool                     flip_y,
+    const int                      start_x,
+    const int                      end_x)
 {
     assert(framebuf);
-    assert(camera);
+    assert(framebuf->color.stride == 4 || Fang_DepthInterleaved(framebuf));
 
-    const Fang_Rect viewport = Fang_GetViewport(framebuf);
+    /* If the image is invalid we draw the 'XOR Texture' instead */
+    const Fang_Image * const texture = (Fang_ImageValid(image))
+        ? image
+        : Fang_GetFallbackImage();
 
-    if (!Fang_ImageValid(texture))
-    {
-        Fang_FillRect(
-            framebuf,
-            &(Fang_Rect){
-                .w = viewport.w,
-                .h = viewport.h / 2,
-            },
-            &map->fog
-        );
+    const Fang_Rect image_area = {.w = texture->width, .h = texture->height};
 
-        return;
-    }
+    const Fang_Rect source_area = (source)
+        ? Fang_ClipRect(source, &image_area)
+        : image_area;
 
-    const int pitch = (int)roundf(camera->dir.z * viewport.h);
+    const Fang_Rect framebuf_area = Fang_GetViewport(framebuf);
 
-    const float angle = Fang_Vec2Angle(
-        *(Fang_Vec2*)(&camera->dir),
-        (Fang_Vec2){.x = 0.0f, .y = -1.0f}
-    );
+    const Fang_Rect dest_area = (dest)
+        ? *dest
+        : framebuf_area;
 
-    const float ratio = (angle / ((float)M_PI / 2.0f)) * 2.0f;
+    const Fang_Rect clipped_area = Fang_ClipRect(&dest_area, &framebuf_area);
 
-    const Fang_Rect dest = {
-        .x = (int)(viewport.w * ratio),
-        .y = 0,
-        .w = viewport.w * 4,
-        .h = viewport.h / 2 + pitch,
-    };
+    const int first_x = max(clipped_area.x, start_x);
+    const int last_x  = min(clipped_area.x + clipped_area.w, end_x);
 
-    for (int i = 1; i >= -1; i -= 2)
+    for (int x = first_x; x < last_x; ++x)
     {
-        Fang_DrawImageEx(
+        if (!Fang_ColumnDrawn(framebuf, x))
+            continue;
+
+        Fang_DrawScaledColumn(
             framebuf,
             texture,
-            NULL,
-            &(Fang_Rect){
-                .x = dest.x + (dest.w * i),
-                .y = dest.y,
-                .w = dest.w,
-                .h = dest.h,
-            },
-            true,
-            false
+            &source_area,
+            &dest_area,
+            flip_x,
+            flip_y,
+            x,
+            clipped_area.y,
+            clipped_area.y + clipped_area.h
         );
     }
-
-    Fang_DrawImage(framebuf, texture, NULL, &dest);
 }
 
 /**
- * Draws the floor of a given map, translated based on the camera's position
- * and rotation.
+ * Draws an image (or subsection) to the given area in the framebuffer.
+ *
+ * If the source is NULL, the image size is used with an origin of 0, 0. If the
+ * destination is NULL, the framebuffer color image size is used with an origin
+ * of 0, 0.
+ *
+ * If the sizes of the source and destination rectangles do not match, the image
+ * will be scaled to fit the destination rectangle. This scaling is linear, no
+ * resampling is performed.
+ *
+ * The source image may be flipped in the X or Y direction when being drawn.
+ *
+ * If the image has spans, the transparent runs of each column are skipped and
+ * its opaque runs are drawn without blending.
 **/
 static void
-Fang_DrawMapFloor(
+Fang_DrawImageEx(
           Fang_Framebuffer * const framebuf,
-    const Fang_Camera      * const camera,
-    const Fang_Map         * const map,
-    const Fang_Textures    * const textures)
+    const Fang_Image       * const image,
+    const Fang_Rect        * const source,
+    const Fang_Rect        * const dest,
+    const bool                     flip_x,
+    const bool                     flip_y)
 {
     assert(framebuf);
-    assert(camera);
-    assert(map);
-    assert(textures);
 
     const Fang_Rect viewport = Fang_GetViewport(framebuf);
 
-    if (camera->pos.z <= 0.0f)
-        return;
-
-    /* Calculate vertical offset in screen space */
-    const float pitch  = camera->dir.z * viewport.h;
-    const float height = camera->pos.z * FANG_PROJECTION_RATIO;
-    const int   offset = (int)(pitch + height);
+    Fang_DrawImageColumns(
+        framebuf, image, source, dest, flip_x, flip_y, 0, viewport.w
+    );
+}
 
-    if (height <= 0.0f)
-        return;
+/**
+ * Returns the first row (from the top of the destination) of a scaled image
+ * column which reads the given texel or one below it, clamped to the drawn
+ * rows. Texels are stepped in 16.16 fixed point.
+**/
+static inline int
+Fang_GetColumnRow(
+    const Fang_Rect * const dest,
+    const int32_t           step,
+    const int               texel,
+    const int               start_y,
+    const int               end_y)
+{
+    assert(dest);
 
-    const Fang_Vec2 ray_start = {
-        .x = camera->dir.x + camera->cam.x,
-        .y = camera->dir.y + camera->cam.y,
-    };
+    int64_t rows = 0;
 
-    const Fang_Vec2 ray_end = {
-        .x = camera->dir.x - camera->cam.x,
-        .y = camera->dir.y - camera->cam.y,
-    };
+    if (step > 0)
+        rows = (((int64_t)texel << 16) + step - 1) / step;
+    else if (texel > 0)
+        rows = INT32_MAX;
 
-    for (int y = viewport.h / 2 + offset; y < viewport.h; ++y)
-    {
-        if (y < 0)
-            continue;
+    return (int)clamp((int64_t)dest->y + rows, (int64_t)start_y, (int64_t)end_y);
+}
+
+/**
+ * Draws a run of rows from a single image column, as part of
+ * Fang_DrawImageColumn().
+ *
+ * The texels of opaque runs are written without any blending.
+**/
+static inline void
+Fang_DrawColumnRun(
+          Fang_Framebuffer * const framebuf,
+    const Fang_Image       * const texture,
+    const uint32_t         * const texels,
+    const int                      source_x,
+    const Fang_Rect        * const dest,
+    const int32_t                  step,
+    const int                      start_y,
+    const int                      end_y,
+    const bool                     opaque)
+{
+    assert(framebuf);
+    assert(texture);
+    assert(dest);
+
+    const bool premultiplied = texture->flags & FANG_IMAGEFLAG_PREMULTIPLIED;
+
+    const bool swizzled = (
+        !texels && texture->layout == FANG_IMAGELAYOUT_SWIZZLED
+    );
+
+    /* Swizzled columns have fixed X bits, only the row's bits change */
+    const int column_index = (swizzled)
+        ? Fang_GetSwizzledIndex(source_x, 0, texture->height)
+        : 0;
+
+    int32_t row = (start_y - dest->y) * step;
+
+    for (int y = start_y; y < end_y; ++y, row += step)
+    {
+        uint32_t pixel;
+
+        if (texels)
+        {
+            pixel = texels[row >> 16];
+        }
+        else if (swizzled)
+        {
+            assert(texture->stride == 4);
+
+            pixel = ((const uint32_t*)(const void*)texture->pixels)[
+                column_index | (int)(Fang_SpreadBits((uint32_t)(row >> 16)) << 1)
+            ];
+        }
+        else
+        {
+            pixel = Fang_SamplePixel(texture, source_x, row >> 16);
+        }
+
+        if (opaque)
+        {
+            Fang_SetOpaqueFragment(framebuf, &(Fang_Point){dest->x, y}, pixel);
+            continue;
+        }
+
+        if (!premultiplied)
+            pixel = Fang_PremultiplyPixel(pixel);
+
+        Fang_SetPackedFragment(framebuf, &(Fang_Point){dest->x, y}, pixel);
+    }
+}
+
+/**
+ * Draws a single column of an image, scaled to fit a vertical span of the
+ * framebuffer.
+ *
+ * The destination's width is ignored, only the column at its X position is
+ * drawn. Column-major images are read as a contiguous run of texels, as are
+ * palettized images through the decoded column cache. Swizzled images only
+ * interleave the bits of each row with those of the (fixed) column, while any
+ * other image is read through Fang_SamplePixel(). Invalid images are drawn
+ * using the 'XOR Texture'.
+ *
+ * If the image has spans, the transparent runs of the column are skipped and
+ * its opaque runs are drawn without blending.
+**/
+static void
+Fang_DrawImageColumn(
+          Fang_Framebuffer * const framebuf,
+    const Fang_Image       * const image,
+    const int                      column,
+    const Fang_Rect        * const dest)
+{
+    assert(framebuf);
+    assert(dest);
+
+    const Fang_Rect viewport = Fang_GetViewport(framebuf);
+
+    if (dest->h <= 0 || dest->x < 0 || dest->x >= viewport.w)
+        return;
+
+    const Fang_Image * const texture = (Fang_ImageValid(image))
+        ? image
+        : Fang_GetFallbackImage();
+
+    const int source_x = column % texture->width;
+
+    const int start_y = max(dest->y, 0);
+    const int end_y   = min(dest->y + dest->h, viewport.h);
+
+    /* Texture rows are stepped in 16.16 fixed point */
+    const int32_t step = (int32_t)(((int64_t)texture->height << 16) / dest->h);
+
+    const uint32_t * texels = NULL;
+
+    if (texture->flags & FANG_IMAGEFLAG_PALETTIZED)
+    {
+        texels = Fang_GetImageColumn(texture, source_x);
+    }
+    else if (texture->layout == FANG_IMAGELAYOUT_COLUMNS)
+    {
+        assert(texture->stride == 4);
+        texels = (const uint32_t*)(texture->pixels + source_x * texture->pitch);
+    }
+
+    if (!texture->spans)
+    {
+        Fang_DrawColumnRun(
+            framebuf,
+            texture,
+            texels,
+            source_x,
+            dest,
+            step,
+            start_y,
+            end_y,
+            false
+        );
+
+        return;
+    }
+
+    const Fang_ImageSpans * const spans = texture->spans;
+
+    for (uint32_t i = spans->columns[source_x];
+                  i < spans->columns[source_x + 1];
+                ++i)
+    {
+        const Fang_ImageSpan * const span = &spans->spans[i];
+
+        const int run_start = Fang_GetColumnRow(
+            dest, step, span->start, start_y, end_y
+        );
+
+        if (run_start >= end_y)
+            break;
+
+        const int run_end = Fang_GetColumnRow(
+            dest, step, span->end, start_y, end_y
+        );
+
+        Fang_DrawColumnRun(
+            framebuf,
+            texture,
+            texels,
+            source_x,
+            dest,
+            step,
+            run_start,
+            run_end,
+            span->opaque
+        );
+    }
+}
+
+/**
+ * Shortcut function for Fang_DrawImageEx() without flipping the source image or
+ * providing a shade color.
+**/
+static inline void
+Fang_DrawImage(
+          Fang_Framebuffer * const framebuf,
+    const Fang_Image       * const image,
+    const Fang_Rect        * const source,
+    const Fang_Rect        * const dest)
+{
+    Fang_DrawImageEx(framebuf, image, source, dest, false, false);
+}
+
+/**
+ * Draws an image into the framebuffer at its own size, with its top-left corner
+ * at the given position.
+ *
+ * This gives the same result as Fang_DrawImage() with a destination of the same
+ * size, but is meant for images which are drawn every frame (such as cached
+ * layers). The image must be a premultiplied row-major image, and only the runs
+ * in its spans (if any) are drawn, with opaque runs skipping the blend. When
+ * depth testing is disabled and the framebuffer transform only moves fragments
+ * by whole pixels, the runs are written straight into the color image.
+**/
+static inline void
+Fang_BlitImage(
+          Fang_Framebuffer * const framebuf,
+    const Fang_Image       * const image,
+    const Fang_Point       * const position)
+{
+    assert(framebuf);
+    assert(framebuf->color.stride == 4 || Fang_DepthInterleaved(framebuf));
+    assert(Fang_ImageValid(image));
+    assert(image->stride == 4);
+    assert(image->layout == FANG_IMAGELAYOUT_ROWS);
+    assert(image->flags & FANG_IMAGEFLAG_PREMULTIPLIED);
+    assert(position);
+
+    const Fang_Rect viewport = Fang_GetViewport(framebuf);
+
+    Fang_Point offset = {0, 0};
+
+    const bool direct = !framebuf->state.enable_depth
+                     && Fang_GetFrameOffset(framebuf, &offset);
+
+    int start_x = max(position->x, 0);
+    int end_x   = min(position->x + image->width, viewport.w);
+    int start_y = max(position->y, 0);
+    int end_y   = min(position->y + image->height, viewport.h);
+
+    if (direct)
+    {
+        start_x = max(start_x, -offset.x);
+        end_x   = min(end_x, framebuf->color.width - offset.x);
+        start_y = max(start_y, -offset.y);
+        end_y   = min(end_y, framebuf->color.height - offset.y);
+    }
+
+    /* Neighbouring pixels of a column are a row apart when row-major */
+    const int dest_step = Fang_GetPixelStepY(&framebuf->color) / 4;
+
+    /* Without spans, the whole column is drawn as a single run */
+    const Fang_ImageSpan whole_column = {
+        .start  = 0,
+        .end    = (uint16_t)image->height,
+        .opaque = false,
+    };
+
+    const int step = image->pitch / image->stride;
+
+    for (int x = start_x; x < end_x; ++x)
+    {
+        const int tex_x = x - position->x;
+
+        const Fang_ImageSpan * runs     = &whole_column;
+        uint32_t               num_runs = 1;
+
+        if (image->spans)
+        {
+            runs     = &image->spans->spans[image->spans->columns[tex_x]];
+            num_runs = image->spans->columns[tex_x + 1]
+                     - image->spans->columns[tex_x];
+        }
+
+        const uint32_t * const texels = (const uint32_t*)(
+            image->pixels + tex_x * image->stride
+        );
+
+        uint32_t * const column = (direct)
+            ? (uint32_t*)(
+                framebuf->color.pixels
+              + Fang_GetFragmentOffset(
+                    framebuf, &(Fang_Point){x + offset.x, 0}
+                )
+            )
+            : NULL;
+
+        for (uint32_t i = 0; i < num_runs; ++i)
+        {
+            const Fang_ImageSpan * const run = &runs[i];
+
+            const int run_start = max(position->y + run->start, start_y);
+            const int run_end   = min(position->y + run->end, end_y);
+
+            /* Fragments can't land on each other under a translation, so runs
+               are written straight into the color image
+            */
+            if (direct)
+            {
+                const uint32_t * source = texels
+                                        + (run_start - position->y) * step;
+
+                uint32_t * dest = column + (run_start + offset.y) * dest_step;
+
+                if (run->opaque)
+                {
+                    for (int y = run_start; y < run_end; ++y)
+                    {
+                        *dest   = *source;
+                        dest   += dest_step;
+                        source += step;
+                    }
+                }
+                else
+                {
+                    for (int y = run_start; y < run_end; ++y)
+                    {
+                        *dest   = Fang_BlendPixel(*source, *dest);
+                        dest   += dest_step;
+                        source += step;
+                    }
+                }
+
+                continue;
+            }
+
+            for (int y = run_start; y < run_end; ++y)
+            {
+                const uint32_t pixel = texels[(y - position->y) * step];
+
+                if (run->opaque)
+                    Fang_SetOpaqueFragment(framebuf, &(Fang_Point){x, y}, pixel);
+                else
+                    Fang_SetPackedFragment(framebuf, &(Fang_Point){x, y}, pixel);
+            }
+        }
+    }
+}
+
+/**
+ * Composites the color image of a render target (see Fang_AllocFramebuffer())
+ * into the framebuffer, scaled to cover the given area and faded by the given
+ * opacity, where 255 is fully opaque.
+ *
+ * If no area is given, the target is drawn at its own size in the top-left
+ * corner. Targets drawn at their own size and full opacity are drawn with
+ * Fang_BlitImage(), otherwise each pixel takes the nearest texel of the target.
+ * The framebuffer's transform and depth test are applied as with any other
+ * drawing, so targets can be placed within a viewport (see Fang_SetViewport()).
+**/
+static inline void
+Fang_CompositeFramebuffer(
+          Fang_Framebuffer * const framebuf,
+    const Fang_Framebuffer * const target,
+    const Fang_Rect        * const area,
+    const uint8_t                  opacity)
+{
+    assert(framebuf);
+    assert(framebuf->color.stride == 4 || Fang_DepthInterleaved(framebuf));
+    assert(target);
+    assert(target != framebuf);
+
+    const Fang_Image * const image = &target->color;
+
+    assert(Fang_ImageValid(image));
+    assert(image->stride == 4);
+    assert(image->layout == FANG_IMAGELAYOUT_ROWS);
+    assert(image->flags & FANG_IMAGEFLAG_PREMULTIPLIED);
+
+    const Fang_Rect dest = (area) ? *area : (Fang_Rect){
+        .x = 0,
+        .y = 0,
+        .w = image->width,
+        .h = image->height,
+    };
+
+    if (!opacity || dest.w <= 0 || dest.h <= 0)
+        return;
+
+    if (opacity == UINT8_MAX
+    &&  dest.w  == image->width
+    &&  dest.h  == image->height)
+    {
+        Fang_BlitImage(framebuf, image, &(Fang_Point){dest.x, dest.y});
+        return;
+    }
+
+    const Fang_Rect viewport = Fang_GetViewport(framebuf);
+    const Fang_Rect bounds   = Fang_ClipRect(&dest, &viewport);
+
+    /* Texels are stepped through in 16.16 fixed point */
+    const int64_t step_x = ((int64_t)image->width  << 16) / dest.w;
+    const int64_t step_y = ((int64_t)image->height << 16) / dest.h;
+
+    Fang_Point offset = {0, 0};
+
+    const bool direct = !framebuf->state.enable_depth
+                     && Fang_GetFrameOffset(framebuf, &offset);
+
+    int start_x = bounds.x, end_x = bounds.x + bounds.w;
+    int start_y = bounds.y, end_y = bounds.y + bounds.h;
+
+    if (direct)
+    {
+        start_x = max(start_x, -offset.x);
+        end_x   = min(end_x, framebuf->color.width - offset.x);
+        start_y = max(start_y, -offset.y);
+        end_y   = min(end_y, framebuf->color.height - offset.y);
+    }
+
+    /* Neighbouring pixels of a row are a column apart when column-major */
+    const int row_step = Fang_GetPixelStepX(&framebuf->color) / 4;
+
+    for (int y = start_y; y < end_y; ++y)
+    {
+        const int tex_y = (int)(((int64_t)(y - dest.y) * step_y) >> 16);
+
+        const uint32_t * const texels = (const uint32_t*)(
+            image->pixels + tex_y * image->pitch
+        );
+
+        uint32_t * const row = (direct && start_x < end_x)
+            ? (uint32_t*)(
+                framebuf->color.pixels
+              + Fang_GetFragmentOffset(
+                    framebuf, &(Fang_Point){start_x + offset.x, y + offset.y}
+                )
+              )
+            : NULL;
+
+        for (int x = start_x; x < end_x; ++x)
+        {
+            const int tex_x = (int)(((int64_t)(x - dest.x) * step_x) >> 16);
+
+            uint32_t pixel = texels[tex_x];
+
+            if (opacity != UINT8_MAX)
+                pixel = Fang_FadePixel(pixel, opacity);
+
+            if (!direct)
+            {
+                Fang_SetPackedFragment(framebuf, &(Fang_Point){x, y}, pixel);
+                continue;
+            }
+
+            const uint32_t alpha = pixel & 0xFF;
+
+            uint32_t * const dest_pixel = &row[(x - start_x) * row_step];
+
+            if (alpha == UINT8_MAX)
+                *dest_pixel = pixel;
+            else if (alpha)
+                *dest_pixel = Fang_BlendPixel(pixel, *dest_pixel);
+        }
+    }
+}
+
+/**
+ * Measures the area covered by a line of text of the given height, without
+ * drawing it.
+**/
+static inline Fang_Rect
+Fang_MeasureText(
+    const char * const text,
+    const int          fontheight)
+{
+    assert(text);
+
+    const float ratio = (float)fontheight / (float)FANG_FONT_HEIGHT;
+
+    return (Fang_Rect){
+        .w = Fang_GetFontAdvance(fontheight) * (int)strlen(text),
+        .h = (int)(FANG_FONT_HEIGHT * ratio),
+    };
+}
+
+/**
+ * Draws a cached glyph into the framebuffer, a run of texels at a time.
+ *
+ * Columns are drawn from left to right (and top to bottom) in the same order
+ * as Fang_DrawImageEx(), so that the result is the same under a viewport.
+**/
+static inline void
+Fang_DrawGlyph(
+          Fang_Framebuffer * const framebuf,
+    const Fang_GlyphSet    * const glyphs,
+    const int                      index,
+    const Fang_Point       * const position)
+{
+    assert(framebuf);
+    assert(framebuf->color.stride == 4 || Fang_DepthInterleaved(framebuf));
+    assert(glyphs);
+    assert(index >= 0 && index < FANG_GLYPH_COUNT);
+    assert(position);
+
+    const Fang_Rect viewport = Fang_GetViewport(framebuf);
+
+    const uint32_t * const texels = glyphs->texels + (size_t)index
+                                  * (size_t)glyphs->glyph_width
+                                  * (size_t)glyphs->glyph_height;
+
+    /* Without depth testing or scaling, runs are written directly into the
+       color image
+    */
+    Fang_Point offset = {0, 0};
+
+    const bool direct = !framebuf->state.enable_depth
+                     && Fang_GetFrameOffset(framebuf, &offset);
+
+    for (uint32_t i = glyphs->glyphs[index]; i < glyphs->glyphs[index + 1]; ++i)
+    {
+        const Fang_GlyphRun * const run = &glyphs->runs[i];
+
+        const int x = position->x + run->x;
+
+        if (x < 0 || x >= viewport.w)
+            continue;
+
+        const int run_y   = position->y + run->y;
+        const int start_y = max(run_y, 0);
+        const int end_y   = min(run_y + run->length, viewport.h);
+
+        const uint32_t * const run_texels = texels
+                                          + run->x * glyphs->glyph_height
+                                          + run->y;
+
+        if (direct)
+        {
+            Fang_SetFragmentRun(
+                framebuf,
+                &(Fang_Point){x + offset.x, start_y + offset.y},
+                run_texels + (start_y - run_y),
+                1,
+                end_y - start_y,
+                run->opaque
+            );
+
+            continue;
+        }
+
+        for (int y = start_y; y < end_y; ++y)
+        {
+            const uint32_t pixel = run_texels[y - run_y];
+
+            if (run->opaque)
+                Fang_SetOpaqueFragment(framebuf, &(Fang_Point){x, y}, pixel);
+            else
+                Fang_SetPackedFragment(framebuf, &(Fang_Point){x, y}, pixel);
+        }
+    }
+}
+
+/**
+ * Draws a line of text into the framebuffer using the given font type.
+ *
+ * Glyphs are drawn from the glyph cache once they have been scaled to the font
+ * height, or directly from the font if they could not be cached.
+ *
+ * Nothing is drawn if the font is not available (such as while it is still
+ * loading), as the 'XOR Texture' has no glyphs to stand in for it.
+**/
+static void
+Fang_DrawText(
+          Fang_Framebuffer * const framebuf,
+    const char             *       text,
+    const Fang_Image       * const font,
+    const int                      fontheight,
+    const Fang_Point       * const origin)
+{
+    assert(framebuf);
+    assert(text);
+
+    if (!Fang_ImageValid(font))
+        return;
+
+    Fang_Point position = (origin) ? *origin : (Fang_Point){0, 0};
+
+    const Fang_GlyphSet * const glyphs = Fang_GetGlyphs(font, fontheight);
+
+    const float ratio   = (float)fontheight / (float)FANG_FONT_HEIGHT;
+    const int   advance = Fang_GetFontAdvance(fontheight);
+
+    for (; *text; ++text, position.x += advance)
+    {
+        if (*text == ' ')
+            continue;
+
+        if (glyphs)
+        {
+            Fang_DrawGlyph(
+                framebuf, glyphs, Fang_GetGlyphIndex(*text), &position
+            );
+
+            continue;
+        }
+
+        const Fang_Rect target_area = Fang_GetGlyphArea(*text);
+
+        Fang_DrawImage(
+            framebuf,
+            font,
+            &target_area,
+            &(Fang_Rect){
+                .x = position.x,
+                .y = position.y,
+                .w = (int)(target_area.w * ratio),
+                .h = (int)(target_area.h * ratio),
+            }
+        );
+    }
+}
+
+/**
+ * Returns the area of the framebuffer which the skybox is drawn to for a given
+ * camera, before being repeated to either side (see Fang_DrawMapSkybox()).
+**/
+static inline Fang_Rect
+Fang_GetSkyboxRect(
+    const Fang_Camera * const camera,
+    const Fang_Rect   * const viewport)
+{
+    assert(camera);
+    assert(viewport);
+
+    const int pitch = (int)roundf(camera->dir.z * viewport->h);
+
+    const float angle = Fang_Vec2Angle(
+        *(Fang_Vec2*)(&camera->dir),
+        (Fang_Vec2){.x = 0.0f, .y = -1.0f}
+    );
+
+    const float ratio = (angle / ((float)M_PI / 2.0f)) * 2.0f;
+
+    return (Fang_Rect){
+        .x = (int)(viewport->w * ratio),
+        .y = 0,
+        .w = viewport->w * 4,
+        .h = viewport->h / 2 + pitch,
+    };
+}
+
+/**
+ * Draws the columns between start_x and end_x of the skybox of a given map,
+ * translated based on the camera's rotation.
+**/
+static void
+Fang_DrawMapSkybox(
+          Fang_Framebuffer * const framebuf,
+    const Fang_Camera      * const camera,
+    const Fang_Map         * const map,
+    const Fang_Image       * const texture,
+    const int                      start_x,
+    const int                      end_x)
+{
+    assert(framebuf);
+    assert(camera);
+
+    const Fang_Rect viewport = Fang_GetViewport(framebuf);
+
+    if (!Fang_ImageValid(texture))
+    {
+        Fang_FillRect(
+            framebuf,
+            &(Fang_Rect){
+                .x = start_x,
+                .w = end_x - start_x,
+                .h = viewport.h / 2,
+            },
+            &map->fog
+        );
+
+        return;
+    }
+
+    const Fang_Rect dest = Fang_GetSkyboxRect(camera, &viewport);
+
+    for (int i = 1; i >= -1; i -= 2)
+    {
+        Fang_DrawImageColumns(
+            framebuf,
+            texture,
+            NULL,
+            &(Fang_Rect){
+                .x = dest.x + (dest.w * i),
+                .y = dest.y,
+                .w = dest.w,
+                .h = dest.h,
+            },
+            true,
+            false,
+            start_x,
+            end_x
+        );
+    }
+
+    Fang_DrawImageColumns(
+        framebuf, texture, NULL, &dest, false, false, start_x, end_x
+    );
+}
+
+/**
+ * Finds how each row of the framebuffer sees the floor, translated based on the
+ * camera's position and rotation. The rows array must hold one row for each row
+ * of the framebuffer.
+**/
+static void
+Fang_GetFloorRows(
+          Fang_Framebuffer * const framebuf,
+    const Fang_Camera      * const camera,
+          Fang_FloorRow    * const rows)
+{
+    assert(framebuf);
+    assert(camera);
+    assert(rows);
+
+    const Fang_Rect viewport = Fang_GetViewport(framebuf);
+
+    for (int y = 0; y < viewport.h; ++y)
+        rows[y].visible = false;
+
+    if (camera->pos.z <= 0.0f)
+        return;
+
+    /* Calculate vertical offset in screen space */
+    const float pitch  = camera->dir.z * viewport.h;
+    const float height = camera->pos.z * FANG_PROJECTION_RATIO;
+    const int   offset = (int)(pitch + height);
+
+    if (height <= 0.0f)
+        return;
+
+    const Fang_Vec2 ray_start = {
+        .x = camera->dir.x + camera->cam.x,
+        .y = camera->dir.y + camera->cam.y,
+    };
+
+    const Fang_Vec2 ray_end = {
+        .x = camera->dir.x - camera->cam.x,
+        .y = camera->dir.y - camera->cam.y,
+    };
+
+    for (int y = viewport.h / 2 + offset; y < viewport.h; ++y)
+    {
+        if (y < 0)
+            continue;
 
         /* Vertical position in screen space shifted by our height/pitch */
         const int p = (int)(y - (viewport.h / 2) - offset);
@@ -449,91 +1347,531 @@ Fang_DrawMapFloor(
         /* Calculate row distance, based on perspective at our given height */
         const float row_dist = ((viewport.h / 2.0f) / p) * height;
 
-        framebuf->state.current_depth = row_dist * FANG_PROJECTION_RATIO
-                                      + (1.0f - camera->dir.z);
+        Fang_FloorRow * const row = &rows[y];
 
-        const Fang_Vec2 floor_step = {
+        row->depth = row_dist * FANG_PROJECTION_RATIO + (1.0f - camera->dir.z);
+
+        row->step = (Fang_Vec2){
             .x = row_dist * (ray_end.x - ray_start.x) / viewport.w,
             .y = row_dist * (ray_end.y - ray_start.y) / viewport.w,
         };
 
-        Fang_Vec2 floor_pos = {
+        row->pos = (Fang_Vec2){
             .x = (camera->pos.x / 2.0f) + row_dist * ray_start.x,
             .y = (camera->pos.y / 2.0f) + row_dist * ray_start.y,
         };
 
-        for (int x = 0; x < viewport.w; ++x)
+        row->pixel_size = Fang_Vec2Norm(row->step);
+        row->visible    = true;
+    }
+}
+
+/**
+ * Allocates the texels of a visibility buffer for the given framebuffer, with
+ * no texels recorded. The visibility buffer must not already hold any texels.
+ *
+ * Returns non-zero if the texels could not be allocated, in which case the
+ * visibility buffer is left empty.
+**/
+static inline int
+Fang_AllocVisibilityBuffer(
+          Fang_VisibilityBuffer * const visibility,
+    const Fang_Framebuffer      * const framebuf)
+{
+    assert(visibility);
+    assert(!visibility->texels);
+    assert(framebuf);
+    assert(Fang_ImageValid(&framebuf->color));
+
+    const Fang_Image * const color = &framebuf->color;
+
+    const int lines = (color->layout == FANG_IMAGELAYOUT_COLUMNS)
+        ? color->width
+        : color->height;
+
+    memset(visibility, 0, sizeof(Fang_VisibilityBuffer));
+
+    visibility->size   = (size_t)(color->pitch / color->stride * lines);
+    visibility->step_x = Fang_GetPixelStepX(color) / color->stride;
+    visibility->step_y = Fang_GetPixelStepY(color) / color->stride;
+    visibility->texels = calloc(visibility->size, sizeof(Fang_VisibleTexel));
+
+    if (!visibility->texels)
+    {
+        memset(visibility, 0, sizeof(Fang_VisibilityBuffer));
+        return 1;
+    }
+
+    return 0;
+}
+
+/**
+ * Frees the texels of a visibility buffer.
+**/
+static inline void
+Fang_FreeVisibilityBuffer(
+    Fang_VisibilityBuffer * const visibility)
+{
+    assert(visibility);
+
+    free(visibility->texels);
+    memset(visibility, 0, sizeof(Fang_VisibilityBuffer));
+}
+
+/**
+ * Returns the surface which refers to an opaque image, adding it to the
+ * visibility buffer's surfaces if it isn't one already.
+**/
+static inline uint16_t
+Fang_AddVisibleSurface(
+          Fang_VisibilityBuffer * const visibility,
+    const Fang_Image            * const image)
+{
+    assert(visibility);
+    assert(Fang_ImageValid(image));
+    assert(Fang_ImageOpaque(image));
+    assert(image->width  <= UINT16_MAX);
+    assert(image->height <= UINT16_MAX);
+
+    /* The surface added last is the most likely to be added again */
+    for (int i = visibility->surface_count; i-- > 0;)
+    {
+        if (visibility->surfaces[i] == image)
+            return (uint16_t)(i + 1);
+    }
+
+    assert(visibility->surface_count < FANG_MAX_SURFACES);
+
+    visibility->surfaces[visibility->surface_count++] = image;
+    return (uint16_t)visibility->surface_count;
+}
+
+/**
+ * Records the texel of a surface seen through a point of the framebuffer.
+ *
+ * The fragment is depth tested in the same way as Fang_SetOpaqueFragment(),
+ * and writes its depth if it passes, but only its texel is kept. The color is
+ * written once the texel is resolved (see Fang_ResolveVisibility()). The
+ * framebuffer's transform is not applied, as the world is drawn without one.
+**/
+static inline void
+Fang_SetVisibleTexel(
+    const Fang_Framebuffer      * const framebuf,
+          Fang_VisibilityBuffer * const visibility,
+    const Fang_Point            * const point,
+    const uint16_t                      surface,
+    const int                           x,
+    const int                           y)
+{
+    assert(framebuf);
+    assert(framebuf->state.enable_depth);
+    assert(Fang_ImageValid(&framebuf->depth));
+    assert(visibility);
+    assert(visibility->texels);
+    assert(point);
+    assert(surface && surface <= visibility->surface_count);
+
+    const int offset = Fang_GetFragmentOffset(framebuf, point);
+
+    float * const depth = (float*)(framebuf->depth.pixels + offset);
+
+    if (*depth < framebuf->state.current_depth)
+        return;
+
+    *depth = framebuf->state.current_depth;
+
+    const size_t index = (size_t)(
+        point->x * visibility->step_x + point->y * visibility->step_y
+    );
+
+    assert(index < visibility->size);
+
+    visibility->texels[index] = (Fang_VisibleTexel){
+        .surface = surface,
+        .x       = (uint16_t)x,
+        .y       = (uint16_t)y,
+    };
+}
+
+/**
+ * Records the texels of a single column of an opaque image, scaled to fit a
+ * vertical span of the framebuffer. The texels are those which
+ * Fang_DrawImageColumn() would draw.
+**/
+static void
+Fang_RecordImageColumn(
+    const Fang_Framebuffer      * const framebuf,
+          Fang_VisibilityBuffer * const visibility,
+    const Fang_Image            * const image,
+    const int                           column,
+    const Fang_Rect             * const dest)
+{
+    assert(framebuf);
+    assert(visibility);
+    assert(Fang_ImageValid(image));
+    assert(Fang_ImageOpaque(image));
+    assert(dest);
+
+    const int width  = framebuf->color.width;
+    const int height = framebuf->color.height;
+
+    if (dest->h <= 0 || dest->x < 0 || dest->x >= width)
+        return;
+
+    const uint16_t surface = Fang_AddVisibleSurface(visibility, image);
+
+    const int source_x = column % image->width;
+
+    const int start_y = max(dest->y, 0);
+    const int end_y   = min(dest->y + dest->h, height);
+
+    /* Texture rows are stepped in 16.16 fixed point */
+    const int32_t step = (int32_t)(((int64_t)image->height << 16) / dest->h);
+
+    int32_t row = (start_y - dest->y) * step;
+
+    for (int y = start_y; y < end_y; ++y, row += step)
+    {
+        Fang_SetVisibleTexel(
+            framebuf,
+            visibility,
+            &(Fang_Point){dest->x, y},
+            surface,
+            source_x,
+            row >> 16
+        );
+    }
+}
+
+/**
+ * Writes the color of every texel recorded in the columns between start_x and
+ * end_x of the framebuffer, leaving those pixels without a recorded texel.
+ *
+ * Each pixel's texel is read once, after every surface has been recorded, and
+ * is cleared once written. The surfaces are then forgotten, so the next pass
+ * of recorded texels can't refer to any of the current ones.
+**/
+static void
+Fang_ResolveVisibility(
+          Fang_Framebuffer      * const framebuf,
+          Fang_VisibilityBuffer * const visibility,
+    const int                           start_x,
+    const int                           end_x)
+{
+    assert(framebuf);
+    assert(Fang_ImageValid(&framebuf->color));
+    assert(visibility);
+    assert(visibility->texels);
+    assert(start_x >= 0);
+    assert(end_x <= framebuf->color.width);
+
+    if (!visibility->surface_count)
+        return;
+
+    /* Pixels are visited in memory order, along each row (or column) */
+    const bool columns = framebuf->color.layout == FANG_IMAGELAYOUT_COLUMNS;
+
+    const int step_x = Fang_GetPixelStepX(&framebuf->color);
+    const int step_y = Fang_GetPixelStepY(&framebuf->color);
+
+    const int lines  = (columns) ? end_x - start_x : framebuf->color.height;
+    const int length = (columns) ? framebuf->color.height : end_x - start_x;
+
+    const int line_step  = (columns) ? step_x : step_y;
+    const int pixel_step = (columns) ? step_y : step_x;
+
+    const int texel_line_step = (columns)
+        ? visibility->step_x
+        : visibility->step_y;
+
+    const int texel_step = (columns)
+        ? visibility->step_y
+        : visibility->step_x;
+
+    /* The texels of each surface are addressed in the same way, so that is
+       only worked out when the surface changes
+    */
+    uint16_t           surface  = 0;
+    const Fang_Image * image    = NULL;
+    bool               swizzled = false;
+    int                image_x  = 0;
+    int                image_y  = 0;
+
+    for (int i = 0; i < lines; ++i)
+    {
+        Fang_VisibleTexel * const texels = &visibility->texels[
+            start_x * visibility->step_x + i * texel_line_step
+        ];
+
+        uint8_t * const pixels = framebuf->color.pixels + start_x * step_x
+                                                        + i * line_step;
+
+        for (int j = 0; j < length; ++j)
+        {
+            Fang_VisibleTexel * const texel = &texels[j * texel_step];
+
+            if (!texel->surface)
+                continue;
+
+            if (texel->surface != surface)
+            {
+                assert(texel->surface <= visibility->surface_count);
+
+                surface  = texel->surface;
+                image    = visibility->surfaces[surface - 1];
+                swizzled = image->layout == FANG_IMAGELAYOUT_SWIZZLED;
+
+                if (!swizzled)
+                {
+                    image_x = Fang_GetPixelStepX(image);
+                    image_y = Fang_GetPixelStepY(image);
+                }
+            }
+
+            const int offset = (swizzled)
+                ? Fang_GetSwizzledIndex(texel->x, texel->y, image->height)
+                    * image->stride
+                : texel->x * image_x + texel->y * image_y;
+
+            const uint32_t pixel = (image->flags & FANG_IMAGEFLAG_PALETTIZED)
+                ? image->palette[image->pixels[offset]]
+                : *(const uint32_t*)(const void*)(image->pixels + offset);
+
+            /* Surfaces are opaque, so their texels are never blended */
+            *(uint32_t*)(pixels + j * pixel_step) = pixel;
+
+            texel->surface = 0;
+        }
+    }
+
+    visibility->surface_count = 0;
+}
+
+/**
+ * Returns the fractional part of a map coordinate, which is where it falls
+ * within its tile.
+ *
+ * Negative coordinates wrap around in the same way as positive ones, so every
+ * surface repeats its texture on both sides of the map's origin.
+**/
+static inline float
+Fang_WrapMapCoord(
+    const float coord)
+{
+    return coord - floorf(coord);
+}
+
+/**
+ * Draws the columns between start_x and end_x of the floor of a given map,
+ * from the rows found with Fang_GetFloorRows().
+ *
+ * Each row's position is moved past the drawn columns, so the floor must be
+ * drawn from left to right, with each call starting where the last one ended.
+ *
+ * If a visibility buffer is given, the texels of opaque floors are recorded
+ * into it instead of being drawn (see Fang_VisibilityBuffer).
+**/
+static void
+Fang_DrawMapFloor(
+          Fang_Framebuffer      * const framebuf,
+    const Fang_Map              * const map,
+    const Fang_Textures         * const textures,
+          Fang_FloorRow         * const rows,
+          Fang_VisibilityBuffer * const visibility,
+    const int                           start_x,
+    const int                           end_x)
+{
+    assert(framebuf);
+    assert(map);
+    assert(textures);
+    assert(rows);
+
+    const Fang_Rect viewport = Fang_GetViewport(framebuf);
+
+    for (int y = 0; y < viewport.h; ++y)
+    {
+        Fang_FloorRow * const row = &rows[y];
+
+        if (!row->visible)
+            continue;
+
+        framebuf->state.current_depth = row->depth;
+
+        const Fang_Vec2 floor_step = row->step;
+              Fang_Vec2 floor_pos  = row->pos;
+
+        /* The floor distance covered by each pixel selects the mipmap level */
+        const float pixel_size = row->pixel_size;
+
+        Fang_TextureId     texture_id = FANG_TEXTURE_NONE;
+        const Fang_Image * texture    = NULL;
+        bool               swizzled   = false;
+        uint16_t           surface    = 0;
+
+        for (int x = start_x; x < end_x; ++x)
         {
+            /* Skipped columns still move the row along */
+            if (!Fang_ColumnDrawn(framebuf, x))
+            {
+                floor_pos.x += floor_step.x;
+                floor_pos.y += floor_step.y;
+                continue;
+            }
+
             const Fang_Chunk * const chunk = Fang_GetChunk(
                 &map->chunks, &floor_pos
             );
 
             assert(chunk);
 
-            const Fang_Image * const texture = Fang_GetTexture(
-                textures, chunk->floor
-            );
+            if (chunk->floor != texture_id)
+            {
+                texture_id = chunk->floor;
+                texture    = Fang_GetTexture(textures, texture_id);
 
-            if (!texture)
-                continue;
+                if (texture)
+                {
+                    texture = Fang_GetTextureLevel(
+                        textures,
+                        texture_id,
+                        Fang_GetMipmapLevel(pixel_size * (float)texture->width)
+                    );
+                }
+                else if (texture_id != FANG_TEXTURE_NONE)
+                {
+                    /* Floors still loading are drawn with the 'XOR Texture' */
+                    texture = Fang_GetFallbackImage();
+                }
 
-            const int texture_width  = (texture) ? texture->width  : 32;
-            const int texture_height = (texture) ? texture->height : 32;
+                swizzled = (
+                    texture && texture->layout == FANG_IMAGELAYOUT_SWIZZLED
+                );
 
-            Fang_Point tex_pos = {
-                .x = (int)roundf(
-                    texture_width * (floor_pos.x - floorf(floor_pos.x))
-                ),
-                .y = (int)roundf(
-                    texture_height * (floor_pos.y - floorf(floor_pos.y))
-                ),
-            };
+                surface = (visibility && texture && Fang_ImageOpaque(texture))
+                    ? Fang_AddVisibleSurface(visibility, texture)
+                    : 0;
+            }
 
-            tex_pos.x &= (texture_width  - 1);
-            tex_pos.y &= (texture_height - 1);
+            if (texture)
+            {
+                Fang_Point tex_pos = {
+                    .x = (int)roundf(
+                        texture->width * Fang_WrapMapCoord(floor_pos.x)
+                    ),
+                    .y = (int)roundf(
+                        texture->height * Fang_WrapMapCoord(floor_pos.y)
+                    ),
+                };
+
+                tex_pos.x &= (texture->width  - 1);
+                tex_pos.y &= (texture->height - 1);
+
+                if (surface)
+                {
+                    Fang_SetVisibleTexel(
+                        framebuf,
+                        visibility,
+                        &(Fang_Point){x, y},
+                        surface,
+                        tex_pos.x,
+                        tex_pos.y
+                    );
+                }
+                else
+                {
+                    uint32_t pixel = (swizzled)
+                        ? Fang_SampleSwizzledPixel(
+                            texture, tex_pos.x, tex_pos.y
+                        )
+                        : Fang_SamplePixel(texture, tex_pos.x, tex_pos.y);
 
-            const Fang_Color dest_color = Fang_GetPixel(texture, &tex_pos);
+                    if (!(texture->flags & FANG_IMAGEFLAG_PREMULTIPLIED))
+                        pixel = Fang_PremultiplyPixel(pixel);
 
-            Fang_SetFragment(
-                framebuf,
-                &(Fang_Point){x, y},
-                &dest_color
-            );
+                    Fang_SetPackedFragment(
+                        framebuf, &(Fang_Point){x, y}, pixel
+                    );
+                }
+            }
 
             floor_pos.x += floor_step.x;
             floor_pos.y += floor_step.y;
         }
+
+        row->pos = floor_pos;
     }
 }
 
+/**
+ * The tiles drawn by Fang_DrawMapTiles().
+ *
+ * Deferred frames record the texels of opaque tiles into a visibility buffer,
+ * and draw translucent tiles once those texels have been resolved, so that
+ * translucent tiles are blended over the opaque tiles behind them.
+**/
+typedef enum Fang_TilePass {
+    FANG_TILEPASS_ALL,
+    FANG_TILEPASS_OPAQUE,
+    FANG_TILEPASS_TRANSLUCENT,
+} Fang_TilePass;
+
 /**
  * Draws the results of a raycast against map tiles.
  *
  * The provided camera should be the starting point of the rays, and is used to
  * project the viewable map tiles into the framebuffer viewport.
+ *
+ * The tops and bottoms of tiles are textured with the perspective quality
+ * given in the render settings.
+ *
+ * If occluders are given (one per ray), the nearest opaque front face drawn in
+ * each column is recorded for clipping sprites with Fang_DrawSprites(). The
+ * occluders are left as they are when only translucent tiles are drawn.
+ *
+ * When only opaque tiles are drawn, their texels are recorded into the given
+ * visibility buffer instead (see Fang_VisibilityBuffer).
+ *
+ * Only the columns between start_x and end_x are drawn, each column being drawn
+ * from the ray of the same index.
 **/
 static void
 Fang_DrawMapTiles(
-          Fang_Framebuffer * const framebuf,
-    const Fang_Camera      * const camera,
-    const Fang_Textures    * const textures,
-          Fang_Map         * const map,
-    const Fang_Ray         * const rays,
-    const size_t                   count)
+          Fang_Framebuffer      * const framebuf,
+    const Fang_RenderSettings   * const settings,
+    const Fang_Camera           * const camera,
+    const Fang_Textures         * const textures,
+          Fang_Map              * const map,
+    const Fang_Ray              * const rays,
+          Fang_ColumnOccluder   * const occluders,
+          Fang_VisibilityBuffer * const visibility,
+    const Fang_TilePass                 pass,
+    const size_t                        count,
+    const int                           start_x,
+    const int                           end_x)
 {
     assert(framebuf);
+    assert(settings);
     assert(camera);
     assert(textures);
     assert(map);
     assert(rays);
+    assert(visibility || pass != FANG_TILEPASS_OPAQUE);
     assert(count);
+    assert(start_x >= 0);
+    assert(end_x <= (int)count);
 
     const Fang_Rect viewport = Fang_GetViewport(framebuf);
 
-    for (size_t i = 0; i < count; ++i)
+    for (size_t i = (size_t)start_x; i < (size_t)end_x; ++i)
     {
         const Fang_Ray * const ray = &rays[i];
 
+        if (occluders && pass != FANG_TILEPASS_TRANSLUCENT)
+            occluders[i] = (Fang_ColumnOccluder){.depth = FLT_MAX};
+
+        if (!Fang_ColumnDrawn(framebuf, (int)i))
+            continue;
+
         for (size_t j = ray->hit_count; j-- > 0;)
         {
             const Fang_RayHit * const hit = &ray->hits[j];
@@ -544,15 +1882,50 @@ Fang_DrawMapTiles(
             if (hit->front_dist > map->fog_distance)
                 continue;
 
-            const Fang_Image * const wall_tex = Fang_GetTexture(
-                textures, hit->tile->texture
+            /* Select the mipmap level from the size of the front face, tiles
+               without a texture are drawn with the 'XOR Texture'
+            */
+            const Fang_Image * wall_tex = Fang_GetTextureLevel(
+                textures,
+                hit->tile->texture,
+                Fang_GetMipmapLevel(
+                    (FANG_TEXTURE_SIZE * hit->front_dist)
+                  / (FANG_PROJECTION_RATIO * (float)viewport.h)
+                )
+            );
+
+            if (!wall_tex)
+                wall_tex = Fang_GetFallbackImage();
+
+            /* Tile textures are strips of square faces */
+            const int face_size = wall_tex->height;
+            const bool has_faces = wall_tex->width >= face_size * 6;
+
+            const bool premultiplied = (
+                wall_tex->flags & FANG_IMAGEFLAG_PREMULTIPLIED
+            );
+
+            const bool swizzled = (
+                wall_tex->layout == FANG_IMAGELAYOUT_SWIZZLED
             );
 
-            Fang_Rect front_face;
-            Fang_Rect  back_face;
+            /* Back faces only show through tiles that aren't opaque */
+            const bool draw_back_face = !Fang_ImageOpaque(wall_tex);
+
+            /* Deferred frames draw opaque and translucent tiles separately */
+            if ((pass == FANG_TILEPASS_OPAQUE      &&  draw_back_face)
+            ||  (pass == FANG_TILEPASS_TRANSLUCENT && !draw_back_face))
+                continue;
+
+            const uint16_t surface = (pass == FANG_TILEPASS_OPAQUE)
+                ? Fang_AddVisibleSurface(visibility, wall_tex)
+                : 0;
 
-            /* Calculate and draw front and back faces of tile */
-            for (size_t k = 0; k < 2; ++k)
+            Fang_Rect front_face = {0, 0, 0, 0};
+            Fang_Rect  back_face = {0, 0, 0, 0};
+
+            /* Calculate and draw back and front faces of tile, back to front */
+            for (size_t k = 2; k-- > 0;)
             {
                 const float face_dist = (k == 0)
                     ? hit->front_dist
@@ -583,42 +1956,55 @@ Fang_DrawMapTiles(
                 if (dest_rect.y + dest_rect.h <= 0)
                     continue;
 
-                /* NOTE: Cull backfaces until transparent texture support */
-                if (k == 1)
+                if (k == 1 && !draw_back_face)
                     continue;
 
                 const Fang_Vec2 face_hit = (k == 0)
                     ? hit->front_hit
                     : hit->back_hit;
 
-                const Fang_Face face = hit->norm_dir;
+                const Fang_Face face = (k == 0)
+                    ? hit->norm_dir
+                    : hit->back_dir;
 
-                float tex_x =
+                float tex_x = Fang_WrapMapCoord(
                     (face == FANG_FACE_NORTH || face == FANG_FACE_SOUTH)
-                        ? fmodf(face_hit.x, 1.0f)
-                        : fmodf(face_hit.y, 1.0f);
-
-                tex_x = clamp(tex_x, 0.0f, 1.0f);
+                        ? face_hit.x
+                        : face_hit.y
+                );
 
                 if (face == FANG_FACE_EAST || face == FANG_FACE_NORTH)
                     tex_x = 1.0f - tex_x;
 
+                /* Hits are drawn back to front, so the last opaque front
+                   face recorded is the nearest one
+                */
+                if (occluders && k == 0 && !draw_back_face)
+                {
+                    occluders[i] = (Fang_ColumnOccluder){
+                        .depth  = face_dist,
+                        .top    = max(dest_rect.y, 0),
+                        .bottom = min(dest_rect.y + dest_rect.h, viewport.h),
+                    };
+                }
+
                 framebuf->state.current_depth = face_dist;
 
-                Fang_DrawImageEx(
-                    framebuf,
-                    wall_tex,
-                    &(Fang_Rect){
-                        .x = (int)floorf(tex_x * (FANG_TEXTURE_SIZE - 1))
-                           + (int)      (face  * (FANG_TEXTURE_SIZE - 1)),
-                        .y = 0,
-                        .w = 1,
-                        .h = FANG_TEXTURE_SIZE,
-                    },
-                    &dest_rect,
-                    false,
-                    false
-                );
+                const int column = (int)floorf(tex_x * (float)(face_size - 1))
+                                 + ((has_faces) ? (int)face * face_size : 0);
+
+                if (surface)
+                {
+                    Fang_RecordImageColumn(
+                        framebuf, visibility, wall_tex, column, &dest_rect
+                    );
+                }
+                else
+                {
+                    Fang_DrawImageColumn(
+                        framebuf, wall_tex, column, &dest_rect
+                    );
+                }
             }
 
             /* Draw top or bottom of tile based on front/back faces */
@@ -674,58 +2060,120 @@ Fang_DrawMapTiles(
                 if (start_y >= viewport.h)
                     continue;
 
-                for (int y = start_y; y < end_y; ++y)
-                {
-                    if (y < 0 || y >= viewport.h)
-                        continue;
-
-                    const float r_y = (float)(y - start_y)
-                                    / (float)(end_y - start_y);
+                const int first_y = max(start_y, 0);
+                const int last_y  = min(end_y, viewport.h);
+
+                /* Texture coordinates are not linear in screen space, but
+                   their quotients with the distance (and the inverse of the
+                   distance itself) are. These are stepped per pixel and then
+                   divided back out to get perspective-correct coordinates.
+                */
+                const float span = (float)(end_y - start_y);
+
+                const Fang_Vec3 attr_start = {
+                    .x = hit_start.x / dist_start,
+                    .y = hit_start.y / dist_start,
+                    .z = 1.0f        / dist_start,
+                };
+
+                const Fang_Vec3 attr_step = {
+                    .x = ((hit_end.x / dist_end) - attr_start.x) / span,
+                    .y = ((hit_end.y / dist_end) - attr_start.y) / span,
+                    .z = ((1.0f      / dist_end) - attr_start.z) / span,
+                };
+
+                const float dist_step = (dist_end - dist_start) / span;
+
+                Fang_Vec3 attr = Fang_Vec3Add(
+                    attr_start,
+                    Fang_Vec3Multf(attr_step, (float)(first_y - start_y))
+                );
 
-                    Fang_Point tex_pos;
-                    {
-                        float u = ((1.0f - r_y) * (hit_start.x / dist_start))
-                                + (r_y * (hit_end.x / dist_end));
+                float dist = dist_start + dist_step * (float)(first_y - start_y);
 
-                              u /= ((1.0f - r_y) * (1.0f / dist_start))
-                                + (r_y * (1.0f / dist_end));
+                Fang_Vec2 tex_coord = {
+                    .x = attr.x / attr.z,
+                    .y = attr.y / attr.z,
+                };
 
-                        float v = ((1.0f - r_y) * (hit_start.y / dist_start))
-                                + (r_y * (hit_end.y / dist_end));
+                const int run_length = max((int)settings->perspective, 1);
 
-                              v /= ((1.0f - r_y) * (1.0f / dist_start))
-                                + (r_y * (1.0f / dist_end));
+                const int face_x = (has_faces) ? (int)face * face_size : 0;
 
-                        float integral;
-                        u = clamp(modff(u, &integral), 0.0f, 1.0f);
-                        v = clamp(modff(v, &integral), 0.0f, 1.0f);
+                for (int y = first_y; y < last_y;)
+                {
+                    /* Correct the coordinates at the end of the run, and
+                       step linearly towards them.
+                    */
+                    const int run = min(run_length, last_y - y);
 
-                        if (y == start_y)
-                            u = 1.0f;
+                    attr = Fang_Vec3Add(
+                        attr, Fang_Vec3Multf(attr_step, (float)run)
+                    );
 
-                        tex_pos.x = (int)(u * (FANG_TEXTURE_SIZE  - 1));
-                        tex_pos.y = (int)(v * (FANG_TEXTURE_SIZE - 1));
-                    }
+                    const Fang_Vec2 next_coord = {
+                        .x = attr.x / attr.z,
+                        .y = attr.y / attr.z,
+                    };
 
-                    tex_pos.x += (int)face * FANG_TEXTURE_SIZE;
+                    const Fang_Vec2 coord_step = {
+                        .x = (next_coord.x - tex_coord.x) / (float)run,
+                        .y = (next_coord.y - tex_coord.y) / (float)run,
+                    };
 
-                    Fang_Color dest_color = Fang_GetPixel(
-                        wall_tex, &tex_pos
-                    );
+                    for (int r = 0; r < run; ++r, ++y)
+                    {
+                        float u = Fang_WrapMapCoord(tex_coord.x);
+                        float v = Fang_WrapMapCoord(tex_coord.y);
 
-                    const float dist = ((1.0f - r_y) * dist_start)
-                                     + (r_y * dist_end);
+                        if (y == start_y)
+                            u = 1.0f;
 
-                    framebuf->state.current_depth = dist;
+                        const Fang_Point tex_pos = {
+                            .x = (int)(u * (float)(face_size - 1)) + face_x,
+                            .y = (int)(v * (float)(face_size - 1)),
+                        };
 
-                    Fang_SetFragment(
-                        framebuf,
-                        &(Fang_Point){
+                        const Fang_Point point = {
                             .x = (int)i,
                             .y = y,
-                        },
-                        &dest_color
-                    );
+                        };
+
+                        framebuf->state.current_depth = dist;
+
+                        if (surface)
+                        {
+                            Fang_SetVisibleTexel(
+                                framebuf,
+                                visibility,
+                                &point,
+                                surface,
+                                tex_pos.x,
+                                tex_pos.y
+                            );
+                        }
+                        else
+                        {
+                            uint32_t pixel = (swizzled)
+                                ? Fang_SampleSwizzledPixel(
+                                    wall_tex, tex_pos.x, tex_pos.y
+                                )
+                                : Fang_SamplePixel(
+                                    wall_tex, tex_pos.x, tex_pos.y
+                                );
+
+                            if (!premultiplied)
+                                pixel = Fang_PremultiplyPixel(pixel);
+
+                            Fang_SetPackedFragment(framebuf, &point, pixel);
+                        }
+
+                        tex_coord.x += coord_step.x;
+                        tex_coord.y += coord_step.y;
+                        dist        += dist_step;
+                    }
+
+                    tex_coord = next_coord;
                 }
             }
         }
@@ -733,150 +2181,622 @@ Fang_DrawMapTiles(
 }
 
 /**
- * Draws a 2D representation of the map.
+ * A sprite found to be visible while drawing entities.
+**/
+typedef struct Fang_Sprite {
+    const Fang_Image    * image;
+          Fang_Rect       rect;
+          float           depth;
+          Fang_EntityId   id;
+} Fang_Sprite;
+
+/**
+ * Orders sprites from furthest to nearest, sprites at the same depth are kept
+ * in the order of their entities.
+**/
+static int
+Fang_CompareSprites(
+    const void * const a,
+    const void * const b)
+{
+    const Fang_Sprite * const sprite_a = a;
+    const Fang_Sprite * const sprite_b = b;
+
+    if (sprite_a->depth != sprite_b->depth)
+        return (sprite_a->depth < sprite_b->depth) ? 1 : -1;
+
+    return (sprite_a->id > sprite_b->id) - (sprite_a->id < sprite_b->id);
+}
+
+/**
+ * Projects an entity into the viewport, adding its sprite to the list of
+ * sprites if it is visible.
+**/
+static inline void
+Fang_AddSprite(
+    const Fang_Rect     * const viewport,
+    const Fang_Camera   * const camera,
+    const Fang_Textures * const textures,
+    const Fang_Map      * const map,
+    const Fang_Entity   * const entity,
+          Fang_Sprite   * const sprites,
+          size_t        * const sprite_count)
+{
+    assert(viewport);
+    assert(camera);
+    assert(textures);
+    assert(map);
+    assert(entity);
+    assert(sprites);
+    assert(sprite_count);
+    assert(*sprite_count < FANG_MAX_ENTITIES);
+    assert(entity->body.width <= FANG_MAX_BODY_WIDTH);
+
+    const Fang_Vec2 pos = {.x = entity->body.pos.x, .y = entity->body.pos.y};
+
+    /* Reject entities outside of the view before projecting them */
+    if (!Fang_BoxInView(
+        camera, viewport, pos, pos, entity->body.width, map->fog_distance
+    ))
+        return;
+
+    float depth;
+
+    const Fang_Rect dest_rect = Fang_ProjectBody(
+        camera,
+        &entity->body,
+        viewport,
+        &depth
+    );
+
+    if (dest_rect.h <= 0)
+        return;
+
+    if (dest_rect.x + dest_rect.w <= 0 || dest_rect.x >= viewport->w)
+        return;
+
+    if (dest_rect.y + dest_rect.h <= 0 || dest_rect.y >= viewport->h)
+        return;
+
+    if (depth > map->fog_distance)
+        return;
+
+    /* Select the mipmap level from the projected size of the sprite */
+    const Fang_TextureId     texture_id = Fang_GetEntityTexture(entity);
+    const Fang_Image * const texture    = Fang_GetTexture(
+        textures, texture_id
+    );
+
+    const Fang_Image * const image = (texture)
+        ? Fang_GetTextureLevel(
+            textures,
+            texture_id,
+            Fang_GetMipmapLevel(
+                (float)texture->width / (float)max(dest_rect.w, 1)
+            )
+        )
+        : NULL;
+
+    sprites[(*sprite_count)++] = (Fang_Sprite){
+        /* If the image is invalid we draw the 'XOR Texture' instead */
+        .image = (Fang_ImageValid(image)) ? image : Fang_GetFallbackImage(),
+        .rect  = dest_rect,
+        .depth = depth,
+        .id    = entity->id,
+    };
+}
+
+/**
+ * Gathers the sprites of all visible entities, returning the number of sprites
+ * found.
+ *
+ * Entities are gathered from the location tables of the chunks within view
+ * (up to the fog distance), and are culled in 2D before being projected. The
+ * sprites are sorted from back to front so that translucent sprites blend over
+ * those behind them when drawn with Fang_DrawSprites().
  *
- * Depth buffering is disabled during this function.
+ * The sprites are gathered into the given array, which must be able to hold
+ * FANG_MAX_ENTITIES sprites.
 **/
-static void
-Fang_DrawMinimap(
-          Fang_Framebuffer * const framebuf,
-    const Fang_Camera      * const camera,
-    const Fang_Map         * const map,
-    const Fang_Ray         * const rays,
-    const size_t                   count)
+static size_t
+Fang_GatherSprites(
+          Fang_Framebuffer    * const framebuf,
+    const Fang_Camera         * const camera,
+    const Fang_Textures       * const textures,
+    const Fang_Map            * const map,
+          Fang_Entities       * const entities,
+          Fang_Sprite         * const sprites)
 {
     assert(framebuf);
     assert(camera);
+    assert(textures);
     assert(map);
-    assert(rays);
-    assert(count);
+    assert(entities);
+    assert(sprites);
 
-    const Fang_Rect bounds = Fang_GetViewport(framebuf);
+    const Fang_Rect viewport = Fang_GetViewport(framebuf);
 
-    Fang_FillRect(framebuf, &bounds, &FANG_BLACK);
+    size_t sprite_count = 0;
 
-    for (int row = 0; row < FANG_CHUNK_SIZE; ++row)
-    {
-        const float rowf = (float)row / (float)FANG_CHUNK_SIZE;
+    /* Distinct chunk indices can resolve to the same chunk (see
+       Fang_GetIndexedChunk()), so entities are only gathered once
+    */
+    bool gathered[FANG_MAX_ENTITIES] = {false};
+
+    Fang_Vec2 view_min,
+              view_max;
+
+    Fang_GetViewBounds(
+        camera,
+        &viewport,
+        FANG_MAX_BODY_WIDTH,
+        map->fog_distance,
+        &view_min,
+        &view_max
+    );
+
+    /* Positions exactly on the edge of a negative chunk belong to the chunk
+       below it (see Fang_GetChunk()), so the range is widened on its low side
+    */
+    const int min_x = (int)clamp(
+        floorf(view_min.x / FANG_CHUNK_SIZE) - 1.0f,
+        (float)FANG_CHUNK_MIN,
+        (float)(FANG_CHUNK_MAX - 1)
+    );
+
+    const int min_y = (int)clamp(
+        floorf(view_min.y / FANG_CHUNK_SIZE) - 1.0f,
+        (float)FANG_CHUNK_MIN,
+        (float)(FANG_CHUNK_MAX - 1)
+    );
+
+    const int max_x = (int)clamp(
+        floorf(view_max.x / FANG_CHUNK_SIZE),
+        (float)FANG_CHUNK_MIN,
+        (float)(FANG_CHUNK_MAX - 1)
+    );
+
+    const int max_y = (int)clamp(
+        floorf(view_max.y / FANG_CHUNK_SIZE),
+        (float)FANG_CHUNK_MIN,
+        (float)(FANG_CHUNK_MAX - 1)
+    );
 
-        for (int col = 0; col < FANG_CHUNK_SIZE; ++col)
+    for (int y = min_y; y <= max_y; ++y)
+    {
+        for (int x = min_x; x <= max_x; ++x)
         {
-            const float colf = (float)col / (float)FANG_CHUNK_SIZE;
+            const Fang_Vec2 chunk_min = {
+                .x = (float)(x * FANG_CHUNK_SIZE),
+                .y = (float)(y * FANG_CHUNK_SIZE),
+            };
+
+            const Fang_Vec2 chunk_max = {
+                .x = chunk_min.x + FANG_CHUNK_SIZE,
+                .y = chunk_min.y + FANG_CHUNK_SIZE,
+            };
 
-            const Fang_Point point = {row, col};
-            if (!Fang_GetChunkTile(&map->chunks, &point))
+            if (!Fang_BoxInView(
+                camera,
+                &viewport,
+                chunk_min,
+                chunk_max,
+                FANG_MAX_BODY_WIDTH,
+                map->fog_distance
+            ))
                 continue;
 
-            Fang_Rect map_tile_bounds = Fang_ResizeRect(
-                &(Fang_Rect){
-                    .x = (int)(rowf * bounds.w),
-                    .y = (int)(colf * bounds.h),
-                    .w = bounds.w / FANG_CHUNK_SIZE,
-                    .h = bounds.h / FANG_CHUNK_SIZE,
-                },
-                -2,
-                -2
+            const Fang_Chunk * const chunk = Fang_GetIndexedChunk(
+                &map->chunks, (int8_t)x, (int8_t)y
             );
 
-            Fang_FillRect(framebuf, &map_tile_bounds, &FANG_WHITE);
+            for (size_t i = 0; i < chunk->entities.count; ++i)
+            {
+                const Fang_EntityId id = chunk->entities.entities[i];
+
+                if (gathered[id])
+                    continue;
+
+                gathered[id] = true;
+
+                const Fang_Entity * const entity = Fang_GetEntity(
+                    entities, id
+                );
+
+                if (!entity)
+                    continue;
+
+                Fang_AddSprite(
+                    &viewport,
+                    camera,
+                    textures,
+                    map,
+                    entity,
+                    sprites,
+                    &sprite_count
+                );
+            }
         }
     }
 
-    const Fang_Point minimap_pos = {
-        .x = (int)((camera->pos.x / FANG_CHUNK_SIZE) * bounds.w),
-        .y = (int)((camera->pos.y / FANG_CHUNK_SIZE) * bounds.h),
-    };
+    qsort(sprites, sprite_count, sizeof(Fang_Sprite), Fang_CompareSprites);
+    return sprite_count;
+}
+
+/**
+ * Draws the columns between start_x and end_x of the given sprites, in the
+ * order they were gathered with Fang_GatherSprites().
+ *
+ * If occluders are given (one per framebuffer column, see Fang_DrawMapTiles()),
+ * the rows of each sprite column hidden behind the nearest wall are skipped
+ * without being tested against the depth buffer, as are whole columns.
+**/
+static void
+Fang_DrawSprites(
+          Fang_Framebuffer    * const framebuf,
+    const Fang_Sprite         * const sprites,
+    const size_t                      sprite_count,
+    const Fang_ColumnOccluder * const occluders,
+    const size_t                      count,
+    const int                         start_x,
+    const int                         end_x)
+{
+    assert(framebuf);
+    assert(framebuf->color.stride == 4 || Fang_DepthInterleaved(framebuf));
+    assert(sprites || !sprite_count);
 
+    const Fang_Rect viewport = Fang_GetViewport(framebuf);
 
-    if ((minimap_pos.x >= 0 && minimap_pos.x < bounds.w)
-    &&  (minimap_pos.y >= 0 && minimap_pos.y < bounds.h))
+    for (size_t i = 0; i < sprite_count; ++i)
     {
-        for (size_t i = 0; i < count; ++i)
-        {
-            const Fang_Ray * const ray = &rays[i];
+        const Fang_Sprite * const sprite = &sprites[i];
+
+        const Fang_Rect clipped_area = Fang_ClipRect(&sprite->rect, &viewport);
+
+        const int first_x = max(clipped_area.x, start_x);
+        const int last_x  = min(clipped_area.x + clipped_area.w, end_x);
 
-            if (!ray->hit_count)
+        if (first_x >= last_x)
+            continue;
+
+        const Fang_Rect source_area = {
+            .w = sprite->image->width,
+            .h = sprite->image->height,
+        };
+
+        framebuf->state.current_depth = sprite->depth;
+
+        for (int x = first_x; x < last_x; ++x)
+        {
+            if (!Fang_ColumnDrawn(framebuf, x))
                 continue;
 
-            const Fang_Vec2 ray_pos = ray->hits[ray->hit_count - 1].back_hit;
+            int start_y = clipped_area.y;
+            int end_y   = clipped_area.y + clipped_area.h;
+
+            if (occluders && (size_t)x < count
+            &&  sprite->depth > occluders[x].depth)
+            {
+                const Fang_ColumnOccluder * const wall = &occluders[x];
+
+                /* Trim whichever end of the column is behind the wall */
+                if (wall->top <= start_y)
+                    start_y = max(start_y, wall->bottom);
+                else if (wall->bottom >= end_y)
+                    end_y = min(end_y, wall->top);
+
+                if (start_y >= end_y)
+                    continue;
+            }
 
-            Fang_DrawLine(
+            Fang_DrawScaledColumn(
                 framebuf,
-                &minimap_pos,
-                &(Fang_Point){
-                    .x = (int)((ray_pos.x / FANG_CHUNK_SIZE) * bounds.w),
-                    .y = (int)((ray_pos.y / FANG_CHUNK_SIZE) * bounds.h),
-                },
-                &(Fang_Color){
-                    .b = 255,
-                    .a = 1,
-                }
+                sprite->image,
+                &source_area,
+                &sprite->rect,
+                false,
+                false,
+                x,
+                start_y,
+                end_y
             );
         }
     }
+}
+
+/**
+ * Maps points seen by one camera to where they were seen by the camera of an
+ * earlier frame (see Fang_InitReprojection()).
+ *
+ * The position of a point relative to the last camera is a linear function of
+ * its depth and of its column's coordinate on the camera plane, so only the
+ * coefficients are kept.
+**/
+typedef struct Fang_Reprojection {
+    Fang_Rect viewport;
+    Fang_Rect sky;
+    Fang_Rect last_sky;
+    Fang_Vec2 moved;
+    Fang_Vec2 view;
+    Fang_Vec2 view_step;
+    float     sky_scale;
+    float     moved_z;
+    float     pitch;
+    float     last_pitch;
+    float     plane_step;
+    float     last_det;
+    float     last_scale;
+    bool      still;
+} Fang_Reprojection;
+
+/**
+ * Prepares the mapping of points from the current camera into the last one.
+**/
+static inline Fang_Reprojection
+Fang_InitReprojection(
+    const Fang_Camera * const camera,
+    const Fang_Camera * const last,
+    const Fang_Rect   * const viewport)
+{
+    assert(camera);
+    assert(last);
+    assert(viewport);
+
+    const Fang_Vec2 moved = {
+        .x = camera->pos.x - last->pos.x,
+        .y = camera->pos.y - last->pos.y,
+    };
+
+    const Fang_Rect sky      = Fang_GetSkyboxRect(camera, viewport);
+    const Fang_Rect last_sky = Fang_GetSkyboxRect(last, viewport);
 
-    Fang_FillRect(
-        framebuf,
-        &(Fang_Rect){
-            .x = clamp(minimap_pos.x, 0, bounds.w) - 5,
-            .y = clamp(minimap_pos.y, 0, bounds.h) - 5,
-            .w = 10,
-            .h = 10,
+    const float last_det = last->cam.x * last->dir.y
+                         - last->cam.y * last->dir.x;
+
+    /* The camera's direction and plane, as seen by the last camera */
+    return (Fang_Reprojection){
+        .viewport = *viewport,
+        .sky      = sky,
+        .last_sky = last_sky,
+        .moved = {
+            .x =  last->dir.y * moved.x - last->dir.x * moved.y,
+            .y = -last->cam.y * moved.x + last->cam.x * moved.y,
         },
-        &FANG_RED
-    );
+        .view = {
+            .x =  last->dir.y * camera->dir.x - last->dir.x * camera->dir.y,
+            .y = -last->cam.y * camera->dir.x + last->cam.x * camera->dir.y,
+        },
+        .view_step = {
+            .x =  last->dir.y * camera->cam.x - last->dir.x * camera->cam.y,
+            .y = -last->cam.y * camera->cam.x + last->cam.x * camera->cam.y,
+        },
+        .sky_scale  = (sky.h > 0) ? (float)last_sky.h / (float)sky.h : 0.0f,
+        .moved_z    = (camera->pos.z - last->pos.z) * FANG_PROJECTION_RATIO,
+        .pitch      = camera->dir.z * (float)viewport->h,
+        .last_pitch = last->dir.z * (float)viewport->h,
+        .plane_step = 2.0f / (float)viewport->w,
+        .last_det   = last_det,
+        .last_scale = (last_det > 0.0f) ? 1.0f / last_det : 0.0f,
+        .still      = !memcmp(camera, last, sizeof(Fang_Camera)),
+    };
 }
 
+/**
+ * Returns where the last camera saw the point at a given depth behind a pixel,
+ * along with the depth it was seen at.
+ *
+ * Points at an infinite depth are in the sky, which moves with the skybox
+ * instead. Points the last camera couldn't see are returned off screen.
+**/
+static inline Fang_Point
+Fang_ReprojectPoint(
+    const Fang_Reprojection * const reproj,
+    const Fang_Point        * const point,
+    const float                     depth,
+          float             * const last_depth)
+{
+    assert(reproj);
+    assert(point);
+    assert(last_depth);
+
+    const float width  = (float)reproj->viewport.w;
+    const float height = (float)reproj->viewport.h;
+
+    /* Nothing moved, so every point is where it was */
+    if (reproj->still)
+    {
+        *last_depth = depth;
+        return *point;
+    }
+
+    *last_depth = FLT_MAX;
+
+    if (depth == FLT_MAX)
+    {
+        if (reproj->sky.h <= 0)
+            return (Fang_Point){.x = -1, .y = -1};
+
+        return (Fang_Point){
+            .x = point->x - reproj->sky.x + reproj->last_sky.x,
+            .y = (int)((float)point->y * reproj->sky_scale),
+        };
+    }
+
+    /* X coordinate in camera space, as in Fang_GetCameraRayDir() */
+    const float plane_x = 1.0f - (float)point->x * reproj->plane_step;
+
+    const Fang_Vec2 view = {
+        .x = reproj->moved.x
+           + depth * (reproj->view.x + reproj->view_step.x * plane_x),
+        .y = reproj->moved.y
+           + depth * (reproj->view.y + reproj->view_step.y * plane_x),
+    };
+
+    if (view.y <= 0.0f || reproj->last_det <= 0.0f)
+        return (Fang_Point){.x = -1, .y = -1};
+
+    const float inverse = 1.0f / view.y;
+
+    *last_depth = view.y * reproj->last_scale;
+
+    /* The height of the last camera above the point (scaled as projected by
+       Fang_ProjectTile()) gives its row
+    */
+    const float above = (
+        (float)point->y - height / 2.0f - reproj->pitch
+    ) * depth - reproj->moved_z * height;
+
+    const Fang_Vec2 pos = {
+        .x = width / 2.0f * (1.0f - view.x * inverse),
+        .y = height / 2.0f
+           + reproj->last_pitch
+           + above * reproj->last_det * inverse,
+    };
+
+    /* Rounded to the nearest pixel, points off screen aren't seen */
+    if (!(pos.x >= -0.5f && pos.x < width  - 0.5f)
+    ||  !(pos.y >= -0.5f && pos.y < height - 0.5f))
+        return (Fang_Point){.x = -1, .y = -1};
+
+    return (Fang_Point){
+        .x = (int)(pos.x + 0.5f),
+        .y = (int)(pos.y + 0.5f),
+    };
+}
 
+/**
+ * Fills in the columns which an interlaced frame skipped (see
+ * Fang_ColumnDrawn()) by reprojecting the previous frame into the current one.
+ *
+ * Each skipped pixel is placed along its column's ray at the depth of one of
+ * the columns to either side of it (the nearest first), then found in the
+ * history framebuffer as it was seen from the history camera. The history's
+ * pixel is used if its depth matches, otherwise (such as where a surface was
+ * uncovered, or without a history) the pixel is the average of its neighbours.
+ *
+ * Once the camera moves, history pixels are clamped between the colors of
+ * their neighbours, which hides most of the error of resampling the history
+ * (at the cost of thin details, which only show up again once the camera
+ * stops).
+ *
+ * The history must have the same size and layouts as the framebuffer.
+**/
 static void
-Fang_DrawEntities(
+Fang_ReconstructFramebuffer(
           Fang_Framebuffer * const framebuf,
+    const Fang_Framebuffer * const history,
     const Fang_Camera      * const camera,
-    const Fang_Textures    * const textures,
-    const Fang_Map         * const map,
-          Fang_Entities    * const entities)
+    const Fang_Camera      * const history_camera)
 {
     assert(framebuf);
+    assert(Fang_ImageValid(&framebuf->color));
+    assert(Fang_ImageValid(&framebuf->depth));
+    assert(framebuf->color.stride == framebuf->depth.stride);
     assert(camera);
-    assert(textures);
-    assert(map);
-    assert(entities);
+    assert(!history || history_camera);
+
+    if (!framebuf->state.enable_interlace)
+        return;
 
     const Fang_Rect viewport = Fang_GetViewport(framebuf);
 
-    for (Fang_EntityId i = 0; i < FANG_MAX_ENTITIES; ++i)
+    const Fang_Reprojection reproj = Fang_InitReprojection(
+        camera, (history) ? history_camera : camera, &viewport
+    );
+
+    const bool columns = framebuf->color.layout == FANG_IMAGELAYOUT_COLUMNS;
+
+    const int step_x = Fang_GetPixelStepX(&framebuf->color);
+    const int step_y = Fang_GetPixelStepY(&framebuf->color);
+
+    /* Skipped columns are those of the other field */
+    const int first_x = 1 - (framebuf->state.field & 1);
+    const int skipped = (viewport.w - first_x + 1) / 2;
+
+    const int lines  = (columns) ? skipped : viewport.h;
+    const int length = (columns) ? viewport.h : skipped;
+
+    for (int i = 0; i < lines; ++i)
     {
-        const Fang_Entity * const entity = Fang_GetEntity(entities, i);
+        for (int j = 0; j < length; ++j)
+        {
+            const Fang_Point point = {
+                .x = first_x + 2 * ((columns) ? i : j),
+                .y = (columns) ? j : i,
+            };
 
-        if (!entity)
-            continue;
+            const int left_x = (point.x > 0)
+                ? point.x - 1
+                : point.x + 1;
 
-        const Fang_Rect dest_rect = Fang_ProjectBody(
-            camera,
-            &entity->body,
-            &viewport,
-            &framebuf->state.current_depth
-        );
+            const int right_x = (point.x + 1 < viewport.w)
+                ? point.x + 1
+                : point.x - 1;
 
-        if (dest_rect.h <= 0)
-            continue;
+            const int offset = point.x * step_x + point.y * step_y;
+            const int left   = left_x  * step_x + point.y * step_y;
+            const int right  = right_x * step_x + point.y * step_y;
 
-        if (dest_rect.x + dest_rect.w <= 0 || dest_rect.x >= viewport.w)
-            continue;
+            const uint32_t left_pixel = *(uint32_t*)(
+                framebuf->color.pixels + left
+            );
 
-        if (dest_rect.y + dest_rect.h <= 0 || dest_rect.y >= viewport.h)
-            continue;
+            const uint32_t right_pixel = *(uint32_t*)(
+                framebuf->color.pixels + right
+            );
 
-        if (framebuf->state.current_depth > map->fog_distance)
-            continue;
+            const float left_depth  = *(float*)(framebuf->depth.pixels + left);
+            const float right_depth = *(float*)(framebuf->depth.pixels + right);
 
-        Fang_DrawImageEx(
-            framebuf,
-            Fang_GetTexture(textures, Fang_GetEntityTexture(entity)),
-            NULL,
-            &dest_rect,
-            false,
-            false
-        );
+            const float depths[2] = {
+                min(left_depth, right_depth),
+                max(left_depth, right_depth),
+            };
+
+            uint32_t pixel = Fang_AveragePixels(left_pixel, right_pixel);
+            float    depth = depths[0];
+
+            for (int k = 0; history && k < 2; ++k)
+            {
+                if (k && depths[1] == depths[0])
+                    break;
+
+                float last_dist;
+
+                const Fang_Point last_pos = Fang_ReprojectPoint(
+                    &reproj, &point, depths[k], &last_dist
+                );
+
+                if (last_pos.x < 0 || last_pos.x >= viewport.w
+                ||  last_pos.y < 0 || last_pos.y >= viewport.h)
+                    continue;
+
+                const int last_offset = last_pos.x * step_x
+                                      + last_pos.y * step_y;
+
+                const float last_depth = *(float*)(
+                    history->depth.pixels + last_offset
+                );
+
+                /* Points not seen by the history are hidden behind others */
+                const bool seen = (depths[k] == FLT_MAX)
+                    ? last_depth == FLT_MAX
+                    : fabsf(last_depth - last_dist) <= last_dist * 0.1f + 0.1f;
+
+                if (!seen)
+                    continue;
+
+                pixel = *(uint32_t*)(history->color.pixels + last_offset);
+                depth = last_depth;
+
+                if (!reproj.still)
+                    pixel = Fang_ClampPixel(pixel, left_pixel, right_pixel);
+
+                break;
+            }
+
+            *(uint32_t*)(framebuf->color.pixels + offset) = pixel;
+            *(float*)(framebuf->depth.pixels + offset)    = depth;
+        }
     }
 }
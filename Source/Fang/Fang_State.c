@@ -28,17 +28,44 @@ typedef struct Fang_Clock {
  *
  * While this structure holds all the necessary data for the game to run, it is
  * not indicative of the game's "save state".
+ *
+ * The scene version is that of the last rendered frame (see
+ * Fang_GetSceneVersion()), which lets unchanged frames skip rendering.
+ *
+ * When the framebuffer is column-major or has its depth interleaved, each
+ * rendered frame is copied into the row-major frame image to be shown.
+ *
+ * Interlaced frames are reconstructed from the history, a copy of the world as
+ * drawn by the last frame along with the camera it was seen from. The history
+ * is only kept while interlacing is enabled.
+ *
+ * Deferred frames record the texels seen in each pixel into the visibility
+ * buffer, which is likewise only kept while deferred rendering is enabled.
 **/
 typedef struct Fang_State {
-    Fang_Framebuffer framebuffer;
-    Fang_Map         map;
-    Fang_Textures    textures;
-    Fang_Ray         raycast[FANG_WINDOW_SIZE];
-    Fang_Clock       clock;
-    Fang_Camera      camera;
-    Fang_EntityId    player;
-    Fang_Interface   interface;
-    Fang_Entities    entities;
-    Fang_LerpVec2    sway;
-    float            bob;
+    Fang_Framebuffer      framebuffer;
+    Fang_Image            frame;
+    Fang_Framebuffer      history;
+    Fang_Camera           history_camera;
+    Fang_VisibilityBuffer visibility;
+    Fang_RenderSettings   settings;
+    Fang_Map              map;
+    Fang_Textures         textures;
+    Fang_Pack             pack;
+    Fang_Ray              raycast[FANG_WINDOW_SIZE];
+    Fang_ColumnOccluder   occluders[FANG_WINDOW_SIZE];
+    Fang_FloorRow         floor_rows[FANG_WINDOW_SIZE];
+    Fang_Sprite           sprites[FANG_MAX_ENTITIES];
+    Fang_Clock            clock;
+    Fang_Camera           camera;
+    Fang_EntityId         player;
+    Fang_Interface        interface;
+    Fang_Hud              hud;
+    Fang_Minimap          minimap;
+    Fang_Entities         entities;
+    Fang_LerpVec2         sway;
+    float                 bob;
+    uint64_t              scene_version;
+    bool                  scene_valid;
+    bool                  history_valid;
 } Fang_State;
@@ -13,15 +13,207 @@
 // You should have received a copy of the GNU General Public License along
 // with this program.  If not, see <http://www.gnu.org/licenses/>.
 
+/**
+ * Converts TGA pixels (BGR, BGRA, or greyscale) into packed 32-bit pixels.
+ *
+ * The source depth is given in bytes per pixel. Pixels without an alpha channel
+ * are made opaque. Vector paths handle the bulk of each run when available,
+ * with any remaining pixels converted one at a time.
+**/
+static inline void
+Fang_PackTGAPixels(
+          uint32_t * const dest,
+    const uint8_t  *       source,
+    const int              count,
+    const int              stride)
+{
+    assert(dest);
+    assert(source);
+    assert(stride == 1 || stride == 3 || stride == 4);
+
+    int i = 0;
+
+    switch (stride)
+    {
+        case 4:
+        {
+        #if defined(FANG_SIMD_NEON)
+            for (; i + 16 <= count; i += 16, source += 64)
+            {
+                const uint8x16x4_t bgra = vld4q_u8(source);
+                const uint8x16x4_t abgr = {{
+                    bgra.val[3], bgra.val[0], bgra.val[1], bgra.val[2],
+                }};
+
+                vst4q_u8((uint8_t*)(dest + i), abgr);
+            }
+        #elif defined(FANG_SIMD_SSE2)
+            /* BGRA in memory is rotated left by a byte to give RGBA */
+            for (; i + 4 <= count; i += 4, source += 16)
+            {
+                const __m128i bgra = _mm_loadu_si128((const __m128i*)source);
+
+                _mm_storeu_si128(
+                    (__m128i*)(dest + i),
+                    _mm_or_si128(
+                        _mm_slli_epi32(bgra, 8),
+                        _mm_srli_epi32(bgra, 24)
+                    )
+                );
+            }
+        #endif
+
+            for (; i < count; ++i, source += 4)
+            {
+                dest[i] = (uint32_t)source[2] << 24
+                        | (uint32_t)source[1] << 16
+                        | (uint32_t)source[0] <<  8
+                        | (uint32_t)source[3];
+            }
+
+            break;
+        }
+
+        case 3:
+        {
+        #if defined(FANG_SIMD_NEON)
+            for (; i + 16 <= count; i += 16, source += 48)
+            {
+                const uint8x16x3_t bgr  = vld3q_u8(source);
+                const uint8x16x4_t abgr = {{
+                    vdupq_n_u8(0xFF), bgr.val[0], bgr.val[1], bgr.val[2],
+                }};
+
+                vst4q_u8((uint8_t*)(dest + i), abgr);
+            }
+        #elif defined(FANG_SIMD_SSSE3)
+            /* Each load reads 16 bytes for 4 pixels (12 bytes), so stop while
+               there are still 2 whole pixels left to avoid reading past the
+               source data.
+            */
+            const __m128i shuffle = _mm_setr_epi8(
+                -1, 0,  1,  2,
+                -1, 3,  4,  5,
+                -1, 6,  7,  8,
+                -1, 9, 10, 11
+            );
+
+            const __m128i alpha = _mm_set1_epi32(0xFF);
+
+            for (; i + 6 <= count; i += 4, source += 12)
+            {
+                const __m128i bgr = _mm_loadu_si128((const __m128i*)source);
+
+                _mm_storeu_si128(
+                    (__m128i*)(dest + i),
+                    _mm_or_si128(_mm_shuffle_epi8(bgr, shuffle), alpha)
+                );
+            }
+        #endif
+
+            for (; i < count; ++i, source += 3)
+            {
+                dest[i] = (uint32_t)source[2] << 24
+                        | (uint32_t)source[1] << 16
+                        | (uint32_t)source[0] <<  8
+                        | 0xFFu;
+            }
+
+            break;
+        }
+
+        case 1:
+        {
+        #if defined(FANG_SIMD_NEON)
+            for (; i + 16 <= count; i += 16, source += 16)
+            {
+                const uint8x16_t   grey = vld1q_u8(source);
+                const uint8x16x4_t abgr = {{
+                    vdupq_n_u8(0xFF), grey, grey, grey,
+                }};
+
+                vst4q_u8((uint8_t*)(dest + i), abgr);
+            }
+        #elif defined(FANG_SIMD_SSE2)
+            const __m128i opaque = _mm_set1_epi8(-1);
+
+            for (; i + 16 <= count; i += 16, source += 16)
+            {
+                const __m128i grey = _mm_loadu_si128((const __m128i*)source);
+
+                /* Interleave into 16-bit pairs of (alpha, grey) and
+                   (grey, grey), which then form each pixel's four bytes.
+                */
+                const __m128i ag_lo = _mm_unpacklo_epi8(opaque, grey);
+                const __m128i ag_hi = _mm_unpackhi_epi8(opaque, grey);
+                const __m128i gg_lo = _mm_unpacklo_epi8(grey, grey);
+                const __m128i gg_hi = _mm_unpackhi_epi8(grey, grey);
+
+                __m128i * const out = (__m128i*)(dest + i);
+
+                _mm_storeu_si128(out + 0, _mm_unpacklo_epi16(ag_lo, gg_lo));
+                _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(ag_lo, gg_lo));
+                _mm_storeu_si128(out + 2, _mm_unpacklo_epi16(ag_hi, gg_hi));
+                _mm_storeu_si128(out + 3, _mm_unpackhi_epi16(ag_hi, gg_hi));
+            }
+        #endif
+
+            for (; i < count; ++i, ++source)
+                dest[i] = (uint32_t)*source * 0x01010100u | 0xFFu;
+
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+/**
+ * Fills a run of packed pixels with a single value, as used by RLE repetition
+ * packets.
+**/
+static inline void
+Fang_FillTGAPixels(
+          uint32_t * const dest,
+    const uint32_t         pixel,
+    const int              count)
+{
+    assert(dest);
+
+    int i = 0;
+
+#if defined(FANG_SIMD_NEON)
+    const uint32x4_t value = vdupq_n_u32(pixel);
+
+    for (; i + 4 <= count; i += 4)
+        vst1q_u32(dest + i, value);
+#elif defined(FANG_SIMD_SSE2)
+    const __m128i value = _mm_set1_epi32((int)pixel);
+
+    for (; i + 4 <= count; i += 4)
+        _mm_storeu_si128((__m128i*)(dest + i), value);
+#endif
+
+    for (; i < count; ++i)
+        dest[i] = pixel;
+}
+
 /**
  * Parses TGA file data.
  *
+ * The resulting image is always 32-bit, with pixels packed in the same format
+ * as Fang_MapColor(). Images without an alpha channel are made opaque. Pixels
+ * are decoded straight into the final image, so no intermediate buffers are
+ * allocated, and images with a bottom-left origin are handled by writing their
+ * rows in reverse order.
+ *
  * This function does not support the following TGA features:
  * - Bit depths other than 8, 24, or 32
  * - Indexed/color-mapped files
  * - Interleaving
  * - Black and white images with a depth higher than 8
- * - Images with an origin other than top-left
+ * - Images with a right-hand origin
 **/
 static Fang_Image
 Fang_ParseTGA(
@@ -29,7 +221,8 @@ Fang_ParseTGA(
 {
     assert(file);
 
-    const uint8_t * data = file->data;
+    const uint8_t *       data = file->data;
+    const uint8_t * const end  = data + file->size;
 
     enum {
         TGA_IMAGE_NONE    =  0, /* Empty                           */
@@ -50,6 +243,8 @@ Fang_ParseTGA(
         TGA_ORIGIN_RIGHT    = 0x10,
         TGA_ORIGIN_LOWER    = 0x00,
         TGA_ORIGIN_UPPER    = 0x20,
+
+        TGA_HEADER_SIZE     = 18,
     };
 
     struct {
@@ -67,6 +262,11 @@ Fang_ParseTGA(
         uint8_t  descriptor;
     } header;
 
+    Fang_Image result = {.pixels = NULL};
+
+    if (file->size < TGA_HEADER_SIZE)
+        goto Error_Truncated;
+
     memcpy(&header.id_len,       data, sizeof( uint8_t)); data += sizeof( uint8_t);
     memcpy(&header.map_included, data, sizeof( uint8_t)); data += sizeof( uint8_t);
     memcpy(&header.image_type,   data, sizeof( uint8_t)); data += sizeof( uint8_t);
@@ -80,10 +280,7 @@ Fang_ParseTGA(
     memcpy(&header.depth,        data, sizeof( uint8_t)); data += sizeof( uint8_t);
     memcpy(&header.descriptor,   data, sizeof( uint8_t)); data += sizeof( uint8_t);
 
-    Fang_Image result = {.pixels = NULL};
-
-    bool bw  = false,
-         rle = false;
+    bool rle = false;
 
     switch (header.image_type)
     {
@@ -93,7 +290,7 @@ Fang_ParseTGA(
             break;
 
         case TGA_IMAGE_RLEGREY: /* fallthrough */
-            rle = bw = true;
+            rle = true;
         case TGA_IMAGE_GREY:
             if (header.depth != 8)
                 goto Error_Unsupported;
@@ -113,121 +310,98 @@ Fang_ParseTGA(
     if ((header.descriptor & TGA_MASK_INTERLEAVE) != TGA_INTERLEAVE_NONE)
         goto Error_Unsupported;
 
-    if (header.descriptor & TGA_ORIGIN_LOWER)
-        goto Error_Unsupported;
-
     if (header.descriptor & TGA_ORIGIN_RIGHT)
         goto Error_Unsupported;
 
-    if (Fang_AllocImage(&result, header.width, header.height, header.depth))
+    if (Fang_AllocImage(&result, header.width, header.height, 32))
         goto Error_Allocation;
 
     /* Image ID and color map unused */
     data += header.id_len;
     data += header.map_length;
 
-    if (rle)
+    const int  stride = header.depth / 8;
+    const bool upper  = header.descriptor & TGA_ORIGIN_UPPER;
+
+    /* Runs of pixels left over from the previous packet, as packets may span
+       multiple rows.
+    */
+    int      count = 0;
+    int      rep   = 0;
+    uint32_t pixel = 0;
+
+    for (int h = 0; h < result.height; ++h)
     {
-        uint8_t * pixel = calloc(1, (size_t)result.stride);
+        uint32_t * const dest = (uint32_t*)(
+            result.pixels
+          + ((upper) ? h : result.height - 1 - h) * result.pitch
+        );
 
-        if (!pixel)
-            goto Error_Allocation;
+        if (!rle)
+        {
+            if (end - data < (ptrdiff_t)result.width * stride)
+                goto Error_Truncated;
 
-        uint8_t * dest = result.pixels;
+            Fang_PackTGAPixels(dest, data, result.width, stride);
+            data += result.width * stride;
+            continue;
+        }
 
-        int count = 0,
-            rep   = 0;
+        int x = 0;
 
-        for (int h = 0; h < result.height; ++h)
+        while (x < result.width)
         {
-            int x = 0;
-            while (true)
+            if (count)
             {
-                if (count)
-                {
-                    const int n = min(count, result.width - x);
-
-                    memcpy(
-                        dest + x * result.stride,
-                        data,
-                        (size_t)(n * result.stride)
-                    );
-
-                    data += n * result.stride;
-
-                    count -= n;
-                    x     += n;
-
-                    if (x == result.width)
-                        break;
-                }
-                else if (rep)
-                {
-                    int n = min(rep, result.width - x);
-                    rep -= n;
-
-                    while (n--)
-                    {
-                        memcpy(
-                            dest + x * result.stride,
-                            pixel,
-                            (size_t)result.stride
-                        );
-
-                        x++;
-                    }
-
-                    if (x == result.width)
-                        break;
-                }
-
-                const uint8_t val = *data++;
-                if (val & 0x80)
-                {
-                    memcpy(pixel, data, (size_t)result.stride);
-
-                    data += result.stride;
-                    rep   = (val & 0x7F) + 1;
-                }
-                else
-                {
-                    count = val + 1;
-                }
+                const int n = min(count, result.width - x);
+
+                if (end - data < (ptrdiff_t)n * stride)
+                    goto Error_Truncated;
+
+                Fang_PackTGAPixels(dest + x, data, n, stride);
+
+                data  += n * stride;
+                count -= n;
+                x     += n;
+                continue;
             }
 
-            dest += result.pitch;
-        }
+            if (rep)
+            {
+                const int n = min(rep, result.width - x);
 
-        free(pixel);
-    }
-    else /* !rle */
-    {
-        uint8_t * dest = result.pixels;
+                Fang_FillTGAPixels(dest + x, pixel, n);
 
-        for (int h = 0; h < result.height; ++h)
-        {
-            memcpy(dest, data, (size_t)result.pitch);
-            dest += result.pitch;
-            data += result.pitch;
-        }
-    }
+                rep -= n;
+                x   += n;
+                continue;
+            }
 
-    // Swap from BGR(A) to RGB(A)
-    if (result.stride == 3 || result.stride == 4)
-    {
-        for (int i = 0; i < result.pitch * result.height; i += result.stride)
-        {
-            uint8_t * const first = (result.pixels + i);
-            uint8_t * const third = (result.pixels + i + 2);
+            if (end - data < 1)
+                goto Error_Truncated;
+
+            const uint8_t val = *data++;
 
-            const uint8_t temp = *first;
-            *first = *third;
-            *third = temp;
+            if (val & 0x80)
+            {
+                if (end - data < stride)
+                    goto Error_Truncated;
+
+                Fang_PackTGAPixels(&pixel, data, 1, stride);
+
+                data += stride;
+                rep   = (val & 0x7F) + 1;
+            }
+            else
+            {
+                count = val + 1;
+            }
         }
     }
 
     return result;
 
+Error_Truncated:
 Error_Allocation:
 Error_Unsupported:
     Fang_FreeImage(&result);
@@ -241,10 +415,10 @@ Fang_LoadTGA(
     Fang_Image result = {.pixels = NULL};
 
     Fang_File file = {.data = NULL};
-    if (Fang_LoadFile(filepath, &file) != 0)
+    if (Fang_MapFile(filepath, &file) != 0)
         return result;
 
     result = Fang_ParseTGA(&file);
-    Fang_FreeFile(&file);
+    Fang_UnmapFile(&file);
     return result;
 }
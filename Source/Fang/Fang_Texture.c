@@ -46,156 +46,528 @@ typedef enum Fang_TextureId {
 } Fang_TextureId;
 
 /**
- * This structure is used for managing textures and fonts.
+ * How a texture is validated and processed once loaded.
 **/
-typedef struct Fang_Textures {
-    Fang_Image textures[FANG_NUM_TEXTURES];
-} Fang_Textures;
+typedef enum Fang_TextureType {
+    FANG_TEXTURETYPE_FONT,
+    FANG_TEXTURETYPE_TILE,
+    FANG_TEXTURETYPE_FLOOR,
+    FANG_TEXTURETYPE_SPRITE,
+    FANG_TEXTURETYPE_OTHER,
+} Fang_TextureType;
 
 /**
- * Frees a previously loaded texture.
+ * Describes where a texture is found in the game's resource directory, along
+ * with its type. Textures without a path are not loaded.
 **/
-static inline void
-Fang_FreeTexture(
-          Fang_Textures  * const textures,
-    const Fang_TextureId         id)
-{
-    assert(textures);
-    assert(id < FANG_NUM_TEXTURES);
-    assert(Fang_ImageValid(&textures->textures[id]));
-
-    Fang_FreeImage(&textures->textures[id]);
-}
+typedef struct Fang_TextureInfo {
+    const char       * const path;
+    const Fang_TextureType   type;
+} Fang_TextureInfo;
 
 /**
- * Loads a texture from the game's resource directory.
- *
- * If the texture has already been loaded, it is unloaded and then loaded again.
- * This can be used for refreshing textures that may have changed on disk.
- *
- * When a texture is loaded, its attributes such as width, height, stride, etc.
- * may be checked for validation.
+ * Returns the resource information for a texture.
 **/
-static inline int
-Fang_LoadTexture(
-          Fang_Textures  * const textures,
-    const Fang_TextureId         id)
+static inline const Fang_TextureInfo *
+Fang_GetTextureInfo(
+    const Fang_TextureId id)
 {
-    assert(textures);
     assert(id < FANG_NUM_TEXTURES);
 
-    Fang_Image * const result = &textures->textures[id];
-
-    if (Fang_ImageValid(result))
-        Fang_FreeTexture(textures, id);
-
-    typedef enum {
-        FONT_TEXTURE,
-        TILE_TEXTURE,
-        OTHER_TEXTURE,
-    } Type;
-
-    typedef struct {
-        const char * const path;
-        const Type         type;
-    } Info;
-
-    static const Info texture_info[FANG_NUM_TEXTURES] = {
+    static const Fang_TextureInfo texture_info[FANG_NUM_TEXTURES] = {
         /* Map Textures */
-        [FANG_TEXTURE_SKYBOX] = (Info){
+        [FANG_TEXTURE_SKYBOX] = (Fang_TextureInfo){
             .path = "Textures/Skybox.tga",
-            .type = OTHER_TEXTURE,
+            .type = FANG_TEXTURETYPE_OTHER,
         },
 
-        [FANG_TEXTURE_FLOOR] = (Info){
+        [FANG_TEXTURE_FLOOR] = (Fang_TextureInfo){
             .path = "Textures/Floor.tga",
-            .type = OTHER_TEXTURE,
+            .type = FANG_TEXTURETYPE_FLOOR,
         },
 
-        [FANG_TEXTURE_TILE] = (Info){
+        [FANG_TEXTURE_TILE] = (Fang_TextureInfo){
             .path = "Textures/Tile.tga",
-            .type = TILE_TEXTURE,
+            .type = FANG_TEXTURETYPE_TILE,
         },
 
         /* Fonts */
-        [FANG_TEXTURE_FORMULA] = (Info){
+        [FANG_TEXTURE_FORMULA] = (Fang_TextureInfo){
             .path = "Fonts/Formula.tga",
-            .type = FONT_TEXTURE,
+            .type = FANG_TEXTURETYPE_FONT,
         },
 
         /* HUD */
         [FANG_TEXTURE_PISTOL_HUD] = {
             .path = NULL,
-            .type = OTHER_TEXTURE,
+            .type = FANG_TEXTURETYPE_OTHER,
         },
 
         [FANG_TEXTURE_CARBINE_HUD] = {
             .path = NULL,
-            .type = OTHER_TEXTURE,
+            .type = FANG_TEXTURETYPE_OTHER,
         },
 
         [FANG_TEXTURE_FLAKGUN_HUD] = {
             .path = NULL,
-            .type = OTHER_TEXTURE,
+            .type = FANG_TEXTURETYPE_OTHER,
         },
 
         [FANG_TEXTURE_CHAINGUN_HUD] = {
             .path = NULL,
-            .type = OTHER_TEXTURE,
+            .type = FANG_TEXTURETYPE_OTHER,
         },
 
         [FANG_TEXTURE_LRAD_HUD] = {
             .path = NULL,
-            .type = OTHER_TEXTURE,
+            .type = FANG_TEXTURETYPE_OTHER,
         },
 
         [FANG_TEXTURE_PLASTICANNON_HUD] = {
             .path = NULL,
-            .type = OTHER_TEXTURE,
+            .type = FANG_TEXTURETYPE_OTHER,
         },
 
         [FANG_TEXTURE_FAZER_HUD] = {
             .path = NULL,
-            .type = OTHER_TEXTURE,
+            .type = FANG_TEXTURETYPE_OTHER,
         },
 
         /* Sprites */
         [FANG_TEXTURE_AMMO] = {
             .path = "Sprites/Ammo.tga",
-            .type = OTHER_TEXTURE,
+            .type = FANG_TEXTURETYPE_SPRITE,
         },
 
         [FANG_TEXTURE_HEALTH] = {
             .path = "Sprites/Health.tga",
-            .type = OTHER_TEXTURE,
+            .type = FANG_TEXTURETYPE_SPRITE,
         },
 
         [FANG_TEXTURE_PROJECTILE] = {
             .path = "Sprites/Projectile.tga",
-            .type = OTHER_TEXTURE,
+            .type = FANG_TEXTURETYPE_SPRITE,
         },
     };
 
+    return &texture_info[id];
+}
+
+/**
+ * How textures are held in memory once loaded.
+ *
+ * Full textures keep 32-bit packed pixels. Palettized textures are quantized to
+ * 8-bit indices into a per-image palette when loaded, taking a quarter of the
+ * memory at the cost of some color accuracy.
+**/
+typedef enum Fang_TextureStorage {
+    FANG_TEXTURESTORAGE_FULL,
+    FANG_TEXTURESTORAGE_PALETTIZED,
+} Fang_TextureStorage;
+
+/**
+ * The loading state of a single texture.
+ *
+ * Textures loaded in the background are queued, then picked up by a worker
+ * which marks them as loading. Once a texture's images are complete it is
+ * published as ready (or failed), after which it is owned by the main thread.
+**/
+typedef enum Fang_TextureStatus {
+    FANG_TEXTURESTATUS_UNLOADED,
+    FANG_TEXTURESTATUS_QUEUED,
+    FANG_TEXTURESTATUS_LOADING,
+    FANG_TEXTURESTATUS_READY,
+    FANG_TEXTURESTATUS_FAILED,
+} Fang_TextureStatus;
+
+/**
+ * This structure is used for managing textures and fonts.
+ *
+ * Textures drawn at varying distances also keep a chain of mipmaps, where each
+ * level is half the size of the previous. The full-size image is kept in the
+ * textures array, and mipmaps[id][0] is the first reduced level.
+ *
+ * The storage mode should be set before any textures are loaded, it only
+ * applies to tile, floor, and sprite textures. The same goes for swizzling,
+ * which stores floor and tile textures in Z-order so that the texels read along
+ * the oblique lines of the floor and tile-top samplers are close together.
+ *
+ * If an asset pack is given, textures found in the pack are used as-is instead
+ * of being decoded from their source files, as long as the pack was built with
+ * the same storage mode and swizzling. Other textures are decoded as usual.
+ *
+ * Each texture's status is published atomically, a texture's images are only
+ * read once its status is ready. Textures queued for background loading are
+ * picked in order of priority, which the game raises for textures that the
+ * current view references. Their files are read in the background as well,
+ * with each request being taken by the worker which decodes the texture.
+**/
+typedef struct Fang_Textures {
+    Fang_Image          textures[FANG_NUM_TEXTURES];
+    Fang_Image          mipmaps[FANG_NUM_TEXTURES][FANG_TEXTURE_LEVELS - 1];
+    Fang_TextureStorage storage;
+    bool                swizzled;
+    const Fang_Pack   * pack;
+    _Atomic int         status[FANG_NUM_TEXTURES];
+    _Atomic uint32_t    priority[FANG_NUM_TEXTURES];
+    Fang_FileRequest  * requests[FANG_NUM_TEXTURES];
+    Fang_Thread       * workers[FANG_TEXTURE_WORKERS];
+} Fang_Textures;
+
+/**
+ * Frees a previously loaded texture.
+**/
+static inline void
+Fang_FreeTexture(
+          Fang_Textures  * const textures,
+    const Fang_TextureId         id)
+{
+    assert(textures);
+    assert(id < FANG_NUM_TEXTURES);
+    assert(Fang_ImageValid(&textures->textures[id]));
+
+    Fang_EvictGlyphs(textures->textures[id].pixels);
+    Fang_FreeImage(&textures->textures[id]);
+
+    for (int i = 0; i < FANG_TEXTURE_LEVELS - 1; ++i)
+        Fang_FreeImage(&textures->mipmaps[id][i]);
+
+    atomic_store_explicit(
+        &textures->status[id], FANG_TEXTURESTATUS_UNLOADED, memory_order_relaxed
+    );
+}
+
+/**
+ * Generates the mipmap chain for a loaded texture.
+ *
+ * The texture may be a strip of square faces, in which case each face is
+ * reduced separately. Levels are generated until a face can not be halved any
+ * further or FANG_TEXTURE_LEVELS is reached.
+**/
+static inline void
+Fang_GenerateMipmaps(
+          Fang_Textures  * const textures,
+    const Fang_TextureId         id,
+    const int                    faces)
+{
+    assert(textures);
+    assert(id < FANG_NUM_TEXTURES);
+
+    const Fang_Image * source = &textures->textures[id];
+
+    for (int i = 0; i < FANG_TEXTURE_LEVELS - 1; ++i)
     {
-        const Info info = texture_info[id];
+        Fang_Image * const level = &textures->mipmaps[id][i];
 
-        if (info.path)
-        {
-            *result = Fang_LoadTGA(texture_info[id].path);
+        if (Fang_DownsampleImage(source, level, faces))
+            break;
 
-            if (!Fang_ImageValid(result))
-                return 1;
+        source = level;
+    }
+}
+
+/**
+ * Converts a loaded texture and all of its mipmaps into palettized images.
+ *
+ * Returns non-zero if any level could not be converted, levels which failed are
+ * left as full 32-bit images.
+**/
+static inline int
+Fang_PalettizeTexture(
+          Fang_Textures  * const textures,
+    const Fang_TextureId         id)
+{
+    assert(textures);
+    assert(id < FANG_NUM_TEXTURES);
+    assert(Fang_ImageValid(&textures->textures[id]));
+
+    int error = Fang_PalettizeImage(&textures->textures[id]);
+
+    for (int i = 0; i < FANG_TEXTURE_LEVELS - 1; ++i)
+    {
+        if (Fang_ImageValid(&textures->mipmaps[id][i]))
+            error |= Fang_PalettizeImage(&textures->mipmaps[id][i]);
+    }
+
+    return error;
+}
+
+/**
+ * Measures the spans of a loaded texture and all of its mipmaps.
+ *
+ * Returns non-zero if the spans of any level could not be allocated, which are
+ * then drawn without them.
+**/
+static inline int
+Fang_BuildTextureSpans(
+          Fang_Textures  * const textures,
+    const Fang_TextureId         id)
+{
+    assert(textures);
+    assert(id < FANG_NUM_TEXTURES);
+    assert(Fang_ImageValid(&textures->textures[id]));
+
+    int error = Fang_BuildImageSpans(&textures->textures[id]);
+
+    for (int i = 0; i < FANG_TEXTURE_LEVELS - 1; ++i)
+    {
+        if (Fang_ImageValid(&textures->mipmaps[id][i]))
+            error |= Fang_BuildImageSpans(&textures->mipmaps[id][i]);
+    }
+
+    return error;
+}
+
+/**
+ * Returns whether a packed image has the layout and storage that decoding the
+ * texture would have given it (see Fang_DecodeTexture()).
+ *
+ * The base image is the texture's full-size image, whose layout is shared by
+ * all of its mipmaps.
+**/
+static inline bool
+Fang_PackedImageMatches(
+    const Fang_Textures  * const textures,
+    const Fang_TextureId         id,
+    const Fang_Image     * const base,
+    const Fang_Image     * const image)
+{
+    assert(textures);
+    assert(id < FANG_NUM_TEXTURES);
+    assert(base);
+    assert(image);
+
+    const bool palettized = (
+        textures->storage == FANG_TEXTURESTORAGE_PALETTIZED
+    );
+
+    Fang_ImageLayout layout  = FANG_IMAGELAYOUT_ROWS;
+    bool             indexed = false;
+
+    switch (Fang_GetTextureInfo(id)->type)
+    {
+        case FANG_TEXTURETYPE_TILE:
+            layout = (textures->swizzled)
+                ? FANG_IMAGELAYOUT_SWIZZLED
+                : FANG_IMAGELAYOUT_COLUMNS;
+
+            indexed = palettized;
+            break;
+
+        case FANG_TEXTURETYPE_FLOOR:
+            if (textures->swizzled && Fang_CanSwizzleImage(base))
+                layout = FANG_IMAGELAYOUT_SWIZZLED;
+
+            indexed = palettized;
+            break;
+
+        case FANG_TEXTURETYPE_SPRITE:
+            indexed = palettized;
+            break;
+
+        default:
+            break;
+    }
+
+    return (
+        image->layout == layout
+     && !(image->flags & FANG_IMAGEFLAG_PALETTIZED) == !indexed
+    );
+}
+
+/**
+ * Returns whether the textures' asset pack holds a texture in the form that
+ * decoding it would give.
+**/
+static inline bool
+Fang_HasPackedTexture(
+    const Fang_Textures  * const textures,
+    const Fang_TextureId         id)
+{
+    assert(textures);
+    assert(id < FANG_NUM_TEXTURES);
+
+    const char * const path = Fang_GetTextureInfo(id)->path;
+
+    if (!textures->pack || !path)
+        return false;
+
+    Fang_Image image = {.pixels = NULL};
+
+    if (Fang_GetPackedImage(textures->pack, path, 0, &image))
+        return false;
+
+    return Fang_PackedImageMatches(textures, id, &image, &image);
+}
+
+/**
+ * Loads a texture and its mipmaps from the textures' asset pack, which must
+ * hold it (see Fang_HasPackedTexture()).
+ *
+ * The images point directly into the pack's data, so the pack must stay open
+ * for as long as the textures are loaded. Mipmaps stop at the first level which
+ * the pack does not hold in the texture's form. Returns non-zero if the spans
+ * of any level could not be allocated.
+**/
+static inline int
+Fang_LoadPackedTexture(
+          Fang_Textures  * const textures,
+    const Fang_TextureId         id)
+{
+    assert(textures);
+    assert(Fang_HasPackedTexture(textures, id));
+
+    const char * const path = Fang_GetTextureInfo(id)->path;
+
+    Fang_Image * const result = &textures->textures[id];
+
+    Fang_GetPackedImage(textures->pack, path, 0, result);
+
+    for (int i = 0; i < FANG_TEXTURE_LEVELS - 1; ++i)
+    {
+        Fang_Image * const level = &textures->mipmaps[id][i];
+
+        if (Fang_GetPackedImage(textures->pack, path, i + 1, level))
+            break;
+
+        if (!Fang_PackedImageMatches(textures, id, result, level))
+        {
+            *level = (Fang_Image){.pixels = NULL};
+            break;
         }
     }
 
-    switch (texture_info[id].type)
+    return Fang_BuildTextureSpans(textures, id);
+}
+
+/**
+ * Parses a texture's TGA file, taking it from the background read started for
+ * the texture if there is one (see Fang_LoadTexturesAsync()), otherwise
+ * mapping the file.
+**/
+static inline Fang_Image
+Fang_ReadTextureFile(
+          Fang_Textures  * const textures,
+    const Fang_TextureId         id)
+{
+    assert(textures);
+    assert(id < FANG_NUM_TEXTURES);
+
+    Fang_FileRequest * const request = textures->requests[id];
+
+    if (!request)
+        return Fang_LoadTGA(Fang_GetTextureInfo(id)->path);
+
+    textures->requests[id] = NULL;
+
+    Fang_File      file  = {.data = NULL};
+    Fang_FileError error = FANG_FILE_ERROR_NONE;
+
+    while (!Fang_PollFile(request, &file, &error))
+        Fang_WaitFile(request);
+
+    Fang_Image result = {.pixels = NULL};
+
+    if (error != FANG_FILE_ERROR_NONE)
+        return result;
+
+    result = Fang_ParseTGA(&file);
+    Fang_FreeFile(&file);
+    return result;
+}
+
+/**
+ * Decodes a texture from the game's resource directory into its images.
+ *
+ * If the texture has already been loaded, it is unloaded and then loaded again.
+ *
+ * When a texture is loaded, its attributes such as width, height, stride, etc.
+ * may be checked for validation.
+ *
+ * Textures are premultiplied by their alpha once loaded. Tile textures are also
+ * converted to column-major images so that drawing a column of a wall reads a
+ * contiguous run of texels, unless the textures are swizzled, in which case
+ * tile and floor textures are converted to swizzled images instead.
+ *
+ * Tile, floor, and sprite textures have their mipmaps generated here as well,
+ * and are palettized afterwards if the textures use palettized storage. The
+ * spans of every image are measured last.
+ *
+ * Textures found in the asset pack (if any) in the same form skip all of the
+ * above, as they are stored ready to be sampled, apart from their spans which
+ * are always measured when loaded.
+**/
+static inline int
+Fang_DecodeTexture(
+          Fang_Textures  * const textures,
+    const Fang_TextureId         id)
+{
+    assert(textures);
+    assert(id < FANG_NUM_TEXTURES);
+
+    Fang_Image * const result = &textures->textures[id];
+
+    int error = 0;
+
+    if (Fang_ImageValid(result))
+        Fang_FreeTexture(textures, id);
+
+    const Fang_TextureInfo * const info = Fang_GetTextureInfo(id);
+
+    if (info->path)
+    {
+        if (Fang_HasPackedTexture(textures, id))
+            return Fang_LoadPackedTexture(textures, id);
+
+        *result = Fang_ReadTextureFile(textures, id);
+
+        if (!Fang_ImageValid(result))
+            return 1;
+
+        Fang_PremultiplyImage(result);
+    }
+
+    switch (info->type)
     {
-        case TILE_TEXTURE:
+        case FANG_TEXTURETYPE_TILE:
             assert(result->width  == FANG_TEXTURE_SIZE * 6);
             assert(result->height == FANG_TEXTURE_SIZE);
+
+            if (Fang_ConvertImage(
+                    result,
+                    (textures->swizzled)
+                        ? FANG_IMAGELAYOUT_SWIZZLED
+                        : FANG_IMAGELAYOUT_COLUMNS))
+                return 1;
+
+            Fang_GenerateMipmaps(textures, id, 6);
+
+            if (textures->storage == FANG_TEXTURESTORAGE_PALETTIZED)
+                error = Fang_PalettizeTexture(textures, id);
+
+            break;
+
+        case FANG_TEXTURETYPE_FLOOR:
+        case FANG_TEXTURETYPE_SPRITE:
+            if (!Fang_ImageValid(result))
+                break;
+
+            if (info->type == FANG_TEXTURETYPE_FLOOR
+            &&  textures->swizzled
+            &&  Fang_CanSwizzleImage(result))
+            {
+                if (Fang_ConvertImage(result, FANG_IMAGELAYOUT_SWIZZLED))
+                    return 1;
+            }
+
+            Fang_GenerateMipmaps(textures, id, 1);
+
+            if (textures->storage == FANG_TEXTURESTORAGE_PALETTIZED)
+                error = Fang_PalettizeTexture(textures, id);
+
             break;
 
-        case FONT_TEXTURE:
+        case FANG_TEXTURETYPE_FONT:
             /* Fonts have one pixel barriers between each character */
             assert(result->width  == (FANG_FONT_WIDTH + 1) * (127 - '!'));
             assert(result->height == FANG_FONT_HEIGHT);
@@ -205,7 +577,40 @@ Fang_LoadTexture(
             break;
     }
 
-    return 0;
+    if (Fang_ImageValid(result))
+        error |= Fang_BuildTextureSpans(textures, id);
+
+    return error;
+}
+
+/**
+ * Loads a texture on the calling thread and publishes it.
+ *
+ * If the texture has already been loaded, it is unloaded and then loaded again.
+ * This can be used for refreshing textures that may have changed on disk. The
+ * texture must not be queued for background loading.
+**/
+static inline int
+Fang_LoadTexture(
+          Fang_Textures  * const textures,
+    const Fang_TextureId         id)
+{
+    assert(textures);
+    assert(id < FANG_NUM_TEXTURES);
+
+    atomic_store_explicit(
+        &textures->status[id], FANG_TEXTURESTATUS_LOADING, memory_order_relaxed
+    );
+
+    const int error = Fang_DecodeTexture(textures, id);
+
+    atomic_store_explicit(
+        &textures->status[id],
+        (error) ? FANG_TEXTURESTATUS_FAILED : FANG_TEXTURESTATUS_READY,
+        memory_order_release
+    );
+
+    return error;
 }
 
 /**
@@ -228,7 +633,188 @@ Fang_LoadTextures(
 }
 
 /**
- * Unloads all textures currently loaded in the texture set.
+ * The entry point of the texture loading workers.
+ *
+ * Each worker repeatedly claims the queued texture with the highest priority,
+ * decodes it, and publishes the result. Workers exit once nothing is queued.
+**/
+static int
+Fang_TextureWorker(
+    void * const data)
+{
+    Fang_Textures * const textures = data;
+
+    assert(textures);
+
+    while (true)
+    {
+        Fang_TextureId best          = FANG_TEXTURE_NONE;
+        uint32_t       best_priority = 0;
+
+        for (Fang_TextureId i = 0; i < FANG_NUM_TEXTURES; ++i)
+        {
+            const int status = atomic_load_explicit(
+                &textures->status[i], memory_order_relaxed
+            );
+
+            if (status != FANG_TEXTURESTATUS_QUEUED)
+                continue;
+
+            const uint32_t priority = atomic_load_explicit(
+                &textures->priority[i], memory_order_relaxed
+            );
+
+            if (best == FANG_TEXTURE_NONE || priority > best_priority)
+            {
+                best          = i;
+                best_priority = priority;
+            }
+        }
+
+        if (best == FANG_TEXTURE_NONE)
+            return 0;
+
+        /* Another worker may have claimed the texture in the meantime */
+        int expected = FANG_TEXTURESTATUS_QUEUED;
+
+        if (!atomic_compare_exchange_strong_explicit(
+                &textures->status[best],
+                &expected,
+                FANG_TEXTURESTATUS_LOADING,
+                memory_order_acquire,
+                memory_order_relaxed))
+            continue;
+
+        const int error = Fang_DecodeTexture(textures, best);
+
+        atomic_store_explicit(
+            &textures->status[best],
+            (error) ? FANG_TEXTURESTATUS_FAILED : FANG_TEXTURESTATUS_READY,
+            memory_order_release
+        );
+    }
+}
+
+/**
+ * Waits for any background texture loading to finish.
+**/
+static inline void
+Fang_WaitTextures(
+    Fang_Textures * const textures)
+{
+    assert(textures);
+
+    for (int i = 0; i < FANG_TEXTURE_WORKERS; ++i)
+    {
+        if (textures->workers[i])
+        {
+            Fang_JoinThread(textures->workers[i]);
+            textures->workers[i] = NULL;
+        }
+    }
+}
+
+/**
+ * Starts loading all texture types in the background.
+ *
+ * Textures are unloaded and queued, then decoded by worker threads. The files
+ * of textures which aren't taken from the asset pack are all requested up
+ * front, so that they are read while the workers decode the textures before
+ * them. Until a texture is published Fang_GetTexture() returns NULL for it, so
+ * renderers draw their fallbacks in the meantime. If no workers could be
+ * started the textures are loaded on the calling thread instead.
+**/
+static inline void
+Fang_LoadTexturesAsync(
+    Fang_Textures * const textures)
+{
+    assert(textures);
+
+    Fang_WaitTextures(textures);
+
+    for (Fang_TextureId i = 0; i < FANG_NUM_TEXTURES; ++i)
+    {
+        if (Fang_ImageValid(&textures->textures[i]))
+            Fang_FreeTexture(textures, i);
+
+        const char * const path = Fang_GetTextureInfo(i)->path;
+
+        /* Textures whose reads can't be started map their files instead */
+        if (path
+        &&  !textures->requests[i]
+        &&  !Fang_HasPackedTexture(textures, i))
+        {
+            textures->requests[i] = Fang_RequestFile(path);
+        }
+
+        atomic_store_explicit(&textures->priority[i], 0, memory_order_relaxed);
+        atomic_store_explicit(
+            &textures->status[i], FANG_TEXTURESTATUS_QUEUED, memory_order_release
+        );
+    }
+
+    int started = 0;
+
+    for (int i = 0; i < FANG_TEXTURE_WORKERS; ++i)
+    {
+        textures->workers[i] = Fang_CreateThread(Fang_TextureWorker, textures);
+
+        if (textures->workers[i])
+            started++;
+    }
+
+    if (!started)
+        Fang_TextureWorker(textures);
+}
+
+/**
+ * Raises the loading priority of a queued texture.
+ *
+ * Callers should pass an increasing value (such as the current time) for the
+ * textures referenced by the current view, so that the most recently seen
+ * textures are loaded first.
+**/
+static inline void
+Fang_RequestTexture(
+          Fang_Textures  * const textures,
+    const Fang_TextureId         id,
+    const uint32_t               priority)
+{
+    assert(textures);
+
+    if (id >= FANG_NUM_TEXTURES)
+        return;
+
+    atomic_store_explicit(&textures->priority[id], priority, memory_order_relaxed);
+}
+
+/**
+ * Returns whether all textures have finished loading, successfully or not.
+**/
+static inline bool
+Fang_TexturesLoaded(
+    const Fang_Textures * const textures)
+{
+    assert(textures);
+
+    for (Fang_TextureId i = 0; i < FANG_NUM_TEXTURES; ++i)
+    {
+        const int status = atomic_load_explicit(
+            &textures->status[i], memory_order_acquire
+        );
+
+        if (status == FANG_TEXTURESTATUS_QUEUED
+        ||  status == FANG_TEXTURESTATUS_LOADING)
+            return false;
+    }
+
+    return true;
+}
+
+/**
+ * Unloads all textures currently loaded in the texture set, waiting for any
+ * background loading to finish first. Any file requests which were never
+ * taken are cancelled.
 **/
 static inline void
 Fang_FreeTextures(
@@ -236,16 +822,26 @@ Fang_FreeTextures(
 {
     assert(textures);
 
+    Fang_WaitTextures(textures);
+
     for (Fang_TextureId i = 0; i < FANG_NUM_TEXTURES; ++i)
+    {
+        if (textures->requests[i])
+        {
+            Fang_CancelFile(textures->requests[i]);
+            textures->requests[i] = NULL;
+        }
+
         if (textures->textures[i].pixels)
             Fang_FreeTexture(textures, i);
+    }
 }
 
 /**
  * Retrieves a texture from the loaded textures.
  *
- * If the id is FANG_TEXTURE_NONE or the target image is invalid this will
- * return NULL.
+ * If the id is FANG_TEXTURE_NONE, the texture has not finished loading, or the
+ * target image is invalid this will return NULL.
 **/
 static inline const Fang_Image *
 Fang_GetTexture(
@@ -259,6 +855,13 @@ Fang_GetTexture(
 
     assert(id < FANG_NUM_TEXTURES);
 
+    const int status = atomic_load_explicit(
+        &textures->status[id], memory_order_acquire
+    );
+
+    if (status != FANG_TEXTURESTATUS_READY)
+        return NULL;
+
     const Fang_Image * const result = &textures->textures[id];
 
     if (!Fang_ImageValid(result))
@@ -266,3 +869,56 @@ Fang_GetTexture(
 
     return result;
 }
+
+/**
+ * Retrieves a mipmap level of a texture from the loaded textures.
+ *
+ * Level 0 is the full-size texture. If the texture does not have the requested
+ * level, the smallest level it does have is returned instead.
+ *
+ * If the id is FANG_TEXTURE_NONE or the target image is invalid this will
+ * return NULL.
+**/
+static inline const Fang_Image *
+Fang_GetTextureLevel(
+    const Fang_Textures  * const textures,
+    const Fang_TextureId         id,
+          int                    level)
+{
+    assert(textures);
+
+    const Fang_Image * const result = Fang_GetTexture(textures, id);
+
+    if (!result || level <= 0)
+        return result;
+
+    level = min(level, FANG_TEXTURE_LEVELS - 1);
+
+    while (level > 0 && !Fang_ImageValid(&textures->mipmaps[id][level - 1]))
+        level--;
+
+    return (level) ? &textures->mipmaps[id][level - 1] : result;
+}
+
+/**
+ * Returns the mipmap level to use for a surface given how many texels of the
+ * full-size texture are covered by each pixel drawn.
+ *
+ * This is the floor of the base-2 logarithm of the texel ratio, so a surface is
+ * only reduced once a level's texels are no smaller than a pixel.
+**/
+static inline int
+Fang_GetMipmapLevel(
+    const float texels_per_pixel)
+{
+    int   result = 0;
+    float ratio  = texels_per_pixel;
+
+    while (ratio >= 2.0f && result < FANG_TEXTURE_LEVELS - 1)
+    {
+        ratio *= 0.5f;
+        result++;
+    }
+
+    return result;
+}
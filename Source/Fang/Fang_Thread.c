@@ -0,0 +1,40 @@
+// Copyright (C) 2021  Antonio Lassandro
+
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+
+// You should have received a copy of the GNU General Public License along
+// with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+/**
+ * An opaque handle to a thread created by the platform layer.
+**/
+typedef struct Fang_Thread Fang_Thread;
+
+/**
+ * The entry point of a thread, the return value is given back when the thread
+ * is joined.
+**/
+typedef int (*Fang_ThreadFunc)(void *);
+
+/**
+ * Starts a new thread running the given function.
+ *
+ * Returns NULL if the thread could not be created.
+**/
+FANG_PLATFORM_CALL
+Fang_Thread * Fang_CreateThread(Fang_ThreadFunc, void * /* data */);
+
+/**
+ * Waits for a thread to finish and releases its handle, returning the result
+ * of the thread's function.
+**/
+FANG_PLATFORM_CALL
+int Fang_JoinThread(Fang_Thread *);
@@ -17,17 +17,51 @@
 
 #include <SDL2/SDL.h>
 
+#if defined(__unix__) || defined(__APPLE__)
+  #define FANGSDL_POSIX
+
+  #include <aio.h>
+  #include <errno.h>
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
 #include "FangSDL_File.c"
 #include "FangSDL_Input.c"
+#include "FangSDL_Thread.c"
 
 Fang_Input           input;
 SDL_GameController * controller;
 
-int Fang_Main(int argc, char** argv)
+/**
+ * Applies the render settings given on the command line.
+ *
+ * "--interlaced" draws interlaced frames and "--deferred" draws deferred
+ * frames. Unknown arguments are ignored. Interlacing can also be toggled while
+ * the game runs with F1 (see FangSDL_HandleKeyboardEvent()).
+**/
+static inline void
+FangSDL_ReadSettings(
+    const int                         argc,
+          char               ** const argv,
+          Fang_RenderSettings * const settings)
 {
-    (void)argc;
-    (void)argv;
+    SDL_assert(argv || !argc);
+    SDL_assert(settings);
 
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!SDL_strcmp(argv[i], "--interlaced"))
+            settings->interlaced = true;
+        else if (!SDL_strcmp(argv[i], "--deferred"))
+            settings->deferred = true;
+    }
+}
+
+int Fang_Main(int argc, char** argv)
+{
     {
         SDL_version version;
         SDL_VERSION(&version);
@@ -85,6 +119,12 @@ int Fang_Main(int argc, char** argv)
     FangSDL_InitInput(&input, &controller);
     Fang_Init();
 
+    {
+        Fang_RenderSettings settings = *Fang_GetRenderSettings();
+        FangSDL_ReadSettings(argc, argv, &settings);
+        Fang_SetRenderSettings(&settings);
+    }
+
     while (!SDL_QuitRequested())
     {
         FangSDL_PollEvents(&input, &controller);
@@ -93,9 +133,14 @@ int Fang_Main(int argc, char** argv)
         SDL_RenderClear(renderer);
 
         const Fang_Image * const frame = Fang_Update(&input, SDL_GetTicks());
-        SDL_assert(Fang_ImageValid(frame));
 
-        SDL_UpdateTexture(target, NULL, frame->pixels, frame->pitch);
+        /* The target still holds the last frame if nothing has changed */
+        if (frame)
+        {
+            SDL_assert(Fang_ImageValid(frame));
+            SDL_UpdateTexture(target, NULL, frame->pixels, frame->pitch);
+        }
+
         SDL_RenderCopy(renderer, target, NULL, NULL);
         SDL_RenderPresent(renderer);
     }
@@ -103,6 +148,7 @@ int Fang_Main(int argc, char** argv)
     FangSDL_DisconnectController(&controller);
 
     Fang_Quit();
+    FangSDL_FreeBasePath();
 
 Error_Texture:
     SDL_DestroyTexture(target);
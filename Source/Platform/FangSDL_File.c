@@ -13,22 +13,73 @@
 // You should have received a copy of the GNU General Public License along
 // with this program.  If not, see <http://www.gnu.org/licenses/>.
 
-static inline char *
+/**
+ * The resource directory, resolved once on first use and shared by all of the
+ * file calls (which may be made from worker threads).
+**/
+static void * fangsdl_base_path = NULL;
+
+enum {
+    FANGSDL_MAX_PATH = 1024,
+};
+
+static inline const char *
+FangSDL_GetBasePath(void)
+{
+    const char * const base_path = SDL_AtomicGetPtr(&fangsdl_base_path);
+
+    if (base_path)
+        return base_path;
+
+    char * const result = SDL_GetBasePath();
+
+    if (!result)
+        return NULL;
+
+    /* Another thread may have resolved the path first */
+    if (!SDL_AtomicCASPtr(&fangsdl_base_path, NULL, result))
+    {
+        SDL_free(result);
+        return SDL_AtomicGetPtr(&fangsdl_base_path);
+    }
+
+    return result;
+}
+
+/**
+ * Frees the cached resource directory, this should only be called once all
+ * file calls have finished.
+**/
+static inline void
+FangSDL_FreeBasePath(void)
+{
+    SDL_free(SDL_AtomicSetPtr(&fangsdl_base_path, NULL));
+}
+
+/**
+ * Writes the full path of a resource into the given buffer.
+ *
+ * Returns false if the resource directory is unknown or the path does not fit.
+**/
+static inline bool
 FangSDL_GetResourcePath(
-    const char * const filename)
+    const char   * const filename,
+          char   * const buffer,
+    const size_t         size)
 {
     SDL_assert(filename);
+    SDL_assert(buffer);
+    SDL_assert(size);
+
+    const char * const base_path = FangSDL_GetBasePath();
 
-    char * const base_path = SDL_GetBasePath();
-    const size_t full_len  = SDL_strlen(base_path) + SDL_strlen(filename);
-    char * const full_path = SDL_malloc(sizeof(char) * full_len + 1);
-    full_path[full_len] = '\0';
+    if (!base_path)
+        return false;
 
-    SDL_strlcpy(full_path, base_path, full_len + 1);
-    SDL_strlcat(full_path,  filename, full_len + 1);
+    if (SDL_strlcpy(buffer, base_path, size) >= size)
+        return false;
 
-    SDL_free(base_path);
-    return full_path;
+    return SDL_strlcat(buffer, filename, size) < size;
 }
 
 Fang_FileError
@@ -45,8 +96,8 @@ Fang_LoadFile(
 
     SDL_RWops * file = NULL;
 
-    char * const full_path = FangSDL_GetResourcePath(filename);
-    if (!full_path)
+    char full_path[FANGSDL_MAX_PATH];
+    if (!FangSDL_GetResourcePath(filename, full_path, sizeof(full_path)))
         goto Error_CantOpen;
 
     file = SDL_RWFromFile(full_path, "rb");
@@ -74,7 +125,6 @@ Fang_LoadFile(
         goto Error_CantRead;
 
     SDL_RWclose(file);
-    SDL_free(full_path);
     return FANG_FILE_ERROR_NONE;
 
 Error_CantOpen:
@@ -97,7 +147,6 @@ Error:
     if (file)
         SDL_RWclose(file);
 
-    SDL_free(full_path);
     SDL_free(result->data);
 
     result->data = NULL;
@@ -117,3 +166,282 @@ Fang_FreeFile(
     file->data = NULL;
     file->size = 0;
 }
+
+#if defined(FANGSDL_POSIX)
+
+Fang_FileError
+Fang_MapFile(
+    const char      * const filename,
+          Fang_File * const result)
+{
+    SDL_assert(filename);
+    SDL_assert(result);
+    SDL_assert(!result->data);
+    SDL_assert(!result->size);
+
+    Fang_FileError error = FANG_FILE_ERROR_NONE;
+
+    int fd = -1;
+
+    char full_path[FANGSDL_MAX_PATH];
+    if (!FangSDL_GetResourcePath(filename, full_path, sizeof(full_path)))
+        goto Error_CantOpen;
+
+    fd = open(full_path, O_RDONLY);
+    if (fd < 0)
+        goto Error_CantOpen;
+
+    struct stat info;
+    if (fstat(fd, &info) || info.st_size <= 0)
+        goto Error_CantStat;
+
+    void * const data = mmap(
+        NULL,
+        (size_t)info.st_size,
+        PROT_READ,
+        MAP_PRIVATE,
+        fd,
+        0
+    );
+
+    if (data == MAP_FAILED)
+        goto Error_CantRead;
+
+    /* The mapping stays valid after the descriptor is closed */
+    close(fd);
+
+    result->data = data;
+    result->size = (size_t)info.st_size;
+    return FANG_FILE_ERROR_NONE;
+
+Error_CantOpen:
+    error = FANG_FILE_ERROR_CANT_OPEN;
+    goto Error;
+
+Error_CantStat:
+    error = FANG_FILE_ERROR_UNKNOWN_SIZE;
+    goto Error;
+
+Error_CantRead:
+    error = FANG_FILE_ERROR_BAD_READ;
+    goto Error;
+
+Error:
+    if (fd >= 0)
+        close(fd);
+
+    return error;
+}
+
+void
+Fang_UnmapFile(
+    Fang_File * const file)
+{
+    SDL_assert(file);
+    SDL_assert(file->data);
+    SDL_assert(file->size);
+
+    munmap(file->data, file->size);
+    file->data = NULL;
+    file->size = 0;
+}
+
+struct Fang_FileRequest {
+    struct aiocb   control;
+    int            fd;
+    void         * data;
+    size_t         size;
+};
+
+Fang_FileRequest *
+Fang_RequestFile(
+    const char * const filename)
+{
+    SDL_assert(filename);
+
+    char full_path[FANGSDL_MAX_PATH];
+    if (!FangSDL_GetResourcePath(filename, full_path, sizeof(full_path)))
+        return NULL;
+
+    Fang_FileRequest * const request = SDL_calloc(1, sizeof(Fang_FileRequest));
+    if (!request)
+        return NULL;
+
+    request->fd = open(full_path, O_RDONLY);
+    if (request->fd < 0)
+        goto Error_CantOpen;
+
+    struct stat info;
+    if (fstat(request->fd, &info) || info.st_size <= 0)
+        goto Error_CantRead;
+
+    request->size = (size_t)info.st_size;
+    request->data = SDL_malloc(request->size);
+
+    if (!request->data)
+        goto Error_CantRead;
+
+    request->control.aio_fildes = request->fd;
+    request->control.aio_buf    = request->data;
+    request->control.aio_nbytes = request->size;
+    request->control.aio_offset = 0;
+
+    if (aio_read(&request->control))
+        goto Error_CantRead;
+
+    return request;
+
+Error_CantRead:
+    SDL_free(request->data);
+    close(request->fd);
+
+Error_CantOpen:
+    SDL_free(request);
+    return NULL;
+}
+
+bool
+Fang_PollFile(
+    Fang_FileRequest * const request,
+    Fang_File        * const result,
+    Fang_FileError   * const error)
+{
+    SDL_assert(request);
+    SDL_assert(result);
+    SDL_assert(error);
+
+    const int status = aio_error(&request->control);
+
+    if (status == EINPROGRESS)
+        return false;
+
+    const ssize_t num_read = aio_return(&request->control);
+
+    if (status || num_read < 0 || (size_t)num_read != request->size)
+    {
+        *error = FANG_FILE_ERROR_BAD_READ;
+        SDL_free(request->data);
+    }
+    else
+    {
+        *error = FANG_FILE_ERROR_NONE;
+        result->data = request->data;
+        result->size = request->size;
+    }
+
+    close(request->fd);
+    SDL_free(request);
+    return true;
+}
+
+void
+Fang_WaitFile(
+    Fang_FileRequest * const request)
+{
+    SDL_assert(request);
+
+    const struct aiocb * const list[1] = {&request->control};
+
+    while (aio_error(&request->control) == EINPROGRESS)
+        aio_suspend(list, 1, NULL);
+}
+
+void
+Fang_CancelFile(
+    Fang_FileRequest * const request)
+{
+    SDL_assert(request);
+
+    /* The buffer may still be written to until the read has stopped */
+    if (aio_cancel(request->fd, &request->control) == AIO_NOTCANCELED)
+    {
+        const struct aiocb * const list[1] = {&request->control};
+
+        while (aio_error(&request->control) == EINPROGRESS)
+            aio_suspend(list, 1, NULL);
+    }
+
+    aio_return(&request->control);
+    close(request->fd);
+    SDL_free(request->data);
+    SDL_free(request);
+}
+
+#else /* !FANGSDL_POSIX */
+
+/* Without POSIX mapping, files are read into memory and freed on unmap */
+Fang_FileError
+Fang_MapFile(
+    const char      * const filename,
+          Fang_File * const result)
+{
+    return Fang_LoadFile(filename, result);
+}
+
+void
+Fang_UnmapFile(
+    Fang_File * const file)
+{
+    Fang_FreeFile(file);
+}
+
+/* Without POSIX asynchronous I/O, files are read when requested */
+struct Fang_FileRequest {
+    Fang_File      file;
+    Fang_FileError error;
+};
+
+Fang_FileRequest *
+Fang_RequestFile(
+    const char * const filename)
+{
+    SDL_assert(filename);
+
+    Fang_FileRequest * const request = SDL_calloc(1, sizeof(Fang_FileRequest));
+    if (!request)
+        return NULL;
+
+    request->error = Fang_LoadFile(filename, &request->file);
+    return request;
+}
+
+bool
+Fang_PollFile(
+    Fang_FileRequest * const request,
+    Fang_File        * const result,
+    Fang_FileError   * const error)
+{
+    SDL_assert(request);
+    SDL_assert(result);
+    SDL_assert(error);
+
+    *error = request->error;
+
+    if (request->error == FANG_FILE_ERROR_NONE)
+        *result = request->file;
+
+    SDL_free(request);
+    return true;
+}
+
+void
+Fang_WaitFile(
+    Fang_FileRequest * const request)
+{
+    SDL_assert(request);
+    (void)request;
+}
+
+void
+Fang_CancelFile(
+    Fang_FileRequest * const request)
+{
+    SDL_assert(request);
+
+    if (request->file.data)
+        Fang_FreeFile(&request->file);
+
+    SDL_free(request);
+}
+
+#endif /* FANGSDL_POSIX */
@@ -183,9 +183,25 @@ FangSDL_HandleKeyboardEvent(
     if (event->repeat)
         return;
 
+    SDL_Keycode sym = event->keysym.sym;
+
+    /* Render settings aren't part of the game's input, so they're changed as
+       soon as their keys are pressed
+    */
+    if (sym == SDLK_F1)
+    {
+        if (event->state == SDL_PRESSED)
+        {
+            Fang_RenderSettings settings = *Fang_GetRenderSettings();
+            settings.interlaced = !settings.interlaced;
+            Fang_SetRenderSettings(&settings);
+        }
+
+        return;
+    }
+
     Fang_InputButton * button = NULL;
 
-    SDL_Keycode sym = event->keysym.sym;
     if (sym == SDLK_w)
         button = &input->controller.direction_up;
     else if (sym == SDLK_s)
@@ -0,0 +1,35 @@
+// Copyright (C) 2021  Antonio Lassandro
+
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+
+// You should have received a copy of the GNU General Public License along
+// with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+Fang_Thread *
+Fang_CreateThread(
+    const Fang_ThreadFunc         func,
+          void          * const data)
+{
+    SDL_assert(func);
+
+    return (Fang_Thread*)SDL_CreateThread(func, FANG_TITLE, data);
+}
+
+int
+Fang_JoinThread(
+    Fang_Thread * const thread)
+{
+    SDL_assert(thread);
+
+    int result = 0;
+    SDL_WaitThread((SDL_Thread*)thread, &result);
+    return result;
+}
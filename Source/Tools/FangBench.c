@@ -0,0 +1,404 @@
+// Copyright (C) 2021  Antonio Lassandro
+
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+
+// You should have received a copy of the GNU General Public License along
+// with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+/**
+ * Offline benchmark for the passes which draw the world.
+ *
+ * Usage: FangBench <resource directory>
+ *
+ * The game is set up the same way it is at startup, then the world is drawn
+ * from FANGBENCH_ANGLES directions around the starting position into a
+ * framebuffer with each depth layout (see Fang_DepthLayout), and with separate
+ * depth as deferred frames (see Fang_VisibilityBuffer) and as interlaced frames
+ * (see Fang_ReconstructFramebuffer()). Every pass is timed on its own over the
+ * whole width of the framebuffer, and the fastest of FANGBENCH_REPS runs of
+ * each pass in each direction is averaged.
+**/
+
+#include <time.h>
+
+#include "../Fang/Fang.c"
+#include "FangTools_Platform.c"
+
+enum {
+    FANGBENCH_ANGLES = 8,
+    FANGBENCH_REPS   = 50,
+};
+
+/**
+ * The passes which are timed, in the order they are drawn.
+**/
+typedef enum FangBench_Pass {
+    FANGBENCH_PASS_CLEAR,
+    FANGBENCH_PASS_SKYBOX,
+    FANGBENCH_PASS_FLOOR,
+    FANGBENCH_PASS_TILES,
+    FANGBENCH_PASS_RESOLVE,
+    FANGBENCH_PASS_SPRITES,
+    FANGBENCH_PASS_FOG,
+    FANGBENCH_PASS_RECONSTRUCT,
+
+    FANGBENCH_NUM_PASSES,
+} FangBench_Pass;
+
+static const char * const FangBench_PassNames[FANGBENCH_NUM_PASSES] = {
+    [FANGBENCH_PASS_CLEAR]       = "clear",
+    [FANGBENCH_PASS_SKYBOX]      = "skybox",
+    [FANGBENCH_PASS_FLOOR]       = "floor",
+    [FANGBENCH_PASS_TILES]       = "tiles",
+    [FANGBENCH_PASS_RESOLVE]     = "resolve",
+    [FANGBENCH_PASS_SPRITES]     = "sprites",
+    [FANGBENCH_PASS_FOG]         = "fog",
+    [FANGBENCH_PASS_RECONSTRUCT] = "reconstruct",
+};
+
+/**
+ * A way of drawing the world which is timed.
+**/
+typedef struct FangBench_Config {
+    const char       * name;
+    Fang_DepthLayout   layout;
+    bool               deferred;
+    bool               interlaced;
+} FangBench_Config;
+
+/**
+ * Draws one pass of the world over the whole width of the game's framebuffer,
+ * from the rays last cast for its camera. Passes rely on the ones before them
+ * having been drawn.
+ *
+ * Deferred frames are drawn with the game's visibility buffer, the resolve
+ * pass also drawing the translucent tiles. Otherwise it draws nothing.
+ *
+ * Interlaced frames only draw the framebuffer's current field, the reconstruct
+ * pass filling in the other one from the game's history and then copying the
+ * frame into the history. Otherwise it draws nothing.
+**/
+static inline void
+FangBench_DrawPass(
+    const FangBench_Pass           pass,
+    const FangBench_Config * const config)
+{
+    assert(config);
+
+    Fang_Framebuffer * const framebuf = &gamestate.framebuffer;
+
+    Fang_VisibilityBuffer * const visibility = (config->deferred)
+        ? &gamestate.visibility
+        : NULL;
+
+    const int width = framebuf->color.width;
+
+    switch (pass)
+    {
+        case FANGBENCH_PASS_CLEAR:
+            Fang_ClearFramebufferColumns(framebuf, 0, width);
+            framebuf->state.current_depth = FLT_MAX;
+            framebuf->state.enable_depth  = true;
+            break;
+
+        case FANGBENCH_PASS_SKYBOX:
+            Fang_DrawMapSkybox(
+                framebuf,
+                &gamestate.camera,
+                &gamestate.map,
+                Fang_GetTexture(&gamestate.textures, gamestate.map.skybox),
+                0,
+                width
+            );
+            break;
+
+        case FANGBENCH_PASS_FLOOR:
+            Fang_GetFloorRows(
+                framebuf, &gamestate.camera, gamestate.floor_rows
+            );
+
+            Fang_DrawMapFloor(
+                framebuf,
+                &gamestate.map,
+                &gamestate.textures,
+                gamestate.floor_rows,
+                visibility,
+                0,
+                width
+            );
+            break;
+
+        case FANGBENCH_PASS_TILES:
+            Fang_DrawMapTiles(
+                framebuf,
+                &gamestate.settings,
+                &gamestate.camera,
+                &gamestate.textures,
+                &gamestate.map,
+                gamestate.raycast,
+                gamestate.occluders,
+                visibility,
+                (visibility) ? FANG_TILEPASS_OPAQUE : FANG_TILEPASS_ALL,
+                (size_t)FANG_WINDOW_SIZE,
+                0,
+                width
+            );
+            break;
+
+        case FANGBENCH_PASS_RESOLVE:
+            if (!visibility)
+                break;
+
+            Fang_ResolveVisibility(framebuf, visibility, 0, width);
+
+            Fang_DrawMapTiles(
+                framebuf,
+                &gamestate.settings,
+                &gamestate.camera,
+                &gamestate.textures,
+                &gamestate.map,
+                gamestate.raycast,
+                gamestate.occluders,
+                visibility,
+                FANG_TILEPASS_TRANSLUCENT,
+                (size_t)FANG_WINDOW_SIZE,
+                0,
+                width
+            );
+            break;
+
+        case FANGBENCH_PASS_SPRITES:
+        {
+            const size_t sprite_count = Fang_GatherSprites(
+                framebuf,
+                &gamestate.camera,
+                &gamestate.textures,
+                &gamestate.map,
+                &gamestate.entities,
+                gamestate.sprites
+            );
+
+            Fang_DrawSprites(
+                framebuf,
+                gamestate.sprites,
+                sprite_count,
+                gamestate.occluders,
+                (size_t)FANG_WINDOW_SIZE,
+                0,
+                width
+            );
+            break;
+        }
+
+        case FANGBENCH_PASS_FOG:
+            Fang_ShadeFramebuffer(
+                framebuf,
+                &gamestate.map.fog,
+                gamestate.map.fog_distance,
+                0,
+                width
+            );
+            break;
+
+        case FANGBENCH_PASS_RECONSTRUCT:
+            if (!config->interlaced)
+                break;
+
+            Fang_ReconstructFramebuffer(
+                framebuf,
+                &gamestate.history,
+                &gamestate.camera,
+                &gamestate.history_camera
+            );
+
+            Fang_CopyFramebuffer(&gamestate.history, framebuf);
+            gamestate.history_camera = gamestate.camera;
+            gamestate.history_valid  = true;
+            break;
+
+        default:
+            assert(false);
+            break;
+    }
+}
+
+/**
+ * Times each pass in every direction around the camera, adding the average of
+ * their fastest times (in microseconds) to the given results.
+**/
+static inline void
+FangBench_TimePasses(
+          double           * const results,
+    const FangBench_Config * const config)
+{
+    assert(results);
+    assert(config);
+
+    Fang_FrameState * const state = &gamestate.framebuffer.state;
+
+    for (int angle = 0; angle < FANGBENCH_ANGLES; ++angle)
+    {
+        Fang_CastRays(
+            &gamestate.camera,
+            &gamestate.map.chunks,
+            gamestate.raycast,
+            (size_t)FANG_WINDOW_SIZE,
+            (size_t)max(gamestate.settings.ray_step, 1)
+        );
+
+        double best[FANGBENCH_NUM_PASSES];
+
+        for (int pass = 0; pass < FANGBENCH_NUM_PASSES; ++pass)
+            best[pass] = DBL_MAX;
+
+        for (int rep = 0; rep < FANGBENCH_REPS; ++rep)
+        {
+            /* As in the game, fields alternate once there is a history */
+            state->enable_interlace = gamestate.history_valid;
+            state->field            = (state->enable_interlace)
+                ? !state->field
+                : 0;
+
+            for (int pass = 0; pass < FANGBENCH_NUM_PASSES; ++pass)
+            {
+                const clock_t start = clock();
+                FangBench_DrawPass((FangBench_Pass)pass, config);
+                const clock_t end = clock();
+
+                best[pass] = min(
+                    best[pass],
+                    (double)(end - start) * 1000000.0 / CLOCKS_PER_SEC
+                );
+            }
+        }
+
+        for (int pass = 0; pass < FANGBENCH_NUM_PASSES; ++pass)
+            results[pass] += best[pass] / FANGBENCH_ANGLES;
+
+        /* An eighth of a turn */
+        Fang_RotateCamera(&gamestate.camera, atanf(1.0f), 0.0f);
+    }
+}
+
+int main(int argc, char ** argv)
+{
+    if (argc != 2)
+    {
+        fprintf(stderr, "Usage: %s <resources>\n", argv[0]);
+        return 1;
+    }
+
+    resource_dir = argv[1];
+
+    Fang_Init();
+
+    /* The camera is placed at the player's eyes, as it is once the game runs */
+    const Fang_Entity * const player = Fang_GetEntity(
+        &gamestate.entities, gamestate.player
+    );
+
+    if (player)
+    {
+        gamestate.camera.pos = (Fang_Vec3){
+            .x = player->body.pos.x,
+            .y = player->body.pos.y,
+            .z = player->body.pos.z + player->body.height,
+        };
+    }
+
+    Fang_UpdateEntityLocations(&gamestate.entities, &gamestate.map.chunks);
+
+    static const FangBench_Config configs[] = {
+        {"separate",    FANG_DEPTHLAYOUT_SEPARATE,    false, false},
+        {"interleaved", FANG_DEPTHLAYOUT_INTERLEAVED, false, false},
+        {"deferred",    FANG_DEPTHLAYOUT_SEPARATE,    true,  false},
+        {"interlaced",  FANG_DEPTHLAYOUT_SEPARATE,    false, true},
+    };
+
+    enum {
+        NUM_CONFIGS = sizeof(configs) / sizeof(configs[0]),
+    };
+
+    double results[NUM_CONFIGS][FANGBENCH_NUM_PASSES] = {{0}};
+
+    for (size_t i = 0; i < NUM_CONFIGS; ++i)
+    {
+        Fang_FreeFramebuffer(&gamestate.framebuffer);
+        Fang_FreeVisibilityBuffer(&gamestate.visibility);
+        Fang_FreeFramebuffer(&gamestate.history);
+        gamestate.history_valid = false;
+
+        if (Fang_AllocFramebuffer(
+                &gamestate.framebuffer,
+                FANG_WINDOW_SIZE,
+                FANG_WINDOW_SIZE,
+                configs[i].layout,
+                FANG_IMAGELAYOUT_ROWS))
+        {
+            fprintf(stderr, "Could not allocate the framebuffer\n");
+            return 1;
+        }
+
+        if (configs[i].deferred
+        &&  Fang_AllocVisibilityBuffer(
+                &gamestate.visibility, &gamestate.framebuffer))
+        {
+            fprintf(stderr, "Could not allocate the visibility buffer\n");
+            return 1;
+        }
+
+        if (configs[i].interlaced
+        &&  Fang_AllocFramebuffer(
+                &gamestate.history,
+                FANG_WINDOW_SIZE,
+                FANG_WINDOW_SIZE,
+                configs[i].layout,
+                FANG_IMAGELAYOUT_ROWS))
+        {
+            fprintf(stderr, "Could not allocate the history\n");
+            return 1;
+        }
+
+        FangBench_TimePasses(results[i], &configs[i]);
+    }
+
+    printf("%-12s", "pass");
+
+    for (size_t i = 0; i < NUM_CONFIGS; ++i)
+        printf(" %14s", configs[i].name);
+
+    printf("\n");
+
+    double totals[NUM_CONFIGS] = {0};
+
+    for (int pass = 0; pass < FANGBENCH_NUM_PASSES; ++pass)
+    {
+        printf("%-12s", FangBench_PassNames[pass]);
+
+        for (size_t i = 0; i < NUM_CONFIGS; ++i)
+        {
+            printf(" %11.1f us", results[i][pass]);
+            totals[i] += results[i][pass];
+        }
+
+        printf("\n");
+    }
+
+    printf("%-12s", "total");
+
+    for (size_t i = 0; i < NUM_CONFIGS; ++i)
+        printf(" %11.1f us", totals[i]);
+
+    printf("\n");
+
+    Fang_Quit();
+    return 0;
+}
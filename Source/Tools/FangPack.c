@@ -0,0 +1,206 @@
+// Copyright (C) 2021  Antonio Lassandro
+
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+
+// You should have received a copy of the GNU General Public License along
+// with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+/**
+ * Offline packer for the game's asset pack.
+ *
+ * Usage: FangPack [palettized] [swizzled] <resource directory> <output pack>
+ *
+ * Every texture is loaded from the resource directory the same way the game
+ * loads it (decoded, premultiplied, converted to its sampling layout, and
+ * mipmapped), then each image is written into the pack so the game can map it
+ * and sample it directly. See Fang_Pack.c for the format.
+**/
+
+#include "../Fang/Fang.c"
+#include "FangTools_Platform.c"
+
+static inline uint64_t
+FangPack_Align(
+    const uint64_t offset)
+{
+    return (offset + FANG_PACK_ALIGNMENT - 1) & ~(uint64_t)(FANG_PACK_ALIGNMENT - 1);
+}
+
+static inline int
+FangPack_WriteAt(
+          FILE     * const file,
+    const uint64_t         offset,
+    const void     * const data,
+    const size_t           size)
+{
+    if (fseek(file, (long)offset, SEEK_SET))
+        return 1;
+
+    return fwrite(data, 1, size, file) != size;
+}
+
+int main(int argc, char ** argv)
+{
+    Fang_Textures textures = {.storage = FANG_TEXTURESTORAGE_FULL};
+
+    int arg = 1;
+
+    if (arg < argc && !strcmp(argv[arg], "palettized"))
+    {
+        textures.storage = FANG_TEXTURESTORAGE_PALETTIZED;
+        arg++;
+    }
+
+    if (arg < argc && !strcmp(argv[arg], "swizzled"))
+    {
+        textures.swizzled = true;
+        arg++;
+    }
+
+    if (argc - arg != 2)
+    {
+        fprintf(
+            stderr,
+            "Usage: %s [palettized] [swizzled] <resources> <pack>\n",
+            argv[0]
+        );
+        return 1;
+    }
+
+    resource_dir = argv[arg];
+
+    const char * const output = argv[arg + 1];
+
+    if (Fang_LoadTextures(&textures))
+    {
+        fprintf(stderr, "Could not load all textures from %s\n", resource_dir);
+        return 1;
+    }
+
+    enum {
+        MAX_ENTRIES = FANG_NUM_TEXTURES * FANG_TEXTURE_LEVELS,
+    };
+
+    static       Fang_PackEntry   entries[MAX_ENTRIES];
+    static const Fang_Image     * images[MAX_ENTRIES];
+
+    uint32_t num_entries = 0;
+
+    for (Fang_TextureId id = 0; id < FANG_NUM_TEXTURES; ++id)
+    {
+        const char * const path = Fang_GetTextureInfo(id)->path;
+
+        if (!path || !Fang_ImageValid(&textures.textures[id]))
+            continue;
+
+        assert(strlen(path) < FANG_PACK_PATH_SIZE);
+
+        for (int level = 0; level < FANG_TEXTURE_LEVELS; ++level)
+        {
+            const Fang_Image * const image = (level)
+                ? &textures.mipmaps[id][level - 1]
+                : &textures.textures[id];
+
+            if (!Fang_ImageValid(image))
+                break;
+
+            Fang_PackEntry * const entry = &entries[num_entries];
+
+            strncpy(entry->path, path, FANG_PACK_PATH_SIZE - 1);
+
+            entry->level  = (uint32_t)level;
+            entry->width  = (uint32_t)image->width;
+            entry->height = (uint32_t)image->height;
+            entry->pitch  = (uint32_t)image->pitch;
+            entry->stride = (uint32_t)image->stride;
+            entry->layout = (uint32_t)image->layout;
+            entry->flags  = (uint32_t)image->flags;
+
+            images[num_entries++] = image;
+        }
+    }
+
+    /* Lay out the pixel data (and palettes) after the index */
+    uint64_t offset = FangPack_Align(
+        sizeof(Fang_PackHeader) + sizeof(Fang_PackEntry) * num_entries
+    );
+
+    for (uint32_t i = 0; i < num_entries; ++i)
+    {
+        entries[i].pixels = offset;
+        offset = FangPack_Align(offset + Fang_GetPackEntrySize(&entries[i]));
+
+        if (entries[i].flags & FANG_IMAGEFLAG_PALETTIZED)
+        {
+            entries[i].palette = offset;
+            offset = FangPack_Align(
+                offset + sizeof(uint32_t) * FANG_PALETTE_SIZE
+            );
+        }
+    }
+
+    Fang_PackHeader header = {
+        .byte_order  = FANG_PACK_BYTE_ORDER,
+        .version     = FANG_PACK_VERSION,
+        .num_entries = num_entries,
+    };
+
+    memcpy(header.magic, FANG_PACK_MAGIC, sizeof(header.magic));
+
+    FILE * const file = fopen(output, "wb");
+    if (!file)
+    {
+        fprintf(stderr, "Could not open %s for writing\n", output);
+        return 1;
+    }
+
+    int error = FangPack_WriteAt(file, 0, &header, sizeof(header));
+
+    error |= FangPack_WriteAt(
+        file,
+        sizeof(header),
+        entries,
+        sizeof(Fang_PackEntry) * num_entries
+    );
+
+    for (uint32_t i = 0; i < num_entries; ++i)
+    {
+        error |= FangPack_WriteAt(
+            file,
+            entries[i].pixels,
+            images[i]->pixels,
+            (size_t)Fang_GetPackEntrySize(&entries[i])
+        );
+
+        if (entries[i].flags & FANG_IMAGEFLAG_PALETTIZED)
+        {
+            error |= FangPack_WriteAt(
+                file,
+                entries[i].palette,
+                images[i]->palette,
+                sizeof(uint32_t) * FANG_PALETTE_SIZE
+            );
+        }
+    }
+
+    error |= fclose(file);
+
+    if (error)
+    {
+        fprintf(stderr, "Could not write %s\n", output);
+        return 1;
+    }
+
+    printf("Packed %u images into %s\n", num_entries, output);
+
+    Fang_FreeTextures(&textures);
+    return 0;
+}
@@ -0,0 +1,170 @@
+// Copyright (C) 2021  Antonio Lassandro
+
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option)
+// any later version.
+
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+
+// You should have received a copy of the GNU General Public License along
+// with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+/**
+ * The platform calls shared by the offline tools, which read files from a
+ * resource directory given on the command line instead of the app bundle.
+ *
+ * Tools should set resource_dir before loading anything.
+**/
+
+static const char * resource_dir;
+
+Fang_FileError
+Fang_LoadFile(
+    const char      * const filename,
+          Fang_File * const result)
+{
+    assert(filename);
+    assert(result);
+
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/%s", resource_dir, filename);
+
+    FILE * const file = fopen(path, "rb");
+    if (!file)
+        return FANG_FILE_ERROR_CANT_OPEN;
+
+    fseek(file, 0, SEEK_END);
+    const long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    if (size <= 0)
+    {
+        fclose(file);
+        return FANG_FILE_ERROR_UNKNOWN_SIZE;
+    }
+
+    result->data = malloc((size_t)size);
+    result->size = (size_t)size;
+
+    if (!result->data)
+    {
+        fclose(file);
+        result->size = 0;
+        return FANG_FILE_ERROR_BAD_ALLOCATION;
+    }
+
+    if (fread(result->data, 1, (size_t)size, file) != (size_t)size)
+    {
+        fclose(file);
+        Fang_FreeFile(result);
+        return FANG_FILE_ERROR_BAD_READ;
+    }
+
+    fclose(file);
+    return FANG_FILE_ERROR_NONE;
+}
+
+void
+Fang_FreeFile(
+    Fang_File * const file)
+{
+    assert(file);
+
+    free(file->data);
+    file->data = NULL;
+    file->size = 0;
+}
+
+Fang_FileError
+Fang_MapFile(
+    const char      * const filename,
+          Fang_File * const result)
+{
+    return Fang_LoadFile(filename, result);
+}
+
+void
+Fang_UnmapFile(
+    Fang_File * const file)
+{
+    Fang_FreeFile(file);
+}
+
+/* Tools read files when they are requested, as they only ever wait on them */
+struct Fang_FileRequest {
+    Fang_File      file;
+    Fang_FileError error;
+};
+
+Fang_FileRequest *
+Fang_RequestFile(
+    const char * const filename)
+{
+    assert(filename);
+
+    Fang_FileRequest * const request = calloc(1, sizeof(Fang_FileRequest));
+    if (!request)
+        return NULL;
+
+    request->error = Fang_LoadFile(filename, &request->file);
+    return request;
+}
+
+bool
+Fang_PollFile(
+    Fang_FileRequest * const request,
+    Fang_File        * const result,
+    Fang_FileError   * const error)
+{
+    assert(request);
+    assert(result);
+    assert(error);
+
+    *error = request->error;
+
+    if (request->error == FANG_FILE_ERROR_NONE)
+        *result = request->file;
+
+    free(request);
+    return true;
+}
+
+void
+Fang_WaitFile(
+    Fang_FileRequest * const request)
+{
+    (void)request;
+}
+
+void
+Fang_CancelFile(
+    Fang_FileRequest * const request)
+{
+    assert(request);
+
+    Fang_FreeFile(&request->file);
+    free(request);
+}
+
+/* Tools load every texture on the main thread, without any workers */
+Fang_Thread *
+Fang_CreateThread(
+    const Fang_ThreadFunc         func,
+          void          * const data)
+{
+    (void)func;
+    (void)data;
+    return NULL;
+}
+
+int
+Fang_JoinThread(
+    Fang_Thread * const thread)
+{
+    (void)thread;
+    return 0;
+}